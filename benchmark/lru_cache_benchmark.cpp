@@ -0,0 +1,304 @@
+/*
+* replays key traces against the caches and reports throughput, hit ratio, p99 latency and memory per entry
+* build with optimisations, eg
+*     g++ -std=c++20 -O2 -pthread benchmark/lru_cache_benchmark.cpp -o lru_cache_benchmark
+* usage
+*     lru_cache_benchmark [--trace <file>] [--pattern zipf|uniform|scan|loop] [--keys n] [--ops n] [--alpha a]
+*                         [--capacity n] [--value-size bytes] [--threads n] [--cache lru|two-tier|map-single|map-shared|map-epoch|map-swiss]
+*                         [--save-trace <file.bin>]
+* a request that misses pushes the value, so the hit ratio is the one the cache would see in front of a backing store
+* map-* variants measure the concurrency policies and indexes of LinkedUnorderedMap on lookups alone:
+* the map is preloaded with keys [0, capacity) and never changes while the trace is replayed
+* threads run 1, 2, 4, ... up to --threads, each replaying every n-th request of the trace
+*/
+#include "trace.cpp"
+#include "../implementations/concurrency_policy.cpp"
+#include "../implementations/linked_unordered_map.cpp"
+#include "../implementations/lru_cache.cpp"
+#include "../implementations/lz_codec.cpp"
+#include "../implementations/swiss_table.cpp"
+#include "../implementations/thread_pool.cpp"
+#include "../implementations/timer_wheel.cpp"
+#include "../implementations/two_tier_lru_cache.cpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace implementations;
+
+namespace {
+	// every allocation carries its size in a header so live heap bytes can be tracked
+	std::atomic<size_t> g_allocatedBytes{ 0 };
+	constexpr size_t ALLOCATION_HEADER = alignof(std::max_align_t);
+}
+
+void* operator new(size_t size) {
+	void* block = std::malloc(size + ALLOCATION_HEADER);
+	if (!block) {
+		throw std::bad_alloc();
+	}
+	*static_cast<size_t*>(block) = size;
+	g_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	return static_cast<char*>(block) + ALLOCATION_HEADER;
+}
+
+void operator delete(void* pointer) noexcept {
+	if (!pointer) {
+		return;
+	}
+	// stepped back through an integer, the compiler would otherwise flag the header as outside the caller's object
+	void* block = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(pointer) - ALLOCATION_HEADER);
+	g_allocatedBytes.fetch_sub(*static_cast<size_t*>(block), std::memory_order_relaxed);
+	std::free(block);
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete[](void* pointer) noexcept {
+	operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+	operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+	operator delete(pointer);
+}
+
+namespace {
+	struct Options {
+		std::string tracePath;
+		std::string savePath;
+		std::string pattern = "zipf";
+		uint64_t numKeys = 1000000;
+		size_t numOps = 2000000;
+		double alpha = 0.99;
+		size_t capacity = 100000;
+		size_t valueSize = 64;
+		size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+		std::string cache = "lru";
+	};
+
+	struct Result {
+		double opsPerSecond;
+		double hitRatio;
+		double p99Nanos;
+	};
+
+	// one request against the cache under test, returns whether the key was present
+	using Request = std::function<bool(const uint64_t key)>;
+
+	Options parseOptions(int argc, char** argv) {
+		Options options;
+		for (int i = 1; i < argc; i++) {
+			const std::string flag = argv[i];
+			if (i + 1 >= argc) {
+				throw std::invalid_argument("Missing value for " + flag);
+			}
+			const std::string value = argv[++i];
+			if (flag == "--trace") {
+				options.tracePath = value;
+			}
+			else if (flag == "--save-trace") {
+				options.savePath = value;
+			}
+			else if (flag == "--pattern") {
+				options.pattern = value;
+			}
+			else if (flag == "--keys") {
+				options.numKeys = std::stoull(value);
+			}
+			else if (flag == "--ops") {
+				options.numOps = std::stoull(value);
+			}
+			else if (flag == "--alpha") {
+				options.alpha = std::stod(value);
+			}
+			else if (flag == "--capacity") {
+				options.capacity = std::stoull(value);
+			}
+			else if (flag == "--value-size") {
+				options.valueSize = std::stoull(value);
+			}
+			else if (flag == "--threads") {
+				options.maxThreads = std::max<size_t>(1, std::stoull(value));
+			}
+			else if (flag == "--cache") {
+				options.cache = value;
+			}
+			else {
+				throw std::invalid_argument("Unknown flag " + flag);
+			}
+		}
+		return options;
+	}
+
+	std::vector<uint64_t> makeTrace(const Options& options) {
+		if (!options.tracePath.empty()) {
+			return benchmark::Trace::load(options.tracePath);
+		}
+		if (options.pattern == "zipf") {
+			return benchmark::Trace::zipf(options.numKeys, options.alpha, options.numOps, 42);
+		}
+		if (options.pattern == "uniform") {
+			return benchmark::Trace::uniform(options.numKeys, options.numOps, 42);
+		}
+		if (options.pattern == "scan") {
+			return benchmark::Trace::scan(options.numOps);
+		}
+		if (options.pattern == "loop") {
+			return benchmark::Trace::loop(options.numKeys, options.numOps);
+		}
+		throw std::invalid_argument("Unknown pattern " + options.pattern);
+	}
+
+	Result replay(const Request& request, const std::vector<uint64_t>& keys, const size_t numThreads) {
+		// timing every request would cost as much as a cache hit, so one request in SAMPLE_EVERY is timed
+		static constexpr size_t SAMPLE_EVERY = 16;
+		std::vector<std::vector<uint64_t>> latencies(numThreads);
+		std::vector<size_t> hits(numThreads, 0);
+		std::atomic<bool> isStarted = false;
+		std::vector<std::thread> threads;
+		for (size_t t = 0; t < numThreads; t++) {
+			threads.emplace_back([&, t]() {
+				latencies[t].reserve(keys.size() / numThreads / SAMPLE_EVERY + 1);
+				while (!isStarted.load(std::memory_order_acquire)) {
+					std::this_thread::yield();
+				}
+				size_t numHits = 0;
+				for (size_t i = t, n = 0; i < keys.size(); i += numThreads, n++) {
+					if (n % SAMPLE_EVERY != 0) {
+						numHits += request(keys[i]);
+						continue;
+					}
+					const auto start = std::chrono::steady_clock::now();
+					numHits += request(keys[i]);
+					latencies[t].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+				}
+				hits[t] = numHits;
+			});
+		}
+		const auto start = std::chrono::steady_clock::now();
+		isStarted.store(true, std::memory_order_release);
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::vector<uint64_t> allLatencies;
+		size_t totalHits = 0;
+		for (size_t t = 0; t < numThreads; t++) {
+			allLatencies.insert(allLatencies.end(), latencies[t].cbegin(), latencies[t].cend());
+			totalHits += hits[t];
+		}
+		double p99 = 0;
+		if (!allLatencies.empty()) {
+			const auto p99It = allLatencies.begin() + (allLatencies.size() * 99) / 100;
+			std::nth_element(allLatencies.begin(), p99It, allLatencies.end());
+			p99 = static_cast<double>(*p99It);
+		}
+		return Result{ keys.size() / seconds, keys.empty() ? 0 : static_cast<double>(totalHits) / keys.size(), p99 };
+	}
+
+	// builds a fresh cache for one run and returns the request that drives it, the cache lives in the returned closure
+	Request makeRequest(const Options& options, const std::string& value) {
+		if (options.cache == "lru") {
+			auto cache = std::make_shared<LruCache<uint64_t, std::string>>(options.capacity);
+			return [cache, value](const uint64_t key) {
+				if (cache->getIfPresent(key)) {
+					return true;
+				}
+				cache->push(key, value);
+				return false;
+			};
+		}
+		if (options.cache == "two-tier") {
+			// the cold tier gets the same byte budget the hot tier spends on values
+			auto cache = std::make_shared<TwoTierLruCache<uint64_t, std::string>>(options.capacity, options.capacity * options.valueSize);
+			return [cache, value](const uint64_t key) {
+				if (cache->get(key)) {
+					return true;
+				}
+				cache->push(key, value);
+				return false;
+			};
+		}
+		const auto preloaded = [&options, &value](auto map) -> Request {
+			for (uint64_t key = 0; key < options.capacity; key++) {
+				map->insertAtTail(key, value);
+			}
+			return [map](const uint64_t key) {
+				return map->visit(key, [](const std::string&) {});
+			};
+		};
+		if (options.cache == "map-single") {
+			return preloaded(std::make_shared<LinkedUnorderedMap<uint64_t, std::string, std::hash<uint64_t>, std::equal_to<uint64_t>, SingleThreaded>>());
+		}
+		if (options.cache == "map-shared") {
+			return preloaded(std::make_shared<LinkedUnorderedMap<uint64_t, std::string, std::hash<uint64_t>, std::equal_to<uint64_t>, SharedMutexLocking>>());
+		}
+		if (options.cache == "map-epoch") {
+			return preloaded(std::make_shared<LinkedUnorderedMap<uint64_t, std::string, std::hash<uint64_t>, std::equal_to<uint64_t>, EpochReclamation>>());
+		}
+		if (options.cache == "map-swiss") {
+			return preloaded(std::make_shared<LinkedUnorderedMap<uint64_t, std::string, SeededHash, std::equal_to<uint64_t>, SharedMutexLocking, SwissTable>>());
+		}
+		throw std::invalid_argument("Unknown cache " + options.cache);
+	}
+
+	// live heap bytes per entry once the cache holds capacity entries
+	double bytesPerEntry(const Options& options, const std::string& value) {
+		const size_t before = g_allocatedBytes.load();
+		size_t after;
+		{
+			const Request request = makeRequest(options, value);
+			for (uint64_t key = 0; key < options.capacity; key++) {
+				request(key);
+			}
+			after = g_allocatedBytes.load();
+		}
+		return options.capacity == 0 ? 0 : static_cast<double>(after - before) / options.capacity;
+	}
+}
+
+int main(int argc, char** argv) {
+	try {
+		const Options options = parseOptions(argc, argv);
+		const std::vector<uint64_t> keys = makeTrace(options);
+		if (!options.savePath.empty()) {
+			benchmark::Trace::saveBinary(options.savePath, keys);
+		}
+		const std::string value(options.valueSize, 'v');
+		const bool isSingleThreaded = options.cache == "map-single";
+
+		std::printf("cache %s, %zu requests, capacity %zu, value size %zu, %.1f bytes per entry\n",
+			options.cache.c_str(), keys.size(), options.capacity, options.valueSize, bytesPerEntry(options, value));
+		std::printf("%8s %14s %10s %10s\n", "threads", "ops/sec", "hit ratio", "p99 ns");
+		for (size_t numThreads = 1; numThreads <= options.maxThreads; numThreads *= 2) {
+			const Result result = replay(makeRequest(options, value), keys, numThreads);
+			std::printf("%8zu %14.0f %10.4f %10.0f\n", numThreads, result.opsPerSecond, result.hitRatio, result.p99Nanos);
+			if (isSingleThreaded) {
+				break;
+			}
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,129 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+
+namespace benchmark {
+	inline std::vector<uint64_t> Trace::load(const std::string& path) {
+		const bool isBinary = path.size() >= 4 && path.compare(path.size() - 4, 4, ".bin") == 0;
+		return isBinary ? loadBinary(path) : loadText(path);
+	}
+
+	inline std::vector<uint64_t> Trace::loadText(const std::string& path) {
+		std::ifstream file(path);
+		if (!file) {
+			throw std::runtime_error("Cannot open trace " + path);
+		}
+		std::vector<uint64_t> keys;
+		std::string line;
+		while (std::getline(file, line)) {
+			const size_t start = line.find_first_not_of(" \t\r");
+			if (start == std::string::npos || line[start] == '#') {
+				continue;
+			}
+			const std::string_view token(line.data() + start, line.find_last_not_of(" \t\r") + 1 - start);
+			uint64_t key;
+			const auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), key);
+			if (error != std::errc() || end != token.data() + token.size()) {
+				key = std::hash<std::string_view>()(token);
+			}
+			keys.push_back(key);
+		}
+		return keys;
+	}
+
+	inline std::vector<uint64_t> Trace::loadBinary(const std::string& path) {
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file) {
+			throw std::runtime_error("Cannot open trace " + path);
+		}
+		const std::streamoff size = file.tellg();
+		if (size % sizeof(uint64_t) != 0) {
+			throw std::runtime_error("Binary trace " + path + " is not a whole number of keys");
+		}
+		std::vector<unsigned char> bytes(static_cast<size_t>(size));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(bytes.data()), size);
+		std::vector<uint64_t> keys(bytes.size() / sizeof(uint64_t));
+		for (size_t i = 0; i < keys.size(); i++) {
+			uint64_t key = 0;
+			for (size_t byte = 0; byte < sizeof(uint64_t); byte++) {
+				key |= static_cast<uint64_t>(bytes[i * sizeof(uint64_t) + byte]) << (8 * byte);
+			}
+			keys[i] = key;
+		}
+		return keys;
+	}
+
+	inline void Trace::saveBinary(const std::string& path, const std::vector<uint64_t>& keys) {
+		std::ofstream file(path, std::ios::binary);
+		if (!file) {
+			throw std::runtime_error("Cannot create trace " + path);
+		}
+		for (const uint64_t key : keys) {
+			char bytes[sizeof(uint64_t)];
+			for (size_t byte = 0; byte < sizeof(uint64_t); byte++) {
+				bytes[byte] = static_cast<char>(key >> (8 * byte));
+			}
+			file.write(bytes, sizeof(bytes));
+		}
+	}
+
+	inline std::vector<uint64_t> Trace::zipf(const uint64_t numKeys, const double alpha, const size_t length, const uint64_t seed) {
+		if (numKeys == 0) {
+			throw std::invalid_argument("Zipf trace needs at least one key");
+		}
+		std::vector<double> cumulative(numKeys);
+		double total = 0;
+		for (uint64_t k = 0; k < numKeys; k++) {
+			total += 1.0 / std::pow(static_cast<double>(k + 1), alpha);
+			cumulative[k] = total;
+		}
+		std::mt19937_64 rng(seed);
+		std::uniform_real_distribution<double> distribution(0, total);
+		std::vector<uint64_t> keys(length);
+		for (uint64_t& key : keys) {
+			const auto it = std::upper_bound(cumulative.cbegin(), cumulative.cend(), distribution(rng));
+			key = std::min<uint64_t>(it - cumulative.cbegin(), numKeys - 1);
+		}
+		return keys;
+	}
+
+	inline std::vector<uint64_t> Trace::uniform(const uint64_t numKeys, const size_t length, const uint64_t seed) {
+		if (numKeys == 0) {
+			throw std::invalid_argument("Uniform trace needs at least one key");
+		}
+		std::mt19937_64 rng(seed);
+		std::uniform_int_distribution<uint64_t> distribution(0, numKeys - 1);
+		std::vector<uint64_t> keys(length);
+		for (uint64_t& key : keys) {
+			key = distribution(rng);
+		}
+		return keys;
+	}
+
+	inline std::vector<uint64_t> Trace::scan(const size_t length) {
+		std::vector<uint64_t> keys(length);
+		for (size_t i = 0; i < length; i++) {
+			keys[i] = i;
+		}
+		return keys;
+	}
+
+	inline std::vector<uint64_t> Trace::loop(const uint64_t loopSize, const size_t length) {
+		if (loopSize == 0) {
+			throw std::invalid_argument("Loop trace needs at least one key");
+		}
+		std::vector<uint64_t> keys(length);
+		for (size_t i = 0; i < length; i++) {
+			keys[i] = i % loopSize;
+		}
+		return keys;
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace benchmark {
+	/*
+	* key traces replayed by the benchmarks, a trace is the sequence of keys requested
+	* text traces hold one key per line, numeric keys are used as is and any other token is hashed,
+	* binary traces (.bin) are a packed sequence of little endian uint64 keys
+	*/
+	class Trace
+	{
+	public:
+		static std::vector<uint64_t> load(const std::string& path);
+		static std::vector<uint64_t> loadText(const std::string& path);
+		static std::vector<uint64_t> loadBinary(const std::string& path);
+		static void saveBinary(const std::string& path, const std::vector<uint64_t>& keys);
+
+		// skewed popularity, key k is requested with probability proportional to 1 / (k + 1)^alpha
+		static std::vector<uint64_t> zipf(const uint64_t numKeys, const double alpha, const size_t length, const uint64_t seed);
+		static std::vector<uint64_t> uniform(const uint64_t numKeys, const size_t length, const uint64_t seed);
+		// every key is new, the worst case for any cache
+		static std::vector<uint64_t> scan(const size_t length);
+		// cycles through the same keys, LRU misses every request when the loop is larger than the cache
+		static std::vector<uint64_t> loop(const uint64_t loopSize, const size_t length);
+	};
+}
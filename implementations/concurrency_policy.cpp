@@ -0,0 +1,198 @@
+#include "concurrency_policy.h"
+
+#include <functional>
+#include <thread>
+#include <utility>
+
+namespace implementations {
+	inline EpochManager::EpochManager()
+		: m_stripes()
+		, m_epoch(0)
+		, m_retired() {}
+
+	inline size_t EpochManager::stripeOfCurrentThread() {
+		thread_local const size_t stripe = std::hash<std::thread::id>()(std::this_thread::get_id()) % NUM_STRIPES;
+		return stripe;
+	}
+
+	inline bool EpochManager::hasReaders(const size_t parity) const {
+		for (const Stripe& stripe : m_stripes) {
+			if (stripe.readers[parity].load() != 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// a reader that loads a stale epoch registers under its parity before loading any shared pointer,
+	// so either the writer sees it in hasReaders or the reader sees everything published before the check
+	inline EpochManager::Guard::Guard(EpochManager& manager)
+		: m_readers(manager.m_stripes[stripeOfCurrentThread()].readers[manager.m_epoch.load() & 1]) {
+		m_readers.fetch_add(1);
+	}
+
+	inline EpochManager::Guard::~Guard() {
+		m_readers.fetch_sub(1);
+	}
+
+	inline uint64_t EpochManager::epoch() const noexcept {
+		return m_epoch.load();
+	}
+
+	inline size_t EpochManager::numRetired() const noexcept {
+		size_t numRetired = 0;
+		for (const auto& retired : m_retired) {
+			numRetired += retired.size();
+		}
+		return numRetired;
+	}
+
+	inline void EpochManager::retire(std::shared_ptr<void> object) {
+		m_retired[m_epoch.load() % NUM_RETIRE_LISTS].push_back(std::move(object));
+		tryAdvance();
+		// readers enter the current epoch, so the ones pinning an old one only ever leave and this ends
+		while (numRetired() > MAX_RETIRED) {
+			if (!tryAdvance()) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	inline bool EpochManager::tryAdvance() {
+		const uint64_t epoch = m_epoch.load();
+		// readers of the previous epoch share the parity of the next one
+		if (hasReaders((epoch + 1) & 1)) {
+			return false;
+		}
+		m_epoch.store(epoch + 1);
+		// objects retired in the previous epoch were unlinked before any reader still inside could have entered
+		m_retired[(epoch + 2) % NUM_RETIRE_LISTS].clear();
+		return true;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	RcuShardedIndex<K, T, Hash, KeyEqual>::Table::Table(const size_t bucketBits)
+		: bucketBits(bucketBits)
+		, size(0)
+		, buckets(std::make_unique<std::atomic<Node*>[]>(size_t(1) << bucketBits)) {}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	RcuShardedIndex<K, T, Hash, KeyEqual>::Table::~Table() {
+		for (size_t i = 0; i < (size_t(1) << bucketBits); i++) {
+			Node* node = buckets[i].load(std::memory_order_relaxed);
+			while (node) {
+				delete std::exchange(node, node->next.load(std::memory_order_relaxed));
+			}
+		}
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	size_t RcuShardedIndex<K, T, Hash, KeyEqual>::Table::bucketOf(const uint64_t mixedHash) const noexcept {
+		return static_cast<size_t>((mixedHash << SHARD_BITS) >> (64 - bucketBits));
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	void RcuShardedIndex<K, T, Hash, KeyEqual>::Table::push(const uint64_t mixedHash, Node* node) noexcept {
+		std::atomic<Node*>& bucket = buckets[bucketOf(mixedHash)];
+		node->next.store(bucket.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		// release, so a reader that finds the node also sees its key, value and next
+		bucket.store(node, std::memory_order_release);
+		size++;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	RcuShardedIndex<K, T, Hash, KeyEqual>::RcuShardedIndex()
+		: m_published()
+		, m_shards()
+		, m_hash()
+		, m_keyEqual() {
+		for (size_t i = 0; i < NUM_SHARDS; i++) {
+			m_shards[i] = std::make_shared<Table>(MIN_BUCKET_BITS);
+			m_published[i].store(m_shards[i].get());
+		}
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <class KeyLike>
+	uint64_t RcuShardedIndex<K, T, Hash, KeyEqual>::mixedHashOf(const KeyLike& key) const {
+		// fibonacci hashing spreads identity hashes of small integers over the top bits
+		return static_cast<uint64_t>(m_hash(key)) * 0x9E3779B97F4A7C15ull;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	size_t RcuShardedIndex<K, T, Hash, KeyEqual>::shardOf(const uint64_t mixedHash) noexcept {
+		return static_cast<size_t>(mixedHash >> (64 - SHARD_BITS));
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	void RcuShardedIndex<K, T, Hash, KeyEqual>::grow(const size_t shard, EpochManager& epochs) {
+		const Table& table = *m_shards[shard];
+		std::shared_ptr<Table> grown = std::make_shared<Table>(table.bucketBits + 1);
+		for (size_t i = 0; i < (size_t(1) << table.bucketBits); i++) {
+			for (const Node* node = table.buckets[i].load(std::memory_order_relaxed); node; node = node->next.load(std::memory_order_relaxed)) {
+				grown->push(mixedHashOf(node->key), new Node{ node->key, node->value, nullptr });
+			}
+		}
+		m_published[shard].store(grown.get());
+		epochs.retire(std::exchange(m_shards[shard], std::move(grown)));
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <class KeyLike>
+	T RcuShardedIndex<K, T, Hash, KeyEqual>::find(const KeyLike& key) const {
+		const uint64_t mixedHash = mixedHashOf(key);
+		const Table* table = m_published[shardOf(mixedHash)].load();
+		const Node* node = table->buckets[table->bucketOf(mixedHash)].load(std::memory_order_acquire);
+		for (; node; node = node->next.load(std::memory_order_acquire)) {
+			if (m_keyEqual(node->key, key)) {
+				return node->value;
+			}
+		}
+		return T();
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	void RcuShardedIndex<K, T, Hash, KeyEqual>::insert(const K& key, const T& value, EpochManager& epochs) {
+		const uint64_t mixedHash = mixedHashOf(key);
+		const size_t shard = shardOf(mixedHash);
+		Table& table = *m_shards[shard];
+		std::atomic<Node*>* link = &table.buckets[table.bucketOf(mixedHash)];
+		for (Node* node = link->load(std::memory_order_relaxed); node; node = link->load(std::memory_order_relaxed)) {
+			if (m_keyEqual(node->key, key)) {
+				// readers may be reading the old value, the new one takes the old node's place
+				link->store(new Node{ key, value, node->next.load(std::memory_order_relaxed) }, std::memory_order_release);
+				epochs.retire(std::shared_ptr<Node>(node));
+				return;
+			}
+			link = &node->next;
+		}
+		table.push(mixedHash, new Node{ key, value, nullptr });
+		if (table.size > (size_t(1) << table.bucketBits)) {
+			grow(shard, epochs);
+		}
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <class KeyLike>
+	void RcuShardedIndex<K, T, Hash, KeyEqual>::erase(const KeyLike& key, EpochManager& epochs) {
+		const uint64_t mixedHash = mixedHashOf(key);
+		Table& table = *m_shards[shardOf(mixedHash)];
+		std::atomic<Node*>* link = &table.buckets[table.bucketOf(mixedHash)];
+		for (Node* node = link->load(std::memory_order_relaxed); node; node = link->load(std::memory_order_relaxed)) {
+			if (m_keyEqual(node->key, key)) {
+				// a reader on the node still finds the rest of the bucket through its next
+				link->store(node->next.load(std::memory_order_relaxed), std::memory_order_release);
+				table.size--;
+				epochs.retire(std::shared_ptr<Node>(node));
+				return;
+			}
+			link = &node->next;
+		}
+	}
+
+	inline EpochReclamation::ReadLock::ReadLock(Mutex& mutex)
+		: guard(mutex.epochs) {}
+
+	inline EpochReclamation::WriteLock::WriteLock(Mutex& mutex)
+		: lock(mutex.writerMutex) {}
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+namespace implementations {
+	/*
+	* epoch based reclamation for lock free readers
+	* readers pin the current epoch for the duration of a Guard, writers retire objects they have unlinked
+	* and the objects are destroyed once every reader that could still see them has left
+	* reader counts are striped per thread so readers on different cores do not contend on one cache line
+	* retire is only called by writers, which must be serialised by the caller and must not hold a Guard themselves:
+	* once MAX_RETIRED objects wait, retire blocks until the readers pinning the old epochs leave,
+	* so a reader that stays inside a Guard stalls writers rather than letting the retired objects pile up
+	*/
+	class EpochManager
+	{
+		static constexpr size_t NUM_STRIPES = 16;
+		static constexpr size_t NUM_RETIRE_LISTS = 3;
+
+		struct alignas(64) Stripe {
+			std::array<std::atomic<uint64_t>, 2> readers{};
+		};
+
+		std::array<Stripe, NUM_STRIPES> m_stripes;
+		std::atomic<uint64_t> m_epoch;
+		std::array<std::vector<std::shared_ptr<void>>, NUM_RETIRE_LISTS> m_retired;
+
+		static size_t stripeOfCurrentThread();
+		bool hasReaders(const size_t parity) const;
+	public:
+		static constexpr size_t MAX_RETIRED = 4096;
+
+		class Guard {
+			std::atomic<uint64_t>& m_readers;
+		public:
+			explicit Guard(EpochManager& manager);
+			Guard(const Guard&) = delete;
+			Guard& operator=(const Guard&) = delete;
+			~Guard();
+		};
+
+		EpochManager();
+
+		uint64_t epoch() const noexcept;
+		size_t numRetired() const noexcept;
+		void retire(std::shared_ptr<void> object);
+		// moves to the next epoch if no reader is left in the previous one, freeing what was retired two epochs ago
+		bool tryAdvance();
+	};
+
+	/*
+	* read copy update index for lock free lookups
+	* split into shards, each a chained hash table whose buckets readers walk without a lock,
+	* a writer links a new node at the head of its bucket, or unlinks a node and retires just that node,
+	* so inserts and erases cost O(1); a shard whose nodes outnumber its buckets is copied into a table twice the size
+	* and the old table retired, amortised O(1) per insert, a new value for a known key goes into a new node
+	* finds must run inside an EpochManager::Guard, writers must be serialised by the caller
+	*/
+	template <class K, class T, class Hash, class KeyEqual>
+	class RcuShardedIndex
+	{
+		static constexpr size_t SHARD_BITS = 6;
+		static constexpr size_t NUM_SHARDS = size_t(1) << SHARD_BITS;
+		static constexpr size_t MIN_BUCKET_BITS = 3;
+
+		struct Node {
+			K key;
+			T value;
+			std::atomic<Node*> next;
+		};
+
+		// owns the nodes linked from its buckets, a node unlinked from them is retired on its own
+		struct Table {
+			size_t bucketBits;
+			size_t size;
+			std::unique_ptr<std::atomic<Node*>[]> buckets;
+
+			explicit Table(const size_t bucketBits);
+			Table(const Table&) = delete;
+			Table& operator=(const Table&) = delete;
+			~Table();
+
+			// by the bits below the shard bits of a mixed hash
+			size_t bucketOf(const uint64_t mixedHash) const noexcept;
+			void push(const uint64_t mixedHash, Node* node) noexcept;
+		};
+
+		std::array<std::atomic<const Table*>, NUM_SHARDS> m_published;
+		// writer side owners of the published tables
+		std::array<std::shared_ptr<Table>, NUM_SHARDS> m_shards;
+		Hash m_hash;
+		KeyEqual m_keyEqual;
+
+		template <class KeyLike>
+		uint64_t mixedHashOf(const KeyLike& key) const;
+		static size_t shardOf(const uint64_t mixedHash) noexcept;
+		void grow(const size_t shard, EpochManager& epochs);
+	public:
+		RcuShardedIndex();
+
+		template <class KeyLike>
+		T find(const KeyLike& key) const;
+		void insert(const K& key, const T& value, EpochManager& epochs);
+		template <class KeyLike>
+		void erase(const KeyLike& key, EpochManager& epochs);
+	};
+
+	// stand in for policies whose readers share the lock with writers
+	struct NoReadIndex {};
+
+	/*
+	* concurrency policies for LinkedUnorderedMap
+	* SingleThreaded: no synchronisation at all
+	* SharedMutexLocking: readers share a std::shared_mutex, writers hold it exclusively
+	* EpochReclamation: readers take no lock, they look up an RcuShardedIndex inside an epoch guard
+	* while writers serialise on a mutex and retire removed nodes through the EpochManager
+	* Counter is the type of counts that are read without taking a lock
+	*/
+	struct SingleThreaded {
+		struct Mutex {};
+		struct Lock {
+			explicit Lock(Mutex&) noexcept {}
+		};
+		using ReadLock = Lock;
+		using WriteLock = Lock;
+		template <class K, class T, class Hash, class KeyEqual>
+		using ReadIndex = NoReadIndex;
+		using Counter = size_t;
+		static constexpr bool hasLockFreeReads = false;
+	};
+
+	struct SharedMutexLocking {
+		using Mutex = std::shared_mutex;
+		using ReadLock = std::shared_lock<std::shared_mutex>;
+		using WriteLock = std::unique_lock<std::shared_mutex>;
+		template <class K, class T, class Hash, class KeyEqual>
+		using ReadIndex = NoReadIndex;
+		using Counter = std::atomic<size_t>;
+		static constexpr bool hasLockFreeReads = false;
+	};
+
+	struct EpochReclamation {
+		struct Mutex {
+			std::mutex writerMutex;
+			EpochManager epochs;
+		};
+		struct ReadLock {
+			EpochManager::Guard guard;
+
+			explicit ReadLock(Mutex& mutex);
+		};
+		struct WriteLock {
+			std::lock_guard<std::mutex> lock;
+
+			explicit WriteLock(Mutex& mutex);
+		};
+		template <class K, class T, class Hash, class KeyEqual>
+		using ReadIndex = RcuShardedIndex<K, T, Hash, KeyEqual>;
+		using Counter = std::atomic<size_t>;
+		static constexpr bool hasLockFreeReads = true;
+	};
+}
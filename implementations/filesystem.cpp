@@ -1,250 +1,2236 @@
 #include "filesystem.h"
 
 #include <algorithm>
-#include <future>
-#include <numeric>
-#include <sstream>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
 #include <stdexcept>
+#include <thread>
+#include <tuple>
 
 namespace {
-	const size_t PARALLELISATION_THRESHOLD = 2;
+	const size_t DEFAULT_DENTRY_CACHE_CAPACITY = 4096;
+	// 256KB of file data per chunk
+	const size_t BLOCKS_PER_CHUNK = 64;
+	const uint64_t IMAGE_MAGIC = 0x4653494d41474531; // "FSIMAGE1"
+	const uint32_t IMAGE_VERSION = 2;
+
+	uint64_t alignUp(const uint64_t offset, const uint64_t alignment) {
+		return (offset + alignment - 1) / alignment * alignment;
+	}
 }
 
-namespace implementations {
-	FileSystem::File::File(const std::string& name)
-		: name(name) {}
+namespace implementations {
+	FileSystem::PrintOptions::PrintOptions()
+		: maxDepth(std::numeric_limits<size_t>::max())
+		, isSorted(false) {}
+
+	FileSystem::FileData::FileData()
+		: mutex()
+		, size(0)
+		, blocks() {}
+
+	FileSystem::File::File(InternedString name, const std::shared_ptr<Directory>& parent)
+		: name(std::move(name))
+		, parent(parent)
+		, data(nullptr) {}
+
+	FileSystem::File::~File() {
+		delete data.load(std::memory_order_relaxed);
+	}
+
+	inline bool FileSystem::File::isDirectory() {
+		return false;
+	}
+
+	inline FileSystem::FileData* FileSystem::File::findData() const noexcept {
+		return data.load(std::memory_order_acquire);
+	}
+
+	FileSystem::FileData& FileSystem::File::ensureData() {
+		FileData* existing = data.load(std::memory_order_acquire);
+		if (existing) {
+			return *existing;
+		}
+		// two first writers may race, the loser frees its copy and takes the winner's
+		std::unique_ptr<FileData> created = std::make_unique<FileData>();
+		if (data.compare_exchange_strong(existing, created.get(), std::memory_order_acq_rel, std::memory_order_acquire)) {
+			return *created.release();
+		}
+		return *existing;
+	}
+
+	FileSystem::Directory::Directory(InternedString name, const std::shared_ptr<Directory>& parent)
+		: File(std::move(name), parent)
+		, mutex()
+		, files()
+		, childDirs()
+		, frozen()
+		, isFrozen(false)
+		, isChanged(false)
+		, isLoaded(true)
+		, imageIndex(0)
+		, bytesBelow(0)
+		, numFilesBelow(0)
+		, numDirsBelow(0) {}
+
+	inline bool FileSystem::Directory::isDirectory() {
+		return true;
+	}
+
+	FileSystem::PathTokenizer::PathTokenizer(std::string_view path)
+		: m_path(path) {}
+
+	inline bool FileSystem::PathTokenizer::next(std::string_view& token) {
+		while (!m_path.empty()) {
+			const size_t end = std::min(m_path.find('/'), m_path.size());
+			token = m_path.substr(0, end);
+			m_path.remove_prefix(std::min(end + 1, m_path.size()));
+			if (!token.empty() && token != ".") {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	inline size_t FileSystem::DentryKeyHash::operator()(const DentryKey& key) const noexcept {
+		return (*this)(DentryKeyView{ key.base, key.path });
+	}
+
+	inline size_t FileSystem::DentryKeyHash::operator()(const DentryKeyView& key) const noexcept {
+		const size_t pathHash = TransparentStringHash()(key.path);
+		return pathHash ^ (std::hash<const Directory*>()(key.base) + 0x9e3779b97f4a7c15ULL + (pathHash << 6) + (pathHash >> 2));
+	}
+
+	FileSystem::Dentry::Dentry()
+		: Dentry(0, std::weak_ptr<Directory>()) {}
+
+	FileSystem::Dentry::Dentry(const uint64_t generation, std::weak_ptr<Directory> dir)
+		: generation(generation)
+		, dir(std::move(dir))
+		, isReferenced(false) {}
+
+	template <class KeyA, class KeyB>
+	bool FileSystem::DentryKeyEqual::operator()(const KeyA& a, const KeyB& b) const noexcept {
+		return a.base == b.base && std::string_view(a.path) == std::string_view(b.path);
+	}
+
+	FileSystem::FileSystem()
+		: FileSystem(DEFAULT_DENTRY_CACHE_CAPACITY) {}
+
+	FileSystem::FileSystem(const size_t dentryCacheCapacity)
+		: m_inodeArena(std::make_shared<SlabArena>())
+		, m_blockArena(std::make_shared<SlabArena>(BLOCKS_PER_CHUNK))
+		, m_names()
+		, m_root(makeNode<Directory>(m_names.intern("root"), nullptr))
+		, m_pwd(m_root)
+		, m_pwdMutex()
+		, m_renameMutex()
+		, m_dentryShards()
+		, m_dentryCapacity((dentryCacheCapacity + NUM_SHARDS - 1) / NUM_SHARDS)
+		, m_dentryGeneration(0)
+		, m_isImageIndexed(false)
+		, m_nextWatchId(0)
+		, m_numWatches(0)
+		, m_nextWatchSequence(0)
+		, m_watchSignal(0)
+		, m_isWatchStopping(false) {}
+
+	FileSystem::FileSystem(const std::string& imagePath)
+		: FileSystem(DEFAULT_DENTRY_CACHE_CAPACITY) {
+		m_image = std::make_unique<const Image>(openImage(imagePath));
+		m_root->bytesBelow = m_image->dirs[0].bytesBelow;
+		m_root->numFilesBelow = m_image->dirs[0].numFilesBelow;
+		m_root->numDirsBelow = m_image->dirs[0].numDirsBelow;
+		m_root->isLoaded = false;
+		m_imageDirs.emplace(0, m_root);
+		materialize(m_root);
+	}
+
+	FileSystem::~FileSystem() {
+		if (m_watchThread.joinable()) {
+			m_isWatchStopping.store(true, std::memory_order_release);
+			m_watchSignal.fetch_add(1, std::memory_order_release);
+			m_watchSignal.notify_one();
+			m_watchThread.join();
+		}
+	}
+
+	FileSystem::Session::Session(FileSystem& fileSystem, std::shared_ptr<Directory> pwd)
+		: m_fileSystem(&fileSystem)
+		, m_pwd(std::move(pwd)) {}
+
+	std::shared_ptr<FileSystem::Directory> FileSystem::Session::getPwd() const {
+		return m_pwd;
+	}
+
+	std::shared_ptr<FileSystem::File> FileSystem::Session::makeFile(std::string&& pathToNewFile, const bool isDirectory, const bool shouldCreateMissingDirectories) {
+		return m_fileSystem->makeFile(m_pwd, pathToNewFile, isDirectory, shouldCreateMissingDirectories);
+	}
+
+	std::shared_ptr<FileSystem::Directory> FileSystem::Session::changeDirectory(std::string&& path) {
+		return m_pwd = m_fileSystem->getDirectory(m_pwd, path, false);
+	}
+
+	std::shared_ptr<FileSystem::File> FileSystem::Session::removeFile(std::string&& pathToRemove) {
+		return m_fileSystem->removeFile(m_pwd, pathToRemove);
+	}
+
+	std::shared_ptr<FileSystem::File> FileSystem::Session::moveFile(std::string&& sourcePath, std::string&& destPath) {
+		return m_fileSystem->copyFile(m_pwd, sourcePath, destPath, true);
+	}
+
+	std::shared_ptr<FileSystem::File> FileSystem::Session::copyFile(std::string&& sourcePath, std::string&& destPath) {
+		return m_fileSystem->copyFile(m_pwd, sourcePath, destPath, false);
+	}
+
+	std::string FileSystem::Session::printTree(std::string&& path) const {
+		return m_fileSystem->printTree(m_pwd, path);
+	}
+
+	void FileSystem::Session::printTree(std::string&& path, std::ostream& out, const PrintOptions& options) const {
+		m_fileSystem->printTree(m_pwd, path, out, options);
+	}
+
+	std::string FileSystem::Session::getCurrentPath() const {
+		return pathOf(m_pwd);
+	}
+
+	std::vector<std::string> FileSystem::Session::findFile(std::string&& fileName) const {
+		return m_fileSystem->findFile(std::move(fileName));
+	}
+
+	std::vector<std::string> FileSystem::Session::findFileContaining(std::string&& fragment) const {
+		return m_fileSystem->findFileContaining(std::move(fragment));
+	}
+
+	std::vector<std::string> FileSystem::Session::findFileMatching(std::string&& pattern) const {
+		return m_fileSystem->findFileMatching(std::move(pattern));
+	}
+
+	size_t FileSystem::Session::write(std::string&& path, const uint64_t offset, std::span<const std::byte> data) {
+		return m_fileSystem->write(m_pwd, path, offset, data);
+	}
+
+	size_t FileSystem::Session::read(std::string&& path, const uint64_t offset, std::span<std::byte> buffer) const {
+		return m_fileSystem->read(m_pwd, path, offset, buffer);
+	}
+
+	FileSystem::FileView FileSystem::Session::readView(std::string&& path, const uint64_t offset, const uint64_t length) const {
+		return m_fileSystem->readView(m_pwd, path, offset, length);
+	}
+
+	void FileSystem::Session::truncate(std::string&& path, const uint64_t size) {
+		m_fileSystem->truncate(m_pwd, path, size);
+	}
+
+	uint64_t FileSystem::Session::fileSize(std::string&& path) const {
+		return m_fileSystem->fileSize(m_pwd, path);
+	}
+
+	FileSystem::Stat FileSystem::Session::stat(std::string&& path) const {
+		return m_fileSystem->stat(m_pwd, path);
+	}
+
+	size_t FileSystem::Session::watch(std::string&& path, const bool isRecursive, WatchCallback callback) {
+		return m_fileSystem->watch(m_pwd, path, isRecursive, std::move(callback));
+	}
+
+	const std::shared_ptr<FileSystem::Directory> FileSystem::getRoot() const {
+		return m_root;
+	}
+
+	std::shared_ptr<FileSystem::Directory> FileSystem::getPwd() const {
+		return pwd();
+	}
+
+	FileSystem::Session FileSystem::openSession() {
+		return Session(*this, m_root);
+	}
+
+	FileSystem::FileView::FileView()
+		: m_blocks()
+		, m_spans()
+		, m_size(0) {}
+
+	const std::vector<std::span<const std::byte>>& FileSystem::FileView::spans() const noexcept {
+		return m_spans;
+	}
+
+	uint64_t FileSystem::FileView::size() const noexcept {
+		return m_size;
+	}
+
+	FileSystem::Snapshot::Files::Files()
+		: m_files(std::make_shared<const std::vector<File>>()) {}
+
+	FileSystem::Snapshot::Files::Files(std::vector<File>&& files)
+		: m_files(std::make_shared<const std::vector<File>>(std::move(files))) {}
+
+	size_t FileSystem::Snapshot::Files::size() const noexcept {
+		return m_files->size();
+	}
+
+	bool FileSystem::Snapshot::Files::empty() const noexcept {
+		return m_files->empty();
+	}
+
+	const FileSystem::Snapshot::File& FileSystem::Snapshot::Files::operator[](const size_t index) const {
+		return (*m_files)[index];
+	}
+
+	FileSystem::Snapshot::Files::const_iterator FileSystem::Snapshot::Files::begin() const noexcept {
+		return m_files->cbegin();
+	}
+
+	FileSystem::Snapshot::Files::const_iterator FileSystem::Snapshot::Files::end() const noexcept {
+		return m_files->cend();
+	}
+
+	FileSystem::Snapshot::Files::const_iterator FileSystem::Snapshot::Files::cbegin() const noexcept {
+		return m_files->cbegin();
+	}
+
+	FileSystem::Snapshot::Files::const_iterator FileSystem::Snapshot::Files::cend() const noexcept {
+		return m_files->cend();
+	}
+
+	FileSystem::Snapshot::Snapshot(std::shared_ptr<const Directory> root)
+		: m_root(std::move(root)) {}
+
+	const std::shared_ptr<const FileSystem::Snapshot::Directory>& FileSystem::Snapshot::getRoot() const noexcept {
+		return m_root;
+	}
+
+	std::shared_ptr<const FileSystem::Snapshot::Directory> FileSystem::Snapshot::getDirectory(std::string_view path) const {
+		// the directories from the root down, so ".." can step back up
+		std::vector<std::shared_ptr<const Directory>> dirs{ m_root };
+		PathTokenizer tokenizer(path);
+		std::string_view token;
+		while (tokenizer.next(token)) {
+			if (token == "..") {
+				if (dirs.size() == 1) {
+					throw std::invalid_argument(m_root->name + " does not have a parent directory");
+				}
+				dirs.pop_back();
+				continue;
+			}
+			const auto& childDirs = dirs.back()->childDirs;
+			const auto childIt = std::lower_bound(childDirs.cbegin(), childDirs.cend(), token,
+				[](const std::shared_ptr<const Directory>& childDir, std::string_view name) { return childDir->name < name; });
+			if (childIt == childDirs.cend() || (*childIt)->name != token) {
+				throw std::invalid_argument(std::string(token) + " is not recognised");
+			}
+			dirs.push_back(*childIt);
+		}
+		return dirs.back();
+	}
+
+	void FileSystem::Snapshot::printTreeRecursive(const Directory& dir, std::string& indents, std::string& output) {
+		output += '\n';
+		output += indents;
+		output += dir.name;
+		indents.push_back('\t');
+		for (const File& file : dir.files) {
+			output += '\n';
+			output += indents;
+			output += file.name;
+		}
+		for (const std::shared_ptr<const Directory>& childDir : dir.childDirs) {
+			printTreeRecursive(*childDir, indents, output);
+		}
+		indents.pop_back();
+	}
+
+	std::string FileSystem::Snapshot::printTree(std::string_view path) const {
+		std::string indents;
+		std::string output;
+		printTreeRecursive(*getDirectory(path), indents, output);
+		// the first line carries no leading newline
+		return output.substr(1);
+	}
+
+	void FileSystem::Snapshot::findFileRecursive(const Directory& dir, std::string& path, std::string_view fileName, std::vector<std::string>& filePaths) {
+		const auto fileIt = std::lower_bound(dir.files.cbegin(), dir.files.cend(), fileName,
+			[](const File& file, std::string_view name) { return file.name < name; });
+		if (fileIt != dir.files.cend() && fileIt->name == fileName) {
+			filePaths.push_back(path + '/' + std::string(fileName));
+		}
+		for (const std::shared_ptr<const Directory>& childDir : dir.childDirs) {
+			const size_t pathSize = path.size();
+			path += '/';
+			path += childDir->name;
+			findFileRecursive(*childDir, path, fileName, filePaths);
+			path.resize(pathSize);
+		}
+	}
+
+	std::vector<std::string> FileSystem::Snapshot::findFile(std::string_view fileName) const {
+		std::string path;
+		std::vector<std::string> filePaths;
+		findFileRecursive(*m_root, path, fileName, filePaths);
+		return filePaths;
+	}
+
+	const FileSystem::Snapshot::File& FileSystem::Snapshot::getFile(std::string_view path) const {
+		const auto [parentPath, fileName] = splitLast(path);
+		const std::shared_ptr<const Directory> dir = getDirectory(parentPath);
+		const auto fileIt = std::lower_bound(dir->files.cbegin(), dir->files.cend(), fileName,
+			[](const File& file, std::string_view name) { return file.name < name; });
+		if (fileIt == dir->files.cend() || fileIt->name != fileName) {
+			throw std::invalid_argument(std::string(fileName) + " does not exist");
+		}
+		// the snapshot holds every directory below its root, so the entry outlives dir
+		return *fileIt;
+	}
+
+	size_t FileSystem::Snapshot::read(std::string_view path, const uint64_t offset, std::span<std::byte> buffer) const {
+		const File& file = getFile(path);
+		return readBlocks(file.blocks.get(), file.size, offset, buffer);
+	}
+
+	FileSystem::Snapshot FileSystem::snapshot() {
+		std::lock_guard<std::mutex> freezeLock(m_freezeMutex);
+		{
+			// copies what changed since the last snapshot, the whole tree the first time, while writers go on,
+			// what they change behind the walk gets queued
+			std::shared_lock<std::shared_mutex> snapshotLock(m_snapshotMutex);
+			thawChanged();
+			freeze(m_root);
+		}
+		// no writer runs, so parent links hold still, and only what changed during the walk is copied again
+		std::unique_lock<std::shared_mutex> snapshotLock(m_snapshotMutex);
+		thawChanged();
+		return Snapshot(freeze(m_root));
+	}
+
+	FileSystem::Image FileSystem::openImage(const std::string& imagePath) {
+		const std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(imagePath);
+		const uint64_t size = file->size();
+		if (size < sizeof(ImageHeader)) {
+			throw std::runtime_error(imagePath + " is not a file system image");
+		}
+		const ImageHeader& header = *reinterpret_cast<const ImageHeader*>(file->data());
+		if (header.magic != IMAGE_MAGIC || header.version != IMAGE_VERSION || header.blockSize != BLOCK_SIZE) {
+			throw std::runtime_error(imagePath + " is not a file system image");
+		}
+		// checked without overflowing, so a corrupt count cannot wrap around the file size, an empty table may lie past the end
+		const auto fits = [size](const uint64_t offset, const uint64_t count, const uint64_t recordSize, const uint64_t alignment) {
+			return count == 0 || (offset % alignment == 0 && offset <= size && count <= (size - offset) / recordSize);
+		};
+		if (header.numDirs == 0
+			|| !fits(header.dirsOffset, header.numDirs, sizeof(ImageDir), alignof(ImageDir))
+			|| !fits(header.filesOffset, header.numFiles, sizeof(ImageFile), alignof(ImageFile))
+			|| !fits(header.blocksOffset, header.numBlocks, sizeof(ImageBlock), alignof(ImageBlock))
+			|| !fits(header.namesOffset, header.namesSize, 1, 1)
+			|| !fits(header.dataOffset, header.numDataBlocks, BLOCK_SIZE, 1)) {
+			throw std::runtime_error(imagePath + " is truncated or corrupt");
+		}
+		return Image{
+			file,
+			reinterpret_cast<const ImageDir*>(file->data() + header.dirsOffset), header.numDirs,
+			reinterpret_cast<const ImageFile*>(file->data() + header.filesOffset), header.numFiles,
+			reinterpret_cast<const ImageBlock*>(file->data() + header.blocksOffset), header.numBlocks,
+			std::string_view(reinterpret_cast<const char*>(file->data() + header.namesOffset), header.namesSize),
+			file->data() + header.dataOffset, header.numDataBlocks
+		};
+	}
+
+	std::string_view FileSystem::imageName(const uint64_t offset, const uint32_t length) const {
+		if (offset > m_image->names.size() || length > m_image->names.size() - offset) {
+			throw std::runtime_error("File system image is corrupt");
+		}
+		return m_image->names.substr(offset, length);
+	}
+
+	const FileSystem::ImageDir& FileSystem::imageDir(const uint64_t index) const {
+		const Image& image = *m_image;
+		const ImageDir& record = image.dirs[index];
+		// child directories come later in breadth first order, so a corrupt image cannot make the tree loop
+		if (uint64_t(record.firstChildDir) + record.numChildDirs > image.numDirs
+			|| (record.numChildDirs > 0 && record.firstChildDir <= index)
+			|| uint64_t(record.firstFile) + record.numFiles > image.numFiles) {
+			throw std::runtime_error("File system image is corrupt");
+		}
+		return record;
+	}
+
+	void FileSystem::materialize(const std::shared_ptr<Directory>& dir) const {
+		if (dir->isLoaded.load(std::memory_order_acquire)) {
+			return;
+		}
+		std::unique_lock<std::shared_mutex> lock(dir->mutex);
+		if (dir->isLoaded.load(std::memory_order_relaxed)) {
+			return;
+		}
+		if (dir->copiedFrom) {
+			// the child directories of a copy are there from the start, only its files are built
+			const Snapshot::Files& frozenFiles = dir->copiedFrom->files;
+			std::vector<const File*> builtFiles;
+			builtFiles.reserve(frozenFiles.size());
+			for (const Snapshot::File& frozenFile : frozenFiles) {
+				const std::shared_ptr<File> file = makeNode<File>(m_names.intern(frozenFile.name), dir);
+				if (frozenFile.size > 0 || frozenFile.blocks) {
+					FileData& data = file->ensureData();
+					data.size = frozenFile.size;
+					// the frozen file holds the map too, so a write copies it first, see ownedBlocks
+					data.blocks = std::const_pointer_cast<BlockMap>(frozenFile.blocks);
+				}
+				dir->files.emplace(file->name, file);
+				builtFiles.push_back(file.get());
+			}
+			// marked loaded under the index locks, so indexCopy either sees it built or indexes files this swaps out
+			const auto indexLocks = lockFileIndex();
+			for (size_t i = 0; i < builtFiles.size(); i++) {
+				FileIndexShard& shard = fileIndexShardOf(builtFiles[i]->name);
+				shard.files.erase(builtFiles[i]->name, &frozenFiles[i]);
+				shard.files.insert(builtFiles[i]->name, builtFiles[i], dir);
+			}
+			dir->copiedFrom.reset();
+			dir->isLoaded.store(true, std::memory_order_release);
+			return;
+		}
+		const Image& image = *m_image;
+		const ImageDir& record = imageDir(dir->imageIndex);
+		for (uint32_t i = record.firstChildDir; i < record.firstChildDir + record.numChildDirs; i++) {
+			const ImageDir& childRecord = image.dirs[i];
+			const std::shared_ptr<Directory> childDir = makeNode<Directory>(m_names.intern(imageName(childRecord.nameOffset, childRecord.nameLength)), dir);
+			childDir->isLoaded.store(false, std::memory_order_relaxed);
+			childDir->imageIndex = i;
+			childDir->bytesBelow.store(childRecord.bytesBelow, std::memory_order_relaxed);
+			childDir->numFilesBelow.store(childRecord.numFilesBelow, std::memory_order_relaxed);
+			childDir->numDirsBelow.store(childRecord.numDirsBelow, std::memory_order_relaxed);
+			dir->childDirs.emplace(childDir->name, childDir);
+			std::lock_guard<std::mutex> imageDirsLock(m_imageDirsMutex);
+			m_imageDirs.insert_or_assign(i, childDir);
+		}
+		std::vector<const File*> builtFiles;
+		builtFiles.reserve(record.numFiles);
+		for (uint32_t i = record.firstFile; i < record.firstFile + record.numFiles; i++) {
+			const ImageFile& fileRecord = image.files[i];
+			if (uint64_t(fileRecord.firstBlock) + fileRecord.numBlocks > image.numBlocks) {
+				throw std::runtime_error("File system image is corrupt");
+			}
+			const std::shared_ptr<File> file = makeNode<File>(m_names.intern(imageName(fileRecord.nameOffset, fileRecord.nameLength)), dir);
+			if (fileRecord.size > 0 || fileRecord.numBlocks > 0) {
+				FileData& data = file->ensureData();
+				data.size = fileRecord.size;
+				data.blocks = std::make_shared<BlockMap>();
+				for (uint32_t j = fileRecord.firstBlock; j < fileRecord.firstBlock + fileRecord.numBlocks; j++) {
+					const ImageBlock& block = image.blocks[j];
+					if (block.dataBlock >= image.numDataBlocks) {
+						throw std::runtime_error("File system image is corrupt");
+					}
+					// shares ownership of the read only mapping, so a write always copies the block first
+					Block* mappedBlock = reinterpret_cast<Block*>(image.data + block.dataBlock * BLOCK_SIZE);
+					data.blocks->emplace(block.index, std::shared_ptr<Block>(image.file, mappedBlock));
+				}
+			}
+			dir->files.emplace(file->name, file);
+			builtFiles.push_back(file.get());
+		}
+		// marked loaded under the index locks, so indexImage either sees it built or indexes records this swaps out
+		const auto indexLocks = lockFileIndex();
+		for (uint32_t i = 0; i < record.numFiles; i++) {
+			FileIndexShard& shard = fileIndexShardOf(builtFiles[i]->name);
+			shard.files.erase(builtFiles[i]->name, &image.files[record.firstFile + i]);
+			shard.files.insert(builtFiles[i]->name, builtFiles[i], dir);
+		}
+		dir->isLoaded.store(true, std::memory_order_release);
+	}
+
+	void FileSystem::indexImage() const {
+		if (!m_image) {
+			return;
+		}
+		std::call_once(m_imageIndexedFlag, [this]() {
+			const Image& image = *m_image;
+			m_imageParents.assign(image.numDirs, 0);
+			m_imageFileDirs.assign(image.numFiles, 0);
+			for (uint64_t i = 0; i < image.numDirs; i++) {
+				const ImageDir& record = imageDir(i);
+				for (uint32_t j = record.firstChildDir; j < record.firstChildDir + record.numChildDirs; j++) {
+					m_imageParents[j] = static_cast<uint32_t>(i);
+				}
+				for (uint32_t j = record.firstFile; j < record.firstFile + record.numFiles; j++) {
+					m_imageFileDirs[j] = static_cast<uint32_t>(i);
+				}
+				if (record.numFiles == 0) {
+					continue;
+				}
+				const auto indexLocks = lockFileIndex();
+				{
+					// a directory already built indexed its own files
+					std::lock_guard<std::mutex> imageDirsLock(m_imageDirsMutex);
+					const auto dirIt = m_imageDirs.find(static_cast<uint32_t>(i));
+					if (dirIt != m_imageDirs.cend()) {
+						const std::shared_ptr<Directory> dir = dirIt->second.lock();
+						if (dir && dir->isLoaded.load(std::memory_order_acquire)) {
+							continue;
+						}
+					}
+				}
+				for (uint32_t j = record.firstFile; j < record.firstFile + record.numFiles; j++) {
+					const std::string_view name = imageName(image.files[j].nameOffset, image.files[j].nameLength);
+					fileIndexShardOf(name).files.insert(name, &image.files[j], std::weak_ptr<Directory>());
+				}
+			}
+			m_isImageIndexed.store(true, std::memory_order_release);
+		});
+	}
+
+	std::shared_ptr<FileSystem::Directory> FileSystem::builtImageDir(const uint32_t index) const {
+		// up to the closest directory already built, the root always is and parents come first in the image
+		std::vector<uint32_t> unbuiltDirs;
+		std::shared_ptr<Directory> dir;
+		for (uint32_t i = index; ; i = m_imageParents[i]) {
+			std::lock_guard<std::mutex> imageDirsLock(m_imageDirsMutex);
+			const auto dirIt = m_imageDirs.find(i);
+			if (dirIt != m_imageDirs.cend()) {
+				dir = dirIt->second.lock();
+				break;
+			}
+			unbuiltDirs.push_back(i);
+		}
+		for (; dir && !unbuiltDirs.empty(); unbuiltDirs.pop_back()) {
+			materialize(dir);
+			std::lock_guard<std::mutex> imageDirsLock(m_imageDirsMutex);
+			const auto dirIt = m_imageDirs.find(unbuiltDirs.back());
+			dir = dirIt != m_imageDirs.cend() ? dirIt->second.lock() : nullptr;
+		}
+		return dir;
+	}
+
+	const FileSystem::ImageFile* FileSystem::imageFileOf(const void* key) const {
+		if (!m_image) {
+			return nullptr;
+		}
+		const std::less<const void*> isBefore;
+		const ImageFile* files = m_image->files;
+		return !isBefore(key, files) && isBefore(key, files + m_image->numFiles) ? static_cast<const ImageFile*>(key) : nullptr;
+	}
+
+	void FileSystem::save(const std::string& imagePath) const {
+		std::vector<ImageDir> dirs;
+		std::vector<ImageFile> files;
+		std::vector<ImageBlock> blocks;
+		std::string names;
+		std::vector<std::shared_ptr<const Block>> dataBlocks;
+		{
+			// the nodes and their names hold still until the tree is flattened
+			std::unique_lock<std::shared_mutex> snapshotLock(m_snapshotMutex);
+			std::unordered_map<std::string_view, uint64_t> nameOffsets;
+			std::unordered_map<const Block*, uint64_t> dataBlockIndices;
+			const auto intern = [&names, &nameOffsets](std::string_view name) {
+				const auto [nameIt, isNew] = nameOffsets.try_emplace(name, names.size());
+				if (isNew) {
+					names += name;
+				}
+				return nameIt->second;
+			};
+			const auto byName = [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; };
+			// breadth first, so the queue index of a directory is its record index
+			std::vector<std::shared_ptr<Directory>> queue{ m_root };
+			std::vector<std::pair<std::string_view, std::shared_ptr<Directory>>> childDirs;
+			std::vector<std::pair<std::string_view, std::shared_ptr<File>>> dirFiles;
+			for (size_t i = 0; i < queue.size(); i++) {
+				const std::shared_ptr<Directory> dir = queue[i];
+				materialize(dir);
+				std::shared_lock<std::shared_mutex> lock(dir->mutex);
+				childDirs.assign(dir->childDirs.cbegin(), dir->childDirs.cend());
+				dirFiles.assign(dir->files.cbegin(), dir->files.cend());
+				std::sort(childDirs.begin(), childDirs.end(), byName);
+				std::sort(dirFiles.begin(), dirFiles.end(), byName);
+				ImageDir& record = dirs.emplace_back();
+				record.nameOffset = intern(dir->name);
+				record.nameLength = static_cast<uint32_t>(dir->name.size());
+				record.firstChildDir = static_cast<uint32_t>(queue.size());
+				record.numChildDirs = static_cast<uint32_t>(childDirs.size());
+				record.firstFile = static_cast<uint32_t>(files.size());
+				record.numFiles = static_cast<uint32_t>(dirFiles.size());
+				for (auto& [name, childDir] : childDirs) {
+					queue.push_back(std::move(childDir));
+				}
+				for (const auto& [name, file] : dirFiles) {
+					ImageFile& fileRecord = files.emplace_back();
+					fileRecord.nameOffset = intern(name);
+					fileRecord.nameLength = static_cast<uint32_t>(name.size());
+					fileRecord.size = 0;
+					fileRecord.firstBlock = static_cast<uint32_t>(blocks.size());
+					fileRecord.numBlocks = 0;
+					const FileData* data = file->findData();
+					if (!data) {
+						continue;
+					}
+					std::shared_lock<std::shared_mutex> dataLock(data->mutex);
+					fileRecord.size = data->size;
+					if (!data->blocks) {
+						continue;
+					}
+					fileRecord.numBlocks = static_cast<uint32_t>(data->blocks->size());
+					for (const auto& [index, block] : *data->blocks) {
+						const auto [dataIt, isNew] = dataBlockIndices.try_emplace(block.get(), dataBlocks.size());
+						if (isNew) {
+							dataBlocks.push_back(block);
+						}
+						blocks.push_back(ImageBlock{ index, dataIt->second });
+					}
+				}
+			}
+			if (queue.size() > UINT32_MAX || files.size() > UINT32_MAX || blocks.size() > UINT32_MAX) {
+				throw std::runtime_error("File system is too large for an image");
+			}
+		}
+		// children come after their parent, so backwards every child is summed up before its parent
+		for (size_t i = dirs.size(); i-- > 0;) {
+			ImageDir& record = dirs[i];
+			record.bytesBelow = 0;
+			record.numFilesBelow = record.numFiles;
+			record.numDirsBelow = record.numChildDirs;
+			for (uint32_t j = record.firstFile; j < record.firstFile + record.numFiles; j++) {
+				record.bytesBelow += files[j].size;
+			}
+			for (uint32_t j = record.firstChildDir; j < record.firstChildDir + record.numChildDirs; j++) {
+				record.bytesBelow += dirs[j].bytesBelow;
+				record.numFilesBelow += dirs[j].numFilesBelow;
+				record.numDirsBelow += dirs[j].numDirsBelow;
+			}
+		}
+
+		// the blocks are shared with the tree, a later write copies them rather than changing what is written here
+		ImageHeader header{};
+		header.magic = IMAGE_MAGIC;
+		header.version = IMAGE_VERSION;
+		header.blockSize = BLOCK_SIZE;
+		header.numDirs = dirs.size();
+		header.numFiles = files.size();
+		header.numBlocks = blocks.size();
+		header.numDataBlocks = dataBlocks.size();
+		header.dirsOffset = alignUp(sizeof(ImageHeader), alignof(ImageDir));
+		header.filesOffset = alignUp(header.dirsOffset + dirs.size() * sizeof(ImageDir), alignof(ImageFile));
+		header.blocksOffset = alignUp(header.filesOffset + files.size() * sizeof(ImageFile), alignof(ImageBlock));
+		header.namesOffset = header.blocksOffset + blocks.size() * sizeof(ImageBlock);
+		header.namesSize = names.size();
+		header.dataOffset = alignUp(header.namesOffset + names.size(), BLOCK_SIZE);
+
+		// written beside the old image and renamed over it, so a process mapping the old one keeps its file
+		const std::string tempPath = imagePath + ".tmp";
+		{
+			std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+			uint64_t position = 0;
+			const auto writeAt = [&out, &position](const uint64_t offset, const void* data, const uint64_t size) {
+				static const char padding[BLOCK_SIZE] = {};
+				out.write(padding, static_cast<std::streamsize>(offset - position));
+				out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+				position = offset + size;
+			};
+			writeAt(0, &header, sizeof(header));
+			writeAt(header.dirsOffset, dirs.data(), dirs.size() * sizeof(ImageDir));
+			writeAt(header.filesOffset, files.data(), files.size() * sizeof(ImageFile));
+			writeAt(header.blocksOffset, blocks.data(), blocks.size() * sizeof(ImageBlock));
+			writeAt(header.namesOffset, names.data(), names.size());
+			for (size_t i = 0; i < dataBlocks.size(); i++) {
+				writeAt(header.dataOffset + i * BLOCK_SIZE, dataBlocks[i]->bytes, BLOCK_SIZE);
+			}
+			out.flush();
+			if (!out) {
+				throw std::runtime_error("Cannot write " + tempPath);
+			}
+		}
+		std::filesystem::rename(tempPath, imagePath);
+	}
+
+	void FileSystem::markChanged(const std::shared_ptr<Directory>& dir) const {
+		// a directory not frozen is refrozen anyway, as is everything created below one that changed,
+		// and one changed before is already queued
+		if (dir->isChanged.exchange(true) || !dir->isFrozen.load()) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(m_changedDirsMutex);
+		m_changedDirs.push_back(dir);
+	}
+
+	void FileSystem::thawChanged() const {
+		std::vector<std::weak_ptr<Directory>> changedDirs;
+		{
+			std::lock_guard<std::mutex> lock(m_changedDirsMutex);
+			changedDirs.swap(m_changedDirs);
+		}
+		// parent links only change while it is held exclusively
+		std::shared_lock<std::shared_mutex> totalsLock(m_totalsMutex);
+		for (const std::weak_ptr<Directory>& changedDir : changedDirs) {
+			// the frozen copies above a change point at its stale copy
+			for (std::shared_ptr<Directory> dir = changedDir.lock(); dir; dir = dir->parent.lock()) {
+				dir->isFrozen = false;
+			}
+		}
+	}
+
+	FileSystem::TotalsDelta FileSystem::TotalsDelta::operator-() const {
+		return TotalsDelta{ -bytes, -numFiles, -numDirs };
+	}
+
+	void FileSystem::addToTotals(std::shared_ptr<Directory> dir, const TotalsDelta& delta) {
+		// wraps around for a negative delta, which lands on the right total since it never drops below zero
+		for (; dir; dir = dir->parent.lock()) {
+			dir->bytesBelow.fetch_add(static_cast<uint64_t>(delta.bytes), std::memory_order_relaxed);
+			dir->numFilesBelow.fetch_add(static_cast<uint64_t>(delta.numFiles), std::memory_order_relaxed);
+			dir->numDirsBelow.fetch_add(static_cast<uint64_t>(delta.numDirs), std::memory_order_relaxed);
+		}
+	}
+
+	FileSystem::TotalsDelta FileSystem::totalsOf(const std::shared_ptr<File>& node) {
+		if (const Directory* dir = dynamic_cast<const Directory*>(node.get())) {
+			return TotalsDelta{
+				static_cast<int64_t>(dir->bytesBelow.load(std::memory_order_relaxed)),
+				static_cast<int64_t>(dir->numFilesBelow.load(std::memory_order_relaxed)),
+				static_cast<int64_t>(dir->numDirsBelow.load(std::memory_order_relaxed)) + 1
+			};
+		}
+		const FileData* data = node->findData();
+		if (!data) {
+			return TotalsDelta{ 0, 1, 0 };
+		}
+		std::shared_lock<std::shared_mutex> lock(data->mutex);
+		return TotalsDelta{ static_cast<int64_t>(data->size), 1, 0 };
+	}
+
+	std::shared_ptr<const FileSystem::Snapshot::Directory> FileSystem::freeze(const std::shared_ptr<Directory>& dir) const {
+		if (dir->frozen && dir->isFrozen.load()) {
+			return dir->frozen;
+		}
+		const std::shared_ptr<Snapshot::Directory> frozen = std::make_shared<Snapshot::Directory>();
+		// the frozen directory whose files this one shares, if any
+		std::shared_ptr<const Snapshot::Directory> base;
+		std::vector<Snapshot::File> files;
+		std::vector<std::shared_ptr<Directory>> childDirs;
+		{
+			std::shared_lock<std::shared_mutex> lock(dir->mutex);
+			// a copy not built yet is frozen from what it was copied from, a directory of the image is built first
+			if (!dir->isLoaded.load(std::memory_order_acquire) && !dir->copiedFrom) {
+				lock.unlock();
+				materialize(dir);
+				lock.lock();
+			}
+			// before the entries and file data are read, a change that lands after then finds it set and queues the directory
+			dir->isFrozen = true;
+			const bool wasChanged = dir->isChanged.exchange(false);
+			frozen->name = dir->name;
+			if (dir->copiedFrom) {
+				base = dir->copiedFrom;
+			}
+			else if (!wasChanged) {
+				base = dir->frozen;
+			}
+			if (!base) {
+				files.reserve(dir->files.size());
+				for (const auto& [name, filePtr] : dir->files) {
+					Snapshot::File& frozenFile = files.emplace_back(Snapshot::File{ std::string(name), 0, nullptr });
+					if (const FileData* data = filePtr->findData()) {
+						std::shared_lock<std::shared_mutex> dataLock(data->mutex);
+						frozenFile.size = data->size;
+						frozenFile.blocks = data->blocks;
+					}
+				}
+			}
+			childDirs.reserve(dir->childDirs.size());
+			for (const auto& [name, childDir] : dir->childDirs) {
+				childDirs.push_back(childDir);
+			}
+		}
+		uint64_t bytesOfFiles = 0;
+		if (base) {
+			frozen->files = base->files;
+			bytesOfFiles = base->bytesBelow;
+			for (const std::shared_ptr<const Snapshot::Directory>& childDir : base->childDirs) {
+				bytesOfFiles -= childDir->bytesBelow;
+			}
+		}
+		else {
+			std::sort(files.begin(), files.end(), [](const auto& lhs, const auto& rhs) { return lhs.name < rhs.name; });
+			for (const Snapshot::File& file : files) {
+				bytesOfFiles += file.size;
+			}
+			frozen->files = Snapshot::Files(std::move(files));
+		}
+		frozen->bytesBelow = bytesOfFiles;
+		frozen->numFilesBelow = frozen->files.size();
+		frozen->numDirsBelow = childDirs.size();
+		frozen->childDirs.reserve(childDirs.size());
+		for (const std::shared_ptr<Directory>& childDir : childDirs) {
+			const std::shared_ptr<const Snapshot::Directory>& frozenChild = frozen->childDirs.emplace_back(freeze(childDir));
+			frozen->bytesBelow += frozenChild->bytesBelow;
+			frozen->numFilesBelow += frozenChild->numFilesBelow;
+			frozen->numDirsBelow += frozenChild->numDirsBelow;
+		}
+		// by the copied names, a child renamed meanwhile has queued this directory, which is refrozen before use
+		std::sort(frozen->childDirs.begin(), frozen->childDirs.end(), [](const auto& lhs, const auto& rhs) { return lhs->name < rhs->name; });
+		// nothing changed that the copy it shares its files with would not show, eg an unchanged copy of a directory
+		if (base && base->name == frozen->name && base->childDirs == frozen->childDirs) {
+			dir->frozen = base;
+		}
+		else {
+			dir->frozen = frozen;
+		}
+		return dir->frozen;
+	}
+
+	std::shared_ptr<FileSystem::Directory> FileSystem::pwd() const {
+		std::lock_guard<std::mutex> lock(m_pwdMutex);
+		return m_pwd;
+	}
+
+	bool FileSystem::isAncestor(const Directory* ancestor, const Directory* dir) {
+		// held while stepping up, a detached subtree may lose its ancestors meanwhile
+		std::shared_ptr<Directory> parent;
+		while (dir) {
+			if (dir == ancestor) {
+				return true;
+			}
+			parent = dir->parent.lock();
+			dir = parent.get();
+		}
+		return false;
+	}
+
+	template <class Node, class... Args>
+	std::shared_ptr<Node> FileSystem::makeNode(Args&&... args) const {
+		return std::allocate_shared<Node>(SlabAllocator<Node>(m_inodeArena), std::forward<Args>(args)...);
+	}
+
+	std::pair<std::string_view, std::string_view> FileSystem::splitLast(std::string_view path) {
+		while (path.size() > 1 && path.back() == '/') {
+			path.remove_suffix(1);
+		}
+		const size_t slash = path.rfind('/');
+		if (slash == std::string_view::npos) {
+			return { std::string_view(), path };
+		}
+		// the root keeps its slash so the parent of "/a" stays absolute
+		return { path.substr(0, std::max<size_t>(slash, 1)), path.substr(slash + 1) };
+	}
+
+	std::shared_ptr<FileSystem::Directory> FileSystem::getDirectory(const std::shared_ptr<Directory>& workingDir, std::string_view path, const bool shouldCreateMissingDirectories) const {
+		const std::shared_ptr<Directory>& baseDir = !path.empty() && path.front() == '/' ? m_root : workingDir;
+		if (path.empty() || m_dentryCapacity == 0) {
+			return walkPath(baseDir, path, shouldCreateMissingDirectories);
+		}
+		const DentryKeyView key{ baseDir.get(), path };
+		DentryShard& shard = m_dentryShards[DentryKeyHash()(key) % NUM_SHARDS];
+		// read before the walk, so a directory removed during the walk makes the result stale
+		const uint64_t generation = m_dentryGeneration.load(std::memory_order_acquire);
+		{
+			std::shared_lock<std::shared_mutex> lock(shard.mutex);
+			if (const Dentry* dentry = shard.dentries.find(key)) {
+				std::shared_ptr<Directory> cachedDir = dentry->dir.lock();
+				if (cachedDir && dentry->generation == generation) {
+					dentry->isReferenced.store(true, std::memory_order_relaxed);
+					return cachedDir;
+				}
+			}
+		}
+		std::shared_ptr<Directory> currentDir = walkPath(baseDir, path, shouldCreateMissingDirectories);
+		std::lock_guard<std::shared_mutex> lock(shard.mutex);
+		if (generation != m_dentryGeneration.load(std::memory_order_acquire)) {
+			return currentDir;
+		}
+		if (const Dentry* dentry = shard.dentries.find(key)) {
+			if (dentry->generation == generation && !dentry->dir.expired()) {
+				// another thread cached it meanwhile
+				return currentDir;
+			}
+			shard.dentries.erase(key);
+		}
+		shard.dentries.tryEmplaceAtTail(DentryKey{ baseDir.get(), std::string(path) }, generation, currentDir);
+		while (shard.dentries.size() > m_dentryCapacity) {
+			const auto oldest = shard.dentries.begin();
+			if (oldest.value().isReferenced.exchange(false, std::memory_order_relaxed)) {
+				shard.dentries.moveToEnd(oldest.key());
+			}
+			else {
+				shard.dentries.erase(oldest.key());
+			}
+		}
+		return currentDir;
+	}
+
+	std::shared_ptr<FileSystem::Directory> FileSystem::walkPath(std::shared_ptr<Directory> currentDir, std::string_view path, const bool shouldCreateMissingDirectories) const {
+		PathTokenizer tokenizer(path);
+		std::string_view token;
+		// reported once the walk lets go of its locks
+		std::vector<std::tuple<uint64_t, std::shared_ptr<Directory>, std::string>> createdDirs;
+		// every sequence taken must be queued, so the directories created before a bad token are reported too
+		const auto reportCreatedDirs = [this, &createdDirs]() {
+			for (const auto& [sequence, parentDir, name] : createdDirs) {
+				notifyWatches(sequence, WatchEvent::Kind::Created, true, parentDir, name);
+			}
+		};
+		std::shared_lock<std::shared_mutex> lock;
+		try {
+			materialize(currentDir);
+			lock = std::shared_lock<std::shared_mutex>(currentDir->mutex);
+			while (tokenizer.next(token)) {
+				std::shared_ptr<Directory> nextDir;
+				if (token == "..") {
+					nextDir = currentDir->parent.lock();
+					if (!nextDir) {
+						throw std::invalid_argument(currentDir->name.str() + " does not have a parent directory");
+					}
+					// locks are only taken parent before child, so the child is let go before its parent is locked
+					lock.unlock();
+					lock = std::shared_lock<std::shared_mutex>(nextDir->mutex);
+					currentDir = std::move(nextDir);
+					continue;
+				}
+				const auto nextDirIt = currentDir->childDirs.find(token);
+				if (nextDirIt != currentDir->childDirs.cend()) {
+					if (!nextDirIt->second->isDirectory()) {
+						throw std::invalid_argument(std::string(nextDirIt->first) + " is not a directory");
+					}
+					nextDir = nextDirIt->second;
+				}
+				else if (shouldCreateMissingDirectories) {
+					lock.unlock();
+					std::unique_lock<std::shared_mutex> writeLock(currentDir->mutex);
+					// another writer may have created it while no lock was held
+					auto createdIt = currentDir->childDirs.find(token);
+					if (createdIt == currentDir->childDirs.end()) {
+						const std::shared_ptr<Directory> createdDir = makeNode<Directory>(m_names.intern(token), currentDir);
+						createdIt = currentDir->childDirs.emplace(createdDir->name, createdDir).first;
+						markChanged(currentDir);
+						std::shared_lock<std::shared_mutex> totalsLock(m_totalsMutex);
+						addToTotals(currentDir, TotalsDelta{ 0, 0, 1 });
+						if (const std::optional<uint64_t> sequence = stampWatchEvent()) {
+							createdDirs.emplace_back(*sequence, currentDir, createdDir->name);
+						}
+					}
+					nextDir = createdIt->second;
+					std::shared_lock<std::shared_mutex> nextLock(nextDir->mutex);
+					writeLock.unlock();
+					lock = std::move(nextLock);
+					currentDir = std::move(nextDir);
+					continue;
+				}
+				else {
+					throw std::invalid_argument(std::string(token) + " is not recognised");
+				}
+				// hand over hand, the child is locked before the parent is released so it cannot be moved in between
+				materialize(nextDir);
+				std::shared_lock<std::shared_mutex> nextLock(nextDir->mutex);
+				lock = std::move(nextLock);
+				currentDir = std::move(nextDir);
+			}
+		}
+		catch (...) {
+			if (lock.owns_lock()) {
+				lock.unlock();
+			}
+			reportCreatedDirs();
+			throw;
+		}
+		lock.unlock();
+		reportCreatedDirs();
+		return currentDir;
+	}
+
+	void FileSystem::invalidateDentries() {
+		m_dentryGeneration.fetch_add(1, std::memory_order_acq_rel);
+	}
+
+	std::shared_ptr<FileSystem::File> FileSystem::makeFile(std::string&& pathToNewFile, const bool isDirectory, const bool shouldCreateMissingDirectories) {
+		return makeFile(pwd(), pathToNewFile, isDirectory, shouldCreateMissingDirectories);
+	}
+
+	std::shared_ptr<FileSystem::File> FileSystem::makeFile(const std::shared_ptr<Directory>& workingDir, std::string_view pathToNewFile, const bool isDirectory, const bool shouldCreateMissingDirectories) {
+		const auto [parentPath, fileName] = splitLast(pathToNewFile);
+		const std::string fileToCreate(fileName);
+		if (fileToCreate.empty()) {
+			throw std::invalid_argument("Create path is invalid");
+		}
+		std::shared_lock<std::shared_mutex> snapshotLock(m_snapshotMutex);
+		std::shared_ptr<Directory> dirToCreateIn = getDirectory(workingDir, parentPath, shouldCreateMissingDirectories);
+		std::unique_lock<std::shared_mutex> lock(dirToCreateIn->mutex);
+		if (dirToCreateIn->childDirs.find(fileToCreate) != dirToCreateIn->childDirs.cend()
+			|| dirToCreateIn->files.find(fileToCreate) != dirToCreateIn->files.cend()) {
+			throw std::invalid_argument(fileToCreate + " already exists");
+		}
+		markChanged(dirToCreateIn);
+		if (isDirectory) {
+			const std::shared_ptr<Directory> createdDir = makeNode<Directory>(m_names.intern(fileToCreate), dirToCreateIn);
+			dirToCreateIn->childDirs.emplace(createdDir->name, createdDir);
+			const std::optional<uint64_t> sequence = stampWatchEvent();
+			lock.unlock();
+			{
+				std::shared_lock<std::shared_mutex> totalsLock(m_totalsMutex);
+				addToTotals(dirToCreateIn, TotalsDelta{ 0, 0, 1 });
+			}
+			notifyWatches(sequence, WatchEvent::Kind::Created, true, dirToCreateIn, fileToCreate);
+			return createdDir;
+		}
+		const std::shared_ptr<File> createdFile = makeNode<File>(m_names.intern(fileToCreate), dirToCreateIn);
+		dirToCreateIn->files.emplace(createdFile->name, createdFile);
+		// while the directory is still locked, so a remove of the new file cannot reach the index before it
+		indexFile(fileToCreate, createdFile, dirToCreateIn);
+		const std::optional<uint64_t> sequence = stampWatchEvent();
+		lock.unlock();
+		{
+			std::shared_lock<std::shared_mutex> totalsLock(m_totalsMutex);
+			addToTotals(dirToCreateIn, TotalsDelta{ 0, 1, 0 });
+		}
+		notifyWatches(sequence, WatchEvent::Kind::Created, false, dirToCreateIn, fileToCreate);
+		return createdFile;
+	}
+
+	std::shared_ptr<FileSystem::Directory> FileSystem::changeDirectory(std::string&& path) {
+		std::shared_ptr<Directory> dir = getDirectory(pwd(), path, false);
+		std::lock_guard<std::mutex> lock(m_pwdMutex);
+		return m_pwd = std::move(dir);
+	}
+
+	std::shared_ptr<FileSystem::File> FileSystem::removeFile(std::string&& pathToRemove) {
+		return removeFile(pwd(), pathToRemove);
+	}
+
+	std::shared_ptr<FileSystem::File> FileSystem::removeFile(const std::shared_ptr<Directory>& workingDir, std::string_view pathToRemove) {
+		const auto [parentPath, fileName] = splitLast(pathToRemove);
+		const std::string fileToRemove(fileName);
+		if (fileToRemove.empty()) {
+			throw std::invalid_argument("Remove path is invalid");
+		}
+		std::shared_lock<std::shared_mutex> snapshotLock(m_snapshotMutex);
+		std::shared_ptr<Directory> dirToRemoveFrom = getDirectory(workingDir, parentPath, false);
+		std::unique_lock<std::shared_mutex> lock(dirToRemoveFrom->mutex);
+		const auto& removeDirIt = dirToRemoveFrom->childDirs.find(fileToRemove);
+		if (removeDirIt != dirToRemoveFrom->childDirs.cend()) {
+			const std::shared_ptr<Directory> removedDir = removeDirIt->second;
+			dirToRemoveFrom->childDirs.erase(removeDirIt);
+			markChanged(dirToRemoveFrom);
+			{
+				// detached, so index hits inside the removed subtree no longer reach the root
+				std::unique_lock<std::shared_mutex> removedLock(removedDir->mutex);
+				std::unique_lock<std::shared_mutex> totalsLock(m_totalsMutex);
+				removedDir->parent.reset();
+				addToTotals(dirToRemoveFrom, -totalsOf(removedDir));
+			}
+			unindexTree(removedDir);
+			const std::optional<uint64_t> sequence = stampWatchEvent();
+			lock.unlock();
+			invalidateDentries();
+			notifyWatches(sequence, WatchEvent::Kind::Removed, true, dirToRemoveFrom, fileToRemove);
+			return removedDir;
+		}
+		const auto& removeFileIt = dirToRemoveFrom->files.find(fileToRemove);
+		if (removeFileIt != dirToRemoveFrom->files.cend()) {
+			const std::shared_ptr<File> removedFile = removeFileIt->second;
+			dirToRemoveFrom->files.erase(removeFileIt);
+			markChanged(dirToRemoveFrom);
+			{
+				// a write still in flight to the removed file no longer reaches the totals
+				std::unique_lock<std::shared_mutex> totalsLock(m_totalsMutex);
+				removedFile->parent.reset();
+				addToTotals(dirToRemoveFrom, -totalsOf(removedFile));
+			}
+			unindexFile(fileToRemove, removedFile.get());
+			const std::optional<uint64_t> sequence = stampWatchEvent();
+			lock.unlock();
+			notifyWatches(sequence, WatchEvent::Kind::Removed, false, dirToRemoveFrom, fileToRemove);
+			return removedFile;
+		}
+		throw std::invalid_argument(fileToRemove + " does not exist");
+	}
+
+	std::shared_ptr<FileSystem::File> FileSystem::copyFile(const std::shared_ptr<Directory>& workingDir, std::string_view sourcePath, std::string_view destPath, const bool shouldRemoveOriginal) {
+		const auto [destParentPath, destName] = splitLast(destPath);
+		const std::string destFile(destName);
+		if (destFile.empty()) {
+			throw std::invalid_argument("Move destination path is invalid");
+		}
+		const auto [sourceParentPath, sourceName] = splitLast(sourcePath);
+		const std::string sourceFile(sourceName);
+		if (sourceFile.empty()) {
+			throw std::invalid_argument("Move source path is invalid");
+		}
+		if (!shouldRemoveOriginal) {
+			// a directory is frozen and shared rather than copied, as by snapshot, which takes it before m_snapshotMutex
+			std::unique_lock<std::mutex> freezeLock(m_freezeMutex);
+			std::shared_lock<std::shared_mutex> snapshotLock(m_snapshotMutex);
+			const std::shared_ptr<Directory> sourceDir = getDirectory(workingDir, sourceParentPath, false);
+			std::shared_ptr<File> original;
+			{
+				std::shared_lock<std::shared_mutex> lock(sourceDir->mutex);
+				const auto originalDirIt = sourceDir->childDirs.find(sourceFile);
+				const auto originalFileIt = sourceDir->files.find(sourceFile);
+				if (originalDirIt != sourceDir->childDirs.cend()) {
+					original = originalDirIt->second;
+				}
+				else if (originalFileIt != sourceDir->files.cend()) {
+					original = originalFileIt->second;
+				}
+				else {
+					throw std::invalid_argument(sourceFile + " does not exist");
+				}
+			}
+			const std::shared_ptr<Directory> originalDir = std::dynamic_pointer_cast<Directory>(original);
+			// made without a parent, so nothing reaches the copy from the root before it is in place
+			std::vector<std::shared_ptr<Directory>> copiedDirs;
+			std::shared_ptr<File> copiedFile;
+			if (originalDir) {
+				thawChanged();
+				copiedFile = copyTree(freeze(originalDir), m_names.intern(destFile), copiedDirs);
+			}
+			else {
+				copiedFile = makeNode<File>(m_names.intern(destFile), nullptr);
+				copyContents(*original, *copiedFile);
+			}
+			freezeLock.unlock();
+			// O(files), but it holds no lock but the index's, a query that reaches the copy meanwhile skips it
+			indexCopy(copiedDirs);
+			std::shared_ptr<Directory> moveDestDir;
+			std::optional<uint64_t> sequence;
+			try {
+				std::lock_guard<std::mutex> renameLock(m_renameMutex);
+				moveDestDir = getDirectory(workingDir, destParentPath, false);
+				if (originalDir && isAncestor(originalDir.get(), moveDestDir.get())) {
+					throw std::invalid_argument(originalDir->name.str() + " cannot be copied into itself");
+				}
+				std::unique_lock<std::shared_mutex> lock(moveDestDir->mutex);
+				if (moveDestDir->childDirs.find(destFile) != moveDestDir->childDirs.cend()
+					|| moveDestDir->files.find(destFile) != moveDestDir->files.cend()) {
+					throw std::invalid_argument(destFile + " already exists");
+				}
+				{
+					std::unique_lock<std::shared_mutex> copiedLock;
+					if (originalDir) {
+						copiedLock = std::unique_lock<std::shared_mutex>(copiedDirs.front()->mutex);
+					}
+					std::unique_lock<std::shared_mutex> totalsLock(m_totalsMutex);
+					copiedFile->parent = moveDestDir;
+					addToTotals(moveDestDir, totalsOf(copiedFile));
+				}
+				if (originalDir) {
+					moveDestDir->childDirs.emplace(copiedFile->name, copiedDirs.front());
+				}
+				else {
+					moveDestDir->files.emplace(copiedFile->name, copiedFile);
+					indexFile(destFile, copiedFile, moveDestDir);
+				}
+				markChanged(moveDestDir);
+				sequence = stampWatchEvent();
+			}
+			catch (...) {
+				if (originalDir) {
+					unindexTree(copiedDirs.front());
+				}
+				throw;
+			}
+			notifyWatches(sequence, WatchEvent::Kind::Created, originalDir != nullptr, moveDestDir, destFile);
+			return copiedFile;
+		}
+		std::shared_lock<std::shared_mutex> snapshotLock(m_snapshotMutex);
+		std::lock_guard<std::mutex> renameLock(m_renameMutex);
+		std::shared_ptr<Directory> moveDestDir = getDirectory(workingDir, destParentPath, false);
+		std::shared_ptr<Directory> sourceDir = getDirectory(workingDir, sourceParentPath, false);
+		const bool isDestFirst = isAncestor(moveDestDir.get(), sourceDir.get())
+			|| (!isAncestor(sourceDir.get(), moveDestDir.get()) && std::less<Directory*>()(moveDestDir.get(), sourceDir.get()));
+		std::unique_lock<std::shared_mutex> firstLock(isDestFirst ? moveDestDir->mutex : sourceDir->mutex);
+		std::unique_lock<std::shared_mutex> secondLock;
+		if (sourceDir != moveDestDir) {
+			secondLock = std::unique_lock<std::shared_mutex>(isDestFirst ? sourceDir->mutex : moveDestDir->mutex);
+		}
+		if (moveDestDir->childDirs.find(destFile) != moveDestDir->childDirs.cend()
+			|| moveDestDir->files.find(destFile) != moveDestDir->files.cend()) {
+			throw std::invalid_argument(destFile + " already exists");
+		}
+		std::shared_ptr<File> movedFile;
+		std::shared_ptr<Directory> movedDir;
+		const auto movedDirIt = sourceDir->childDirs.find(sourceFile);
+		const auto movedFileIt = sourceDir->files.find(sourceFile);
+		if (movedDirIt != sourceDir->childDirs.cend()) {
+			movedDir = movedDirIt->second;
+			movedFile = movedDir;
+		}
+		else if (movedFileIt != sourceDir->files.cend()) {
+			movedFile = movedFileIt->second;
+		}
+		else {
+			throw std::invalid_argument(sourceFile + " does not exist");
+		}
+		if (movedDir && isAncestor(movedDir.get(), moveDestDir.get())) {
+			throw std::invalid_argument(movedDir->name.str() + " cannot be moved into itself");
+		}
+
+		sourceDir->childDirs.erase(sourceFile);
+		sourceDir->files.erase(sourceFile);
+		markChanged(sourceDir);
+		markChanged(moveDestDir);
+		// directory locks come before m_totalsMutex, as for every writer
+		std::unique_lock<std::shared_mutex> movedLock;
+		if (movedDir) {
+			movedLock = std::unique_lock<std::shared_mutex>(movedDir->mutex);
+		}
+		std::unique_lock<std::shared_mutex> totalsLock(m_totalsMutex);
+		if (sourceDir != moveDestDir) {
+			const TotalsDelta movedTotals = totalsOf(movedFile);
+			addToTotals(sourceDir, -movedTotals);
+			addToTotals(moveDestDir, movedTotals);
+		}
+		if (movedDir) {
+			movedDir->name = m_names.intern(destFile);
+			movedDir->parent = moveDestDir;
+			totalsLock.unlock();
+			// its frozen copy carries the old name
+			markChanged(movedDir);
+			movedLock.unlock();
+			moveDestDir->childDirs.emplace(movedDir->name, movedDir);
+			const std::optional<uint64_t> sequence = stampWatchEvent();
+			firstLock.unlock();
+			if (secondLock) {
+				secondLock.unlock();
+			}
+			// the files inside keep their directory, so the index still holds
+			invalidateDentries();
+			notifyWatches(sequence, WatchEvent::Kind::Moved, true, sourceDir, sourceFile, moveDestDir, destFile);
+			return movedFile;
+		}
+		movedFile->name = m_names.intern(destFile);
+		movedFile->parent = moveDestDir;
+		totalsLock.unlock();
+		moveDestDir->files.emplace(movedFile->name, movedFile);
+		unindexFile(sourceFile, movedFile.get());
+		indexFile(destFile, movedFile, moveDestDir);
+		const std::optional<uint64_t> sequence = stampWatchEvent();
+		firstLock.unlock();
+		if (secondLock) {
+			secondLock.unlock();
+		}
+		notifyWatches(sequence, WatchEvent::Kind::Moved, false, sourceDir, sourceFile, moveDestDir, destFile);
+		return movedFile;
+	}
 
-	inline bool FileSystem::File::isDirectory() {
-		return false;
+	std::shared_ptr<FileSystem::Directory> FileSystem::copyTree(const std::shared_ptr<const Snapshot::Directory>& source, InternedString name, std::vector<std::shared_ptr<Directory>>& copiedDirs) const {
+		const std::shared_ptr<Directory> copy = makeNode<Directory>(std::move(name), nullptr);
+		copiedDirs.push_back(copy);
+		copy->isLoaded.store(false, std::memory_order_relaxed);
+		copy->copiedFrom = source;
+		copy->bytesBelow.store(source->bytesBelow, std::memory_order_relaxed);
+		copy->numFilesBelow.store(source->numFilesBelow, std::memory_order_relaxed);
+		copy->numDirsBelow.store(source->numDirsBelow, std::memory_order_relaxed);
+		for (const std::shared_ptr<const Snapshot::Directory>& childDir : source->childDirs) {
+			const std::shared_ptr<Directory> copiedDir = copyTree(childDir, m_names.intern(childDir->name), copiedDirs);
+			copiedDir->parent = copy;
+			copy->childDirs.emplace(copiedDir->name, copiedDir);
+		}
+		return copy;
 	}
 
-	FileSystem::Directory::Directory(const std::string& name, const std::shared_ptr<Directory>& parent)
-		: File(name)
-		, parent(parent)
-		, files()
-		, childDirs() {}
+	size_t FileSystem::bulkLoad(std::istream& manifest) {
+		// no writer can race the load for a name, so gathered entries never clash with ones made meanwhile
+		std::unique_lock<std::shared_mutex> snapshotLock(m_snapshotMutex);
+		materialize(m_root);
+		std::vector<BulkLevel> levels(1);
+		levels.front().dir = m_root;
+		size_t numCreated = 0;
+		const auto popLevelsTo = [this, &levels, &numCreated](const size_t depth) {
+			while (levels.size() > depth) {
+				numCreated += flushBulkLevel(levels.back());
+				levels.pop_back();
+			}
+		};
+		const auto enter = [this, &levels, &numCreated](std::string_view name) {
+			BulkLevel& level = levels.back();
+			std::shared_ptr<Directory> dir;
+			// a directory the input left before is found again, so unsorted input is slower but still correct
+			if (const auto gatheredIt = level.childDirs.find(name); gatheredIt != level.childDirs.cend()) {
+				dir = gatheredIt->second;
+			}
+			else {
+				std::shared_lock<std::shared_mutex> lock(level.dir->mutex);
+				if (const auto dirIt = level.dir->childDirs.find(name); dirIt != level.dir->childDirs.cend()) {
+					dir = dirIt->second;
+				}
+				else if (level.dir->files.find(name) != level.dir->files.cend()) {
+					throw std::invalid_argument(std::string(name) + " is not a directory");
+				}
+			}
+			if (!dir) {
+				dir = makeNode<Directory>(m_names.intern(name), level.dir);
+				level.childDirs.emplace(dir->name, dir);
+				numCreated++;
+			}
+			materialize(dir);
+			levels.push_back(BulkLevel{ std::move(dir), {}, {} });
+		};
+		std::string line;
+		std::vector<std::string_view> names;
+		try {
+			while (std::getline(manifest, line)) {
+				names.clear();
+				PathTokenizer tokenizer(line);
+				std::string_view token;
+				while (tokenizer.next(token)) {
+					if (token == "..") {
+						throw std::invalid_argument("Bulk load path " + line + " is invalid");
+					}
+					names.push_back(token);
+				}
+				if (names.empty()) {
+					continue;
+				}
+				const size_t numDirs = line.back() == '/' ? names.size() : names.size() - 1;
+				// levels[i + 1] is the directory names[i] led to on the path before
+				size_t depth = 0;
+				while (depth < numDirs && depth + 1 < levels.size() && levels[depth + 1].dir->name == names[depth]) {
+					depth++;
+				}
+				popLevelsTo(depth + 1);
+				for (; depth < numDirs; depth++) {
+					enter(names[depth]);
+				}
+				if (numDirs < names.size()) {
+					levels.back().files.push_back(makeNode<File>(m_names.intern(names.back()), levels.back().dir));
+				}
+			}
+		}
+		catch (...) {
+			// what was gathered before the bad entry is still added, the tree stays consistent
+			popLevelsTo(0);
+			throw;
+		}
+		popLevelsTo(0);
+		return numCreated;
+	}
 
-	inline bool FileSystem::Directory::isDirectory() {
-		return true;
+	size_t FileSystem::flushBulkLevel(BulkLevel& level) const {
+		if (level.files.empty() && level.childDirs.empty()) {
+			return 0;
+		}
+		const std::shared_ptr<Directory>& dir = level.dir;
+		std::vector<std::shared_ptr<File>> createdFiles;
+		createdFiles.reserve(level.files.size());
+		{
+			std::unique_lock<std::shared_mutex> lock(dir->mutex);
+			dir->childDirs.reserve(dir->childDirs.size() + level.childDirs.size());
+			dir->files.reserve(dir->files.size() + level.files.size());
+			for (const auto& [name, childDir] : level.childDirs) {
+				dir->childDirs.emplace(name, childDir);
+			}
+			for (std::shared_ptr<File>& file : level.files) {
+				if (dir->childDirs.find(file->name) == dir->childDirs.cend() && dir->files.emplace(file->name, file).second) {
+					createdFiles.push_back(std::move(file));
+				}
+			}
+			markChanged(dir);
+		}
+		{
+			// the gathered directories are all new, their own entries were added when the input left them
+			std::shared_lock<std::shared_mutex> totalsLock(m_totalsMutex);
+			addToTotals(dir, TotalsDelta{ 0, static_cast<int64_t>(createdFiles.size()), static_cast<int64_t>(level.childDirs.size()) });
+		}
+		// stamped after the directory lock is released, no other writer runs during a bulk load
+		std::string dirPath;
+		if (m_numWatches.load(std::memory_order_relaxed) > 0 && pathFromRoot(dir, dirPath)) {
+			for (const auto& [name, childDir] : level.childDirs) {
+				if (const std::optional<uint64_t> sequence = stampWatchEvent()) {
+					queueWatchEvent(*sequence, WatchEvent{ WatchEvent::Kind::Created, true, dirPath + '/' + std::string(name), std::string() });
+				}
+			}
+			for (const std::shared_ptr<File>& file : createdFiles) {
+				if (const std::optional<uint64_t> sequence = stampWatchEvent()) {
+					queueWatchEvent(*sequence, WatchEvent{ WatchEvent::Kind::Created, false, dirPath + '/' + file->name.str(), std::string() });
+				}
+			}
+		}
+		const auto indexLocks = lockFileIndex();
+		for (const std::shared_ptr<File>& file : createdFiles) {
+			fileIndexShardOf(file->name).files.insert(file->name, file.get(), dir);
+		}
+		return createdFiles.size();
 	}
 
-	FileSystem::FileSystem()
-		: m_root(std::make_shared<Directory>("root", nullptr))
-		, m_pwd(m_root) {}
+	size_t FileSystem::watch(std::string&& path, const bool isRecursive, WatchCallback callback) {
+		return watch(pwd(), path, isRecursive, std::move(callback));
+	}
 
-	const std::shared_ptr<FileSystem::Directory> FileSystem::getRoot() const {
-		return m_root;
+	size_t FileSystem::watch(const std::shared_ptr<Directory>& workingDir, std::string_view path, const bool isRecursive, WatchCallback callback) {
+		const std::shared_ptr<Directory> dir = getDirectory(workingDir, path, false);
+		std::string watchedPath;
+		if (!pathFromRoot(dir, watchedPath)) {
+			throw std::invalid_argument(std::string(path) + " is not recognised");
+		}
+		std::lock_guard<std::mutex> lock(m_watchesMutex);
+		if (!m_watchThread.joinable()) {
+			m_watchThread = std::thread([this]() { deliverWatchEvents(); });
+		}
+		const size_t watchId = m_nextWatchId++;
+		m_watches.push_back(std::make_shared<const Watch>(Watch{ watchId, std::move(watchedPath), isRecursive, std::move(callback) }));
+		m_numWatches.store(m_watches.size(), std::memory_order_relaxed);
+		return watchId;
 	}
 
-	std::shared_ptr<FileSystem::Directory> FileSystem::getPwd() const {
-		return m_pwd;
+	void FileSystem::unwatch(const size_t watchId) {
+		std::lock_guard<std::mutex> lock(m_watchesMutex);
+		std::erase_if(m_watches, [watchId](const std::shared_ptr<const Watch>& watch) { return watch->id == watchId; });
+		m_numWatches.store(m_watches.size(), std::memory_order_relaxed);
+	}
+
+	std::optional<uint64_t> FileSystem::stampWatchEvent() const {
+		if (m_numWatches.load(std::memory_order_relaxed) == 0) {
+			return std::nullopt;
+		}
+		return m_nextWatchSequence.fetch_add(1, std::memory_order_relaxed);
 	}
 
-	FileSystem::SplitPath FileSystem::tokenisePath(std::string&& path) const {
-		std::stringstream stream(path);
-		std::string token;
-		if (path.back() == '/') {
-			path.pop_back();
+	void FileSystem::notifyWatches(const std::optional<uint64_t> sequence, const WatchEvent::Kind kind, const bool isDirectory, const std::shared_ptr<Directory>& dir,
+		std::string_view name, const std::shared_ptr<Directory>& destDir, std::string_view destName) const {
+		if (!sequence) {
+			return;
+		}
+		// a directory removed meanwhile has no path, so a move out of one shows up as a create and into one as a remove
+		std::string path;
+		std::string destPath;
+		const bool hasPath = pathFromRoot(dir, path);
+		const bool hasDestPath = destDir && pathFromRoot(destDir, destPath);
+		if (hasPath) {
+			path.append(1, '/').append(name);
 		}
-		SplitPath splitPath(std::count(path.cbegin(), path.cend(), '/') + 1, "");
-		size_t index = 0;
-		while (std::getline(stream, token, '/')) {
-			splitPath[index++] = token;
+		if (hasDestPath) {
+			destPath.append(1, '/').append(destName);
+		}
+		if (!destDir) {
+			queueWatchEvent(*sequence, WatchEvent{ kind, isDirectory, hasPath ? std::move(path) : std::string(), std::string() });
+		}
+		else if (hasPath && hasDestPath) {
+			queueWatchEvent(*sequence, WatchEvent{ kind, isDirectory, std::move(path), std::move(destPath) });
+		}
+		else if (hasPath) {
+			queueWatchEvent(*sequence, WatchEvent{ WatchEvent::Kind::Removed, isDirectory, std::move(path), std::string() });
+		}
+		else {
+			queueWatchEvent(*sequence, WatchEvent{ WatchEvent::Kind::Created, isDirectory, hasDestPath ? std::move(destPath) : std::string(), std::string() });
 		}
-		return splitPath;
 	}
 
-	std::shared_ptr<FileSystem::Directory> FileSystem::getDirectory(SplitPath&& splitPath, const bool shouldCreateMissingDirectories) const {
-		if (splitPath.empty()) {
-			return m_pwd;
+	void FileSystem::queueWatchEvent(const uint64_t sequence, WatchEvent&& event) const {
+		// only the push that finds the queue empty wakes the delivery thread, the others join the batch it will take
+		if (m_watchEvents.push(StampedWatchEvent{ sequence, std::move(event) })) {
+			m_watchSignal.fetch_add(1, std::memory_order_release);
+			m_watchSignal.notify_one();
 		}
-		std::shared_ptr<FileSystem::Directory> currentDir = splitPath[0].empty() ? m_root : m_pwd;
-		for (const std::string& token : splitPath) {
-			if (token.empty() || token == ".") {
+	}
+
+	void FileSystem::deliverWatchEvents() {
+		std::vector<std::shared_ptr<const Watch>> watches;
+		std::vector<WatchEvent> watchedEvents;
+		// events queued ahead of one stamped before them, sorted by sequence
+		std::vector<StampedWatchEvent> heldBack;
+		uint64_t nextSequence = 0;
+		while (true) {
+			// read before the queue is emptied, so a push after that changes it and the wait below returns at once
+			const uint64_t signal = m_watchSignal.load(std::memory_order_acquire);
+			std::vector<StampedWatchEvent> queued = m_watchEvents.popAll();
+			if (queued.empty()) {
+				if (m_isWatchStopping.load(std::memory_order_acquire)) {
+					return;
+				}
+				m_watchSignal.wait(signal, std::memory_order_acquire);
 				continue;
 			}
-			else if (token == "..") {
-				if (!currentDir->parent) {
-					throw std::invalid_argument(currentDir->name + " does not have a parent directory");
+			heldBack.insert(heldBack.end(), std::make_move_iterator(queued.begin()), std::make_move_iterator(queued.end()));
+			std::sort(heldBack.begin(), heldBack.end(), [](const StampedWatchEvent& lhs, const StampedWatchEvent& rhs) { return lhs.sequence < rhs.sequence; });
+			// a writer between stamping and queueing its event holds back everything stamped after it
+			size_t numReady = 0;
+			for (; numReady < heldBack.size() && heldBack[numReady].sequence == nextSequence; numReady++) {
+				nextSequence++;
+			}
+			std::vector<WatchEvent> events;
+			events.reserve(numReady);
+			for (size_t i = 0; i < numReady; i++) {
+				if (!heldBack[i].event.path.empty()) {
+					events.push_back(std::move(heldBack[i].event));
 				}
-				currentDir = currentDir->parent;
 			}
-			else {
-				const auto nextDirIt = currentDir->childDirs.find(token);
-				if (nextDirIt != currentDir->childDirs.cend()) {
-					if (!nextDirIt->second->isDirectory()) {
-						throw std::invalid_argument(nextDirIt->first + " is not a directory");
+			heldBack.erase(heldBack.begin(), heldBack.begin() + numReady);
+			if (events.empty()) {
+				continue;
+			}
+			coalesce(events);
+			{
+				std::lock_guard<std::mutex> lock(m_watchesMutex);
+				watches = m_watches;
+			}
+			for (const std::shared_ptr<const Watch>& watch : watches) {
+				watchedEvents.clear();
+				for (const WatchEvent& event : events) {
+					if (isWatched(*watch, event.path) || (!event.destPath.empty() && isWatched(*watch, event.destPath))) {
+						watchedEvents.push_back(event);
 					}
-					currentDir = nextDirIt->second;
 				}
-				else if (shouldCreateMissingDirectories) {
-					currentDir->childDirs.emplace(token, std::make_shared<Directory>(token, currentDir));
-					currentDir = currentDir->childDirs[token];
+				if (!watchedEvents.empty()) {
+					watch->callback(watchedEvents);
 				}
-				else {
-					throw std::invalid_argument(token + " is not recognised");
+			}
+		}
+	}
+
+	void FileSystem::coalesce(std::vector<WatchEvent>& events) {
+		// views of the paths of events, which stay put until the dropped ones are erased at the end
+		std::unordered_map<std::string_view, size_t> createdAt;
+		std::vector<bool> isDropped(events.size(), false);
+		for (size_t i = 0; i < events.size(); i++) {
+			const WatchEvent& event = events[i];
+			if (event.kind == WatchEvent::Kind::Created) {
+				createdAt[event.path] = i;
+				continue;
+			}
+			const auto createdIt = createdAt.find(event.path);
+			if (createdIt == createdAt.end()) {
+				continue;
+			}
+			const size_t created = createdIt->second;
+			createdAt.erase(createdIt);
+			if (event.kind == WatchEvent::Kind::Moved) {
+				continue;
+			}
+			// an entry may have been moved out of a directory that came and went, so then both are kept
+			const std::string below = event.path + '/';
+			const bool hasChangesBelow = event.isDirectory && std::any_of(events.cbegin() + created + 1, events.cbegin() + i, [&below](const WatchEvent& between) {
+				return between.path.starts_with(below) || between.destPath.starts_with(below);
+			});
+			if (!hasChangesBelow) {
+				isDropped[created] = true;
+				isDropped[i] = true;
+			}
+		}
+		size_t numKept = 0;
+		for (size_t i = 0; i < events.size(); i++) {
+			if (!isDropped[i]) {
+				if (numKept != i) {
+					events[numKept] = std::move(events[i]);
 				}
+				numKept++;
 			}
 		}
-		return currentDir;
+		events.resize(numKept);
 	}
 
-	std::shared_ptr<FileSystem::File> FileSystem::makeFile(std::string&& pathToNewDir, const bool isDirectory, const bool shouldCreateMissingDirectories) {
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
-		SplitPath splitPath = tokenisePath(std::move(pathToNewDir));
-		const std::string fileToCreate = splitPath.back();
-		if (fileToCreate.empty()) {
-			throw std::invalid_argument("Create path is invalid");
+	bool FileSystem::isWatched(const Watch& watch, std::string_view path) {
+		if (path.size() <= watch.path.size()) {
+			return path == watch.path;
+		}
+		if (!path.starts_with(watch.path) || path[watch.path.size()] != '/') {
+			return false;
+		}
+		return watch.isRecursive || path.find('/', watch.path.size() + 1) == std::string_view::npos;
+	}
+
+	FileSystem::FileIndexShard& FileSystem::fileIndexShardOf(std::string_view name) const {
+		return m_filesByName[TransparentStringHash()(name) % NUM_SHARDS];
+	}
+
+	std::array<std::unique_lock<std::shared_mutex>, FileSystem::NUM_SHARDS> FileSystem::lockFileIndex() const {
+		std::array<std::unique_lock<std::shared_mutex>, NUM_SHARDS> locks;
+		for (size_t i = 0; i < NUM_SHARDS; i++) {
+			locks[i] = std::unique_lock<std::shared_mutex>(m_filesByName[i].mutex);
 		}
-		splitPath.pop_back();
-		std::shared_ptr<Directory> dirToCreateIn = getDirectory(std::move(splitPath), shouldCreateMissingDirectories);
-		if (dirToCreateIn->childDirs.find(fileToCreate) == dirToCreateIn->childDirs.cend()
-			&& dirToCreateIn->files.find(fileToCreate) == dirToCreateIn->files.cend()) {
-			if (isDirectory) {
-				dirToCreateIn->childDirs.emplace(fileToCreate, make_shared<FileSystem::Directory>(fileToCreate, dirToCreateIn));
-				return dirToCreateIn->childDirs[fileToCreate];
+		return locks;
+	}
+
+	void FileSystem::indexFile(const std::string& name, const std::shared_ptr<File>& file, const std::shared_ptr<Directory>& dir) const {
+		FileIndexShard& shard = fileIndexShardOf(name);
+		std::unique_lock<std::shared_mutex> lock(shard.mutex);
+		shard.files.insert(name, file.get(), dir);
+	}
+
+	void FileSystem::unindexFile(const std::string& name, const File* file) {
+		FileIndexShard& shard = fileIndexShardOf(name);
+		std::unique_lock<std::shared_mutex> lock(shard.mutex);
+		shard.files.erase(name, file);
+	}
+
+	void FileSystem::indexCopy(const std::vector<std::shared_ptr<Directory>>& copiedDirs) const {
+		for (const std::shared_ptr<Directory>& dir : copiedDirs) {
+			std::shared_lock<std::shared_mutex> lock(dir->mutex);
+			// built meanwhile by a query that reached it, which indexed its files
+			if (dir->isLoaded.load(std::memory_order_acquire) || dir->copiedFrom->files.empty()) {
+				continue;
+			}
+			const auto indexLocks = lockFileIndex();
+			for (const Snapshot::File& file : dir->copiedFrom->files) {
+				fileIndexShardOf(file.name).files.insert(file.name, &file, dir);
+			}
+		}
+	}
+
+	void FileSystem::unindexTree(const std::shared_ptr<Directory>& dir) {
+		std::vector<std::pair<std::string, const void*>> keys;
+		// hold the frozen files the keys of copies not built yet point at, which a build meanwhile would release
+		std::vector<std::shared_ptr<const Snapshot::Directory>> copiedFrom;
+		std::vector<uint32_t> builtImageDirs;
+		std::vector<uint32_t> pendingImageDirs;
+		std::vector<std::shared_ptr<Directory>> pendingDirs{ dir };
+		while (!pendingDirs.empty()) {
+			const std::shared_ptr<Directory> currentDir = std::move(pendingDirs.back());
+			pendingDirs.pop_back();
+			// only directories built from an image have a record, the root, the one with record 0, is never removed
+			if (currentDir->imageIndex != 0) {
+				builtImageDirs.push_back(currentDir->imageIndex);
+			}
+			std::shared_lock<std::shared_mutex> lock(currentDir->mutex);
+			if (!currentDir->isLoaded.load(std::memory_order_acquire)) {
+				if (!currentDir->copiedFrom) {
+					pendingImageDirs.push_back(currentDir->imageIndex);
+					continue;
+				}
+				// a copy not built yet is indexed by its frozen files, its child directories are already there
+				for (const Snapshot::File& file : currentDir->copiedFrom->files) {
+					keys.emplace_back(file.name, &file);
+				}
+				copiedFrom.push_back(currentDir->copiedFrom);
 			}
 			else {
-				dirToCreateIn->files.emplace(fileToCreate, make_shared<FileSystem::File>(fileToCreate));
-				return dirToCreateIn->files[fileToCreate];
+				for (const auto& [name, file] : currentDir->files) {
+					keys.emplace_back(std::string(name), file.get());
+				}
 			}
+			for (const auto& [name, childDir] : currentDir->childDirs) {
+				pendingDirs.push_back(childDir);
+			}
+		}
+		if (!builtImageDirs.empty()) {
+			std::lock_guard<std::mutex> imageDirsLock(m_imageDirsMutex);
+			for (const uint32_t index : builtImageDirs) {
+				m_imageDirs.erase(index);
+			}
+		}
+		// below a directory never built the tree is still the image's, whose records were checked when it was indexed
+		if (!m_isImageIndexed.load(std::memory_order_acquire)) {
+			pendingImageDirs.clear();
+		}
+		while (!pendingImageDirs.empty()) {
+			const ImageDir& record = m_image->dirs[pendingImageDirs.back()];
+			pendingImageDirs.pop_back();
+			for (uint32_t i = record.firstChildDir; i < record.firstChildDir + record.numChildDirs; i++) {
+				pendingImageDirs.push_back(i);
+			}
+			for (uint32_t i = record.firstFile; i < record.firstFile + record.numFiles; i++) {
+				const ImageFile& fileRecord = m_image->files[i];
+				keys.emplace_back(std::string(imageName(fileRecord.nameOffset, fileRecord.nameLength)), &fileRecord);
+			}
+		}
+		const auto indexLocks = lockFileIndex();
+		for (const auto& [name, key] : keys) {
+			fileIndexShardOf(name).files.erase(name, key);
 		}
-		throw std::invalid_argument(fileToCreate + " already exists");
 	}
 
-	std::shared_ptr<FileSystem::Directory> FileSystem::changeDirectory(std::string&& path) {
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
-		return m_pwd = getDirectory(tokenisePath(std::move(path)), false);
+	std::shared_ptr<FileSystem::File> FileSystem::copyFile(std::string&& sourcePath, std::string&& destPath) {
+		return copyFile(pwd(), sourcePath, destPath, false);
 	}
 
-	std::shared_ptr<FileSystem::File> FileSystem::removeFile(std::string&& pathToRemove) {
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
-		SplitPath splitPath = tokenisePath(std::move(pathToRemove));
-		const std::string fileToRemove = splitPath.back();
-		if (fileToRemove.empty()) {
-			throw std::invalid_argument("Remove path is invalid");
+	std::shared_ptr<FileSystem::File> FileSystem::moveFile(std::string&& sourcePath, std::string&& destPath) {
+		return copyFile(pwd(), sourcePath, destPath, true);
+	}
+
+	WorkStealingPool& FileSystem::traversalPool() const {
+		std::call_once(m_traversalPoolFlag, [this]() {
+			// the thread that starts a traversal works on it too
+			const size_t numThreads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+			m_traversalPool = std::make_unique<WorkStealingPool>(numThreads);
+		});
+		return *m_traversalPool;
+	}
+
+	void FileSystem::printTreeRecursive(WorkStealingPool& pool, const std::shared_ptr<Directory>& dir, const size_t numIndents, std::string& output) const {
+		std::vector<std::shared_ptr<Directory>> childDirs;
+		materialize(dir);
+		{
+			std::shared_lock<std::shared_mutex> lock(dir->mutex);
+			output += '\n';
+			output.append(numIndents, '\t');
+			output += dir->name;
+			for (const auto& [name, filePtr] : dir->files) {
+				output += '\n';
+				output.append(numIndents + 1, '\t');
+				output += name;
+			}
+			childDirs.reserve(dir->childDirs.size());
+			for (const auto& [name, dirPtr] : dir->childDirs) {
+				childDirs.push_back(dirPtr);
+			}
 		}
-		splitPath.pop_back();
-		std::shared_ptr<Directory> dirToRemoveFrom = getDirectory(std::move(splitPath), false);
-		const auto& removeDirIt = dirToRemoveFrom->childDirs.find(fileToRemove);
-		if (removeDirIt != dirToRemoveFrom->childDirs.cend()) {
-			const std::shared_ptr<Directory> removedDir = removeDirIt->second;
-			dirToRemoveFrom->childDirs.erase(removeDirIt);
-			return removedDir;
+		// children are rendered straight into output until one is handed to the pool,
+		// from then on each renders into its own string so they can be joined in order
+		std::vector<std::string> deferredOutputs;
+		size_t firstDeferred = childDirs.size();
+		WorkStealingPool::TaskGroup group(pool);
+		for (size_t i = 0; i < childDirs.size(); i++) {
+			const bool shouldSpawn = i + 1 < childDirs.size() && pool.isHungry();
+			if (firstDeferred == childDirs.size() && !shouldSpawn) {
+				printTreeRecursive(pool, childDirs[i], numIndents + 1, output);
+				continue;
+			}
+			if (firstDeferred == childDirs.size()) {
+				firstDeferred = i;
+				deferredOutputs.resize(childDirs.size() - i);
+			}
+			std::string& childOutput = deferredOutputs[i - firstDeferred];
+			if (shouldSpawn) {
+				group.spawn([this, &pool, &childDir = childDirs[i], numIndents, &childOutput]() {
+					printTreeRecursive(pool, childDir, numIndents + 1, childOutput);
+				});
+			}
+			else {
+				printTreeRecursive(pool, childDirs[i], numIndents + 1, childOutput);
+			}
 		}
-		const auto& removeFileIt = dirToRemoveFrom->files.find(fileToRemove);
-		if (removeFileIt != dirToRemoveFrom->files.cend()) {
-			const std::shared_ptr<File> removedFile = removeFileIt->second;
-			dirToRemoveFrom->files.erase(removeFileIt);
-			return removedFile;
+		group.wait();
+		for (const std::string& childOutput : deferredOutputs) {
+			output += childOutput;
 		}
-		throw std::invalid_argument(fileToRemove + " does not exist");
 	}
 
-	std::shared_ptr<FileSystem::File> FileSystem::copyFile(std::string&& sourcePath, std::string&& destPath, const bool shouldRemoveOriginal) {
-		SplitPath splitPath = tokenisePath(std::move(destPath));
-		const std::string destFile = splitPath.back();
-		if (destFile.empty()) {
-			throw std::invalid_argument("Move destination path is invalid");
+	std::string FileSystem::printTree(std::string&& path) const {
+		return printTree(pwd(), path);
+	}
+
+	std::string FileSystem::printTree(const std::shared_ptr<Directory>& workingDir, std::string_view path) const {
+		const std::shared_ptr<Directory> currentDir = getDirectory(workingDir, path, false);
+		std::string output;
+		printTreeRecursive(traversalPool(), currentDir, 0, output);
+		// the first line carries no leading newline
+		return output.substr(1);
+	}
+
+	void FileSystem::printTree(std::string&& path, std::ostream& out, const PrintOptions& options) const {
+		printTree(pwd(), path, out, options);
+	}
+
+	void FileSystem::printTree(const std::shared_ptr<Directory>& workingDir, std::string_view path, std::ostream& out, const PrintOptions& options) const {
+		// the child directories of every directory on the path from the printed one down to the current one,
+		// next is the first not yet printed
+		struct Level {
+			std::vector<std::shared_ptr<Directory>> childDirs;
+			size_t next;
+		};
+		std::vector<Level> levels;
+		// one tab per level, shared by every line instead of built per line
+		std::string indents;
+		std::string dirName;
+		std::vector<std::string> fileNames;
+		std::vector<std::pair<std::string_view, std::shared_ptr<Directory>>> sortedChildDirs;
+		std::shared_ptr<Directory> dir = getDirectory(workingDir, path, false);
+		bool isFirstLine = true;
+		while (out) {
+			Level level{ {}, 0 };
+			materialize(dir);
+			{
+				std::shared_lock<std::shared_mutex> lock(dir->mutex);
+				dirName = dir->name;
+				if (levels.size() < options.maxDepth) {
+					for (const auto& [name, filePtr] : dir->files) {
+						fileNames.emplace_back(name);
+					}
+					level.childDirs.reserve(dir->childDirs.size());
+					if (options.isSorted) {
+						// sorted by the map keys, the names themselves are guarded by the children's locks
+						sortedChildDirs.assign(dir->childDirs.cbegin(), dir->childDirs.cend());
+						std::sort(sortedChildDirs.begin(), sortedChildDirs.end(),
+							[](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+						for (auto& [name, dirPtr] : sortedChildDirs) {
+							level.childDirs.push_back(std::move(dirPtr));
+						}
+						sortedChildDirs.clear();
+					}
+					else {
+						for (const auto& [name, dirPtr] : dir->childDirs) {
+							level.childDirs.push_back(dirPtr);
+						}
+					}
+				}
+			}
+			// written after the lock is released, so a slow stream does not hold up writers
+			if (!isFirstLine) {
+				out << '\n';
+			}
+			isFirstLine = false;
+			out << indents << dirName;
+			indents.push_back('\t');
+			if (options.isSorted) {
+				std::sort(fileNames.begin(), fileNames.end());
+			}
+			for (const std::string& fileName : fileNames) {
+				out << '\n' << indents << fileName;
+			}
+			fileNames.clear();
+			levels.push_back(std::move(level));
+			// climbs back up past every finished directory, then descends into the next unprinted one
+			while (!levels.empty() && levels.back().next == levels.back().childDirs.size()) {
+				levels.pop_back();
+				indents.pop_back();
+			}
+			if (levels.empty()) {
+				return;
+			}
+			dir = levels.back().childDirs[levels.back().next++];
+		}
+	}
+
+	std::shared_ptr<FileSystem::File> FileSystem::getFile(const std::shared_ptr<Directory>& workingDir, std::string_view path) const {
+		const auto [parentPath, fileName] = splitLast(path);
+		const std::shared_ptr<Directory> dir = getDirectory(workingDir, parentPath, false);
+		std::shared_lock<std::shared_mutex> lock(dir->mutex);
+		const auto fileIt = dir->files.find(fileName);
+		if (fileIt != dir->files.cend()) {
+			return fileIt->second;
+		}
+		if (dir->childDirs.find(fileName) != dir->childDirs.cend()) {
+			throw std::invalid_argument(std::string(fileName) + " is a directory");
+		}
+		throw std::invalid_argument(std::string(fileName) + " does not exist");
+	}
+
+	std::shared_ptr<FileSystem::Block> FileSystem::makeBlock(const bool isZeroed) const {
+		if (isZeroed) {
+			return std::allocate_shared<Block>(SlabAllocator<Block>(m_blockArena));
+		}
+		return std::allocate_shared_for_overwrite<Block>(SlabAllocator<Block>(m_blockArena));
+	}
+
+	void FileSystem::ensureOwned(std::shared_ptr<Block>& block) const {
+		// only ever shared between block maps and views, and a map shared between files and snapshots
+		// is copied by ownedBlocks before a block in it is written, so a count of one stays one
+		if (block.use_count() > 1) {
+			const std::shared_ptr<Block> copy = makeBlock(false);
+			std::memcpy(copy->bytes, block->bytes, BLOCK_SIZE);
+			block = copy;
+		}
+	}
+
+	void FileSystem::copyContents(const File& source, File& dest) {
+		const FileData* sourceData = source.findData();
+		if (!sourceData) {
+			return;
+		}
+		std::shared_lock<std::shared_mutex> lock(sourceData->mutex);
+		FileData& destData = dest.ensureData();
+		destData.size = sourceData->size;
+		destData.blocks = sourceData->blocks;
+	}
+
+	FileSystem::BlockMap& FileSystem::ownedBlocks(FileData& data) {
+		// the count only grows under a lock of data's mutex, so one that was seen as one stays one
+		if (!data.blocks) {
+			data.blocks = std::make_shared<BlockMap>();
 		}
-		splitPath.pop_back();
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
-		std::shared_ptr<Directory> moveDestDir = getDirectory(std::move(splitPath), false);
-		if (moveDestDir->childDirs.find(destFile) == moveDestDir->childDirs.cend()
-			&& moveDestDir->files.find(destFile) == moveDestDir->files.cend()) {
-			const std::shared_ptr<File> copiedFile =
-				shouldRemoveOriginal ? removeFile(std::move(sourcePath)) : getDirectory(tokenisePath(std::move(sourcePath)), false);
-			copiedFile->name = destFile;
-			if (copiedFile->isDirectory()) {
-				moveDestDir->childDirs.emplace(destFile, dynamic_pointer_cast<Directory>(copiedFile));
+		else if (data.blocks.use_count() > 1) {
+			data.blocks = std::make_shared<BlockMap>(*data.blocks);
+		}
+		return *data.blocks;
+	}
+
+	size_t FileSystem::readBlocks(const BlockMap* blocks, const uint64_t size, const uint64_t offset, std::span<std::byte> buffer) {
+		if (offset >= size) {
+			return 0;
+		}
+		const size_t toRead = static_cast<size_t>(std::min<uint64_t>(buffer.size(), size - offset));
+		if (!blocks) {
+			std::memset(buffer.data(), 0, toRead);
+			return toRead;
+		}
+		uint64_t position = offset;
+		// the blocks are visited in order, so one lookup serves the whole range
+		auto blockIt = blocks->lower_bound(position / BLOCK_SIZE);
+		for (size_t done = 0; done < toRead;) {
+			const uint64_t index = position / BLOCK_SIZE;
+			const size_t inBlock = position % BLOCK_SIZE;
+			const size_t length = std::min(BLOCK_SIZE - inBlock, toRead - done);
+			if (blockIt != blocks->cend() && blockIt->first == index) {
+				std::memcpy(buffer.data() + done, blockIt->second->bytes + inBlock, length);
+				++blockIt;
 			}
 			else {
-				moveDestDir->files.emplace(destFile, copiedFile);
+				std::memset(buffer.data() + done, 0, length);
 			}
-			return copiedFile;
+			done += length;
+			position += length;
 		}
-		else {
-			throw std::invalid_argument(destFile + " already exists");
+		return toRead;
+	}
+
+	size_t FileSystem::write(std::string&& path, const uint64_t offset, std::span<const std::byte> data) {
+		return write(pwd(), path, offset, data);
+	}
+
+	size_t FileSystem::write(const std::shared_ptr<Directory>& workingDir, std::string_view path, const uint64_t offset, std::span<const std::byte> data) {
+		// held shared, so a snapshot refreezing what changed does not miss this write
+		std::shared_lock<std::shared_mutex> snapshotLock(m_snapshotMutex);
+		const std::shared_ptr<File> file = getFile(workingDir, path);
+		std::shared_lock<std::shared_mutex> totalsLock(m_totalsMutex);
+		FileData& fileData = file->ensureData();
+		std::unique_lock<std::shared_mutex> lock(fileData.mutex);
+		BlockMap& blocks = ownedBlocks(fileData);
+		uint64_t position = offset;
+		for (size_t written = 0; written < data.size();) {
+			const uint64_t index = position / BLOCK_SIZE;
+			const size_t inBlock = position % BLOCK_SIZE;
+			const size_t length = std::min(BLOCK_SIZE - inBlock, data.size() - written);
+			std::shared_ptr<Block>& block = blocks[index];
+			if (!block) {
+				// a hole reads as zeros, so only a block that is overwritten whole can skip zeroing
+				block = makeBlock(length < BLOCK_SIZE);
+			}
+			else {
+				ensureOwned(block);
+			}
+			std::memcpy(block->bytes + inBlock, data.data() + written, length);
+			written += length;
+			position += length;
+		}
+		const std::shared_ptr<Directory> parent = file->parent.lock();
+		if (offset + data.size() > fileData.size) {
+			addToTotals(parent, TotalsDelta{ static_cast<int64_t>(offset + data.size() - fileData.size), 0, 0 });
+			fileData.size = offset + data.size();
 		}
+		// still under the data lock, so a snapshot that copied the old data has marked the directory frozen by now
+		if (parent) {
+			markChanged(parent);
+		}
+		return data.size();
 	}
 
-	std::shared_ptr<FileSystem::File> FileSystem::copyFile(std::string&& sourcePath, std::string&& destPath) {
-		return copyFile(std::move(sourcePath), std::move(destPath), false);
+	size_t FileSystem::read(std::string&& path, const uint64_t offset, std::span<std::byte> buffer) const {
+		return read(pwd(), path, offset, buffer);
 	}
 
-	std::shared_ptr<FileSystem::File> FileSystem::moveFile(std::string&& sourcePath, std::string&& destPath) {
-		return copyFile(std::move(sourcePath), std::move(destPath), true);
+	size_t FileSystem::read(const std::shared_ptr<Directory>& workingDir, std::string_view path, const uint64_t offset, std::span<std::byte> buffer) const {
+		const std::shared_ptr<File> file = getFile(workingDir, path);
+		const FileData* data = file->findData();
+		if (!data) {
+			return 0;
+		}
+		std::shared_lock<std::shared_mutex> lock(data->mutex);
+		return readBlocks(data->blocks.get(), data->size, offset, buffer);
+	}
+
+	FileSystem::FileView FileSystem::readView(std::string&& path, const uint64_t offset, const uint64_t length) const {
+		return readView(pwd(), path, offset, length);
+	}
+
+	FileSystem::FileView FileSystem::readView(const std::shared_ptr<Directory>& workingDir, std::string_view path, const uint64_t offset, const uint64_t length) const {
+		static const std::shared_ptr<const Block> zeroBlock = std::make_shared<const Block>();
+		const std::shared_ptr<File> file = getFile(workingDir, path);
+		FileView view;
+		const FileData* data = file->findData();
+		if (!data) {
+			return view;
+		}
+		std::shared_lock<std::shared_mutex> lock(data->mutex);
+		if (offset >= data->size) {
+			return view;
+		}
+		view.m_size = std::min(length, data->size - offset);
+		// an empty map stands in for a file without blocks, so the loop below reads it as one hole
+		static const BlockMap noBlocks;
+		const BlockMap& blocks = data->blocks ? *data->blocks : noBlocks;
+		uint64_t position = offset;
+		auto blockIt = blocks.lower_bound(position / BLOCK_SIZE);
+		for (uint64_t done = 0; done < view.m_size;) {
+			const uint64_t index = position / BLOCK_SIZE;
+			const size_t inBlock = position % BLOCK_SIZE;
+			const size_t spanLength = static_cast<size_t>(std::min<uint64_t>(BLOCK_SIZE - inBlock, view.m_size - done));
+			std::shared_ptr<const Block> block = zeroBlock;
+			if (blockIt != blocks.cend() && blockIt->first == index) {
+				block = blockIt->second;
+				++blockIt;
+			}
+			view.m_spans.emplace_back(block->bytes + inBlock, spanLength);
+			view.m_blocks.push_back(std::move(block));
+			done += spanLength;
+			position += spanLength;
+		}
+		return view;
 	}
 
-	std::string FileSystem::printTreeRecursive(const std::shared_ptr<Directory>& dir, const size_t numIndents) const {
-		std::string output = std::string(numIndents, '\t') + dir->name;
-		for (const auto& [name, filePtr] : dir->files) {
-			output += "\n" + std::string(numIndents + 1, '\t') + name;
+	void FileSystem::truncate(std::string&& path, const uint64_t size) {
+		truncate(pwd(), path, size);
+	}
+
+	void FileSystem::truncate(const std::shared_ptr<Directory>& workingDir, std::string_view path, const uint64_t size) {
+		std::shared_lock<std::shared_mutex> snapshotLock(m_snapshotMutex);
+		const std::shared_ptr<File> file = getFile(workingDir, path);
+		std::shared_lock<std::shared_mutex> totalsLock(m_totalsMutex);
+		FileData& data = file->ensureData();
+		std::unique_lock<std::shared_mutex> lock(data.mutex);
+		if (size < data.size && data.blocks) {
+			BlockMap& blocks = ownedBlocks(data);
+			const uint64_t numKeptBlocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+			blocks.erase(blocks.lower_bound(numKeptBlocks), blocks.end());
+			// keeps the bytes past the end zero, so growing the file again reads zeros there
+			const size_t inLastBlock = size % BLOCK_SIZE;
+			const auto lastBlockIt = blocks.find(size / BLOCK_SIZE);
+			if (inLastBlock != 0 && lastBlockIt != blocks.end()) {
+				ensureOwned(lastBlockIt->second);
+				std::memset(lastBlockIt->second->bytes + inLastBlock, 0, BLOCK_SIZE - inLastBlock);
+			}
 		}
-		for (const auto& [name, dirPtr] : dir->childDirs) {
-			output += "\n" + printTreeRecursive(dirPtr, numIndents + 1);
+		const std::shared_ptr<Directory> parent = file->parent.lock();
+		addToTotals(parent, TotalsDelta{ static_cast<int64_t>(size) - static_cast<int64_t>(data.size), 0, 0 });
+		data.size = size;
+		if (parent) {
+			markChanged(parent);
 		}
-		return output;
 	}
 
-	std::string FileSystem::printTree(std::string&& path) const {
-		const std::shared_ptr<Directory> currentDir = getDirectory(tokenisePath(std::move(path)), false);
-		if (currentDir->childDirs.size() < PARALLELISATION_THRESHOLD) {
-			return printTreeRecursive(currentDir, 0);
-		}
-		return std::transform_reduce(currentDir->childDirs.cbegin(), currentDir->childDirs.cend(), currentDir->name,
-			[](const auto& accumulator, const auto& str) {
-				return accumulator + '\n' + str;
-			},
-			[this](const auto& childDir) {
-				return std::async(std::launch::async, &FileSystem::printTreeRecursive, this, std::ref(childDir.second), 1).get();
-			});
+	uint64_t FileSystem::fileSize(std::string&& path) const {
+		return fileSize(pwd(), path);
+	}
+
+	uint64_t FileSystem::fileSize(const std::shared_ptr<Directory>& workingDir, std::string_view path) const {
+		return static_cast<uint64_t>(totalsOf(getFile(workingDir, path)).bytes);
+	}
+
+	FileSystem::Stat FileSystem::stat(std::string&& path) const {
+		return stat(pwd(), path);
+	}
+
+	FileSystem::Stat FileSystem::stat(const std::shared_ptr<Directory>& workingDir, std::string_view path) const {
+		const auto [parentPath, fileName] = splitLast(path);
+		std::shared_ptr<Directory> dir;
+		if (fileName.empty() || fileName == "." || fileName == "..") {
+			dir = getDirectory(workingDir, path, false);
+		}
+		else {
+			const std::shared_ptr<Directory> parentDir = getDirectory(workingDir, parentPath, false);
+			std::shared_lock<std::shared_mutex> lock(parentDir->mutex);
+			const auto dirIt = parentDir->childDirs.find(fileName);
+			if (dirIt != parentDir->childDirs.cend()) {
+				dir = dirIt->second;
+			}
+			else {
+				const auto fileIt = parentDir->files.find(fileName);
+				if (fileIt == parentDir->files.cend()) {
+					throw std::invalid_argument(std::string(fileName) + " does not exist");
+				}
+				const std::shared_ptr<File> file = fileIt->second;
+				lock.unlock();
+				return Stat{ false, static_cast<uint64_t>(totalsOf(file).bytes), 0, 0 };
+			}
+		}
+		return Stat{ true, dir->bytesBelow.load(std::memory_order_relaxed), dir->numFilesBelow.load(std::memory_order_relaxed), dir->numDirsBelow.load(std::memory_order_relaxed) };
 	}
 
 	std::string FileSystem::getCurrentPath() const {
-		auto curDir = m_pwd;
+		return pathOf(pwd());
+	}
+
+	std::string FileSystem::pathOf(std::shared_ptr<Directory> curDir) {
 		std::string path;
-		while (curDir->parent) {
-			path = '/' + curDir->name + path;
-			curDir = curDir->parent;
+		while (true) {
+			std::shared_ptr<Directory> parent;
+			std::string name;
+			{
+				std::shared_lock<std::shared_mutex> lock(curDir->mutex);
+				parent = curDir->parent.lock();
+				name = curDir->name;
+			}
+			if (!parent) {
+				return path;
+			}
+			path = '/' + name + path;
+			curDir = std::move(parent);
 		}
-		return path;
 	}
 
-	std::vector<std::string> FileSystem::findFileRecursive(const std::shared_ptr<Directory>& dir, std::string currentPath, const std::string& fileName) const {
-		std::vector<std::string> filePaths;
-		for (const auto& [dirName, childDir] : dir->childDirs) {
-			const auto childPaths = findFileRecursive(childDir, currentPath + '/' + dirName, fileName);
-			if (childPaths.empty()) {
+	bool FileSystem::pathFromRoot(std::shared_ptr<Directory> dir, std::string& path) const {
+		path.clear();
+		while (true) {
+			std::shared_ptr<Directory> parent;
+			{
+				std::shared_lock<std::shared_mutex> lock(dir->mutex);
+				parent = dir->parent.lock();
+				if (!parent) {
+					return dir == m_root;
+				}
+				path.insert(0, dir->name).insert(0, 1, '/');
+			}
+			dir = std::move(parent);
+		}
+	}
+
+	template <class Query>
+	std::vector<std::string> FileSystem::findIndexed(Query&& query, const std::optional<std::string_view> name) const {
+		indexImage();
+		struct Hit {
+			std::string name;
+			// only compared, never dereferenced, the file may be removed once the index lock is released
+			const void* key;
+			// null for a file of the image whose directory was not built when the index was read
+			std::shared_ptr<Directory> dir;
+			// false for a file of a directory not built when the index was read, keyed by its record rather than itself
+			bool isBuilt;
+		};
+		std::vector<Hit> hits;
+		const auto visitor = [this, &hits](const std::string& name, const void* key, const std::weak_ptr<Directory>& dir) {
+			if (std::shared_ptr<Directory> heldDir = dir.lock()) {
+				// building a directory swaps its entries under the index locks, so the flag matches the key
+				const bool isBuilt = heldDir->isLoaded.load(std::memory_order_acquire);
+				hits.push_back(Hit{ name, key, std::move(heldDir), isBuilt });
+			} else if (imageFileOf(key)) {
+				hits.push_back(Hit{ name, key, nullptr, false });
+			}
+		};
+		const FileIndexShard* nameShard = name ? &fileIndexShardOf(*name) : nullptr;
+		for (const FileIndexShard& shard : m_filesByName) {
+			if (nameShard && &shard != nameShard) {
 				continue;
 			}
-			filePaths.reserve(filePaths.size() + childPaths.size());
-			filePaths.insert(filePaths.end(), childPaths.begin(), childPaths.end());
+			std::shared_lock<std::shared_mutex> lock(shard.mutex);
+			query(shard, visitor);
 		}
-		if (dir->files.find(fileName) != dir->files.cend()) {
-			filePaths.push_back(currentPath + '/' + fileName);
+		// the index lock is released before any directory is locked, writers take them the other way round
+		std::vector<std::string> filePaths;
+		filePaths.reserve(hits.size());
+		std::string dirPath;
+		for (Hit& hit : hits) {
+			const ImageFile* imageFile = hit.dir ? nullptr : imageFileOf(hit.key);
+			if (imageFile) {
+				// the directory was not built when the index was read, so whichever file it holds under the name now
+				// is the one built from the record or one that replaced it, neither of which had an entry of its own then
+				hit.dir = builtImageDir(m_imageFileDirs[imageFile - m_image->files]);
+				if (!hit.dir) {
+					continue;
+				}
+				materialize(hit.dir);
+			}
+			else if (!hit.isBuilt) {
+				// a copy not built yet, whichever file it holds under the name now is the one built from the frozen file
+				materialize(hit.dir);
+			}
+			{
+				std::shared_lock<std::shared_mutex> lock(hit.dir->mutex);
+				const auto fileIt = hit.dir->files.find(hit.name);
+				if (fileIt == hit.dir->files.cend() || (hit.isBuilt && fileIt->second.get() != hit.key)) {
+					continue;
+				}
+			}
+			if (pathFromRoot(hit.dir, dirPath)) {
+				filePaths.push_back(dirPath + '/' + hit.name);
+			}
 		}
 		return filePaths;
 	}
 
 	std::vector<std::string> FileSystem::findFile(std::string&& fileName) const {
-		auto currentDir = m_root;
-		if (currentDir->childDirs.size() < PARALLELISATION_THRESHOLD) {
-			return findFileRecursive(currentDir, "", fileName);
-		}
-		std::vector<std::string> filePaths;
-		return std::transform_reduce(currentDir->childDirs.cbegin(), currentDir->childDirs.cend(), filePaths,
-			[](const auto& accumulator, const auto& curVector) {
-				if (curVector.empty()) {
-					return accumulator;
-				}
-				std::vector<std::string> combined(accumulator.size() + curVector.size());
-				const auto prevEnd = std::copy(accumulator.cbegin(), accumulator.cend(), combined.begin());
-				std::copy(curVector.cbegin(), curVector.cend(), prevEnd);
-				return combined;
-			},
-			[this, &fileName](const auto& childDir) {
-				return std::async(std::launch::async, &FileSystem::findFileRecursive, this, std::ref(childDir.second), "", std::cref(fileName)).get();
-			});
+		return findIndexed([&fileName](const FileIndexShard& shard, const auto& visitor) { shard.files.forEachNamed(fileName, visitor); }, fileName);
+	}
+
+	std::vector<std::string> FileSystem::findFileContaining(std::string&& fragment) const {
+		return findIndexed([&fragment](const FileIndexShard& shard, const auto& visitor) { shard.files.forEachContaining(fragment, visitor); }, std::nullopt);
+	}
+
+	std::vector<std::string> FileSystem::findFileMatching(std::string&& pattern) const {
+		return findIndexed([&pattern](const FileIndexShard& shard, const auto& visitor) { shard.files.forEachMatching(pattern, visitor); }, std::nullopt);
 	}
-}
\ No newline at end of file
+}
@@ -1,48 +1,647 @@
 #pragma once
 
+#include "linked_unordered_map.h"
+#include "mapped_file.h"
+#include "mpsc_queue.h"
+#include "name_index.h"
+#include "slab_arena.h"
+#include "string_pool.h"
+#include "work_stealing_pool.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <ostream>
+#include <shared_mutex>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace implementations {
+	/*
+	* in memory tree of directories and files addressed by unix style paths
+	* resolved directories are remembered in a bounded dentry cache keyed by the path and the directory it is relative to,
+	* so repeated lookups of the same path skip the component by component walk,
+	* removing or moving a directory invalidates every cached path; the cache is split into shards by hash and a hit
+	* only takes its shard's read lock, eviction approximates least recently used with a reference bit (CLOCK)
+	* every directory has its own reader-writer lock: lookups take them hand over hand from parent to child, so writers
+	* in unrelated subtrees run concurrently and readers see each directory in a consistent state;
+	* a move locks its source and destination directories ancestor first, then by address, the order lookups take them in,
+	* an operation that resolved a directory just before another thread removed it applies to the removed subtree
+	* printTree runs on a work stealing pool and splits subtrees off at any depth whenever a worker is idle,
+	* the streaming printTree writes depth first into an ostream instead, holding one directory's entries per level
+	* findFile answers from an inverted index of file names with trigrams for substring and glob queries,
+	* so it costs the number of matches and their depth instead of a walk of the whole tree
+	* copyFile shares the source as a snapshot of it would: the copied directories are only built from their frozen
+	* source when first looked into, and their files share blocks with the source until either side writes them,
+	* every file and directory has exactly one parent
+	* files and directories are allocated from a slab arena, own their children and only point back at their parent
+	* regular files hold data in fixed size blocks from a slab arena shared by the tree, blocks never written are holes
+	* that read as zeros, copies and views share blocks and a write copies a shared block before changing it
+	* every directory keeps the bytes, files and directories below it, each change is added up its parent chain,
+	* so stat answers du style questions without walking the subtree
+	* save writes the tree to a compact image file and the image constructor maps one back in,
+	* a directory loaded from an image is only built from it when first looked into, so opening a large image is instant,
+	* the first findFile indexes the file table of the image as it is and only builds the directories holding its hits
+	* snapshot returns an immutable point in time copy of the tree that readers walk without locks while writers go on,
+	* consecutive snapshots share every directory that did not change in between, and the files of every directory whose
+	* own entries did not change, so a snapshot only copies what changed since the last one; it does so while writers go on,
+	* the first snapshot walks the whole tree, and writers pause only while what they changed meanwhile is copied again
+	* watch delivers the creates, removes and moves below a path in batches on a background thread, writers hand their
+	* events over through a lock free queue and never wait for a callback; each event is stamped while its directory is
+	* still locked and delivered in stamp order, so the events of a path arrive in the order its changes were made
+	*/
 	class FileSystem
 	{
+		struct Block;
+		// the data blocks of a regular file by block index, a missing block is a hole
+		using BlockMap = std::map<uint64_t, std::shared_ptr<Block>>;
+	public:
+		struct PrintOptions {
+			// levels below the printed directory, 0 prints its name only
+			size_t maxDepth;
+			// files and directories by name instead of hash order
+			bool isSorted;
+
+			// every level in hash order
+			PrintOptions();
+		};
+
+		/*
+		* a read only view of a range of a file's data without copying it, holes show up as spans of zeros
+		* the view shares the blocks it spans, so later writes to the file do not change what it sees
+		*/
+		class FileView {
+			friend class FileSystem;
+
+			// keeps the spanned blocks alive
+			std::vector<std::shared_ptr<const void>> m_blocks;
+			std::vector<std::span<const std::byte>> m_spans;
+			uint64_t m_size;
+
+			FileView();
+		public:
+			// in file order, together they cover the viewed range
+			const std::vector<std::span<const std::byte>>& spans() const noexcept;
+			uint64_t size() const noexcept;
+		};
+
+		struct WatchEvent {
+			enum class Kind {
+				Created,
+				Removed,
+				Moved
+			};
+
+			Kind kind;
+			bool isDirectory;
+			// absolute, the source of a move
+			std::string path;
+			// absolute destination of a move, empty otherwise
+			std::string destPath;
+		};
+
+		// called with the events of one batch that concern the watched path, in the order they happened
+		using WatchCallback = std::function<void(const std::vector<WatchEvent>&)>;
+
+		struct Stat {
+			bool isDirectory;
+			// of a regular file, or of every regular file below a directory
+			uint64_t size;
+			// below a directory, zero for a regular file
+			uint64_t numFiles;
+			uint64_t numDirs;
+		};
+
+		/*
+		* the tree as it was when FileSystem::snapshot was called, immutable and safe to share between threads
+		* directories are shared with other snapshots of the same FileSystem wherever nothing changed in between
+		* paths resolve from the root of the snapshot, relative or not
+		*/
+		class Snapshot {
+		public:
+			// a regular file as it was, its blocks stay shared with the tree until either side writes them
+			struct File {
+				std::string name;
+				uint64_t size;
+				// null for a file without blocks
+				std::shared_ptr<const BlockMap> blocks;
+			};
+
+			/*
+			* the files of a directory sorted by name, shared by the frozen copies of a directory whose own entries
+			* did not change in between, and by copies of the directory
+			*/
+			class Files {
+				std::shared_ptr<const std::vector<File>> m_files;
+			public:
+				using const_iterator = std::vector<File>::const_iterator;
+
+				Files();
+				explicit Files(std::vector<File>&& files);
+
+				size_t size() const noexcept;
+				bool empty() const noexcept;
+				const File& operator[](const size_t index) const;
+				const_iterator begin() const noexcept;
+				const_iterator end() const noexcept;
+				const_iterator cbegin() const noexcept;
+				const_iterator cend() const noexcept;
+			};
+
+			// files and child directories sorted by name
+			struct Directory {
+				std::string name;
+				Files files;
+				std::vector<std::shared_ptr<const Directory>> childDirs;
+				// below the directory, as stat counts them
+				uint64_t bytesBelow;
+				uint64_t numFilesBelow;
+				uint64_t numDirsBelow;
+			};
+		private:
+			friend class FileSystem;
+
+			std::shared_ptr<const Directory> m_root;
+
+			explicit Snapshot(std::shared_ptr<const Directory> root);
+
+			static void printTreeRecursive(const Directory& dir, std::string& indents, std::string& output);
+			static void findFileRecursive(const Directory& dir, std::string& path, std::string_view fileName, std::vector<std::string>& filePaths);
+		public:
+			const std::shared_ptr<const Directory>& getRoot() const noexcept;
+			std::shared_ptr<const Directory> getDirectory(std::string_view path) const;
+			// same layout as FileSystem::printTree, sorted by name
+			std::string printTree(std::string_view path) const;
+			std::vector<std::string> findFile(std::string_view fileName) const;
+			// the regular file at path, resolved like getDirectory
+			const File& getFile(std::string_view path) const;
+			// same as FileSystem::read, of the data the file held when the snapshot was taken
+			size_t read(std::string_view path, const uint64_t offset, std::span<std::byte> buffer) const;
+		};
+
+	private:
+		static constexpr size_t BLOCK_SIZE = 4096;
+		// the dentry cache and the name index are split by hash, each shard with its own lock
+		static constexpr size_t NUM_SHARDS = 16;
+
+		struct Block {
+			std::byte bytes[BLOCK_SIZE];
+		};
+
+		struct Directory;
+
+		// the contents of a regular file, kept out of line so an empty file or a directory only carries a null pointer
+		struct FileData {
+			// guards size and blocks
+			mutable std::shared_mutex mutex;
+			uint64_t size;
+			// null while there are no blocks, the bytes of the last block past size are zero,
+			// shared with copies and snapshots of the file, so a write copies the map first if it is shared
+			std::shared_ptr<BlockMap> blocks;
+
+			FileData();
+		};
+
 		struct File {
-			std::string name;
+			// interned in m_names, a tree repeats most of its names
+			InternedString name;
+			// non-owning, so a removed subtree is freed once nothing outside the tree holds it,
+			// only changed while m_totalsMutex is held exclusively, and for a directory also its own mutex
+			std::weak_ptr<Directory> parent;
+			// owned, allocated by the first change of size or blocks and never replaced, null for a directory
+			std::atomic<FileData*> data;
 
-			File(const std::string& name);
+			File(InternedString name, const std::shared_ptr<Directory>& parent);
+			virtual ~File();
 
 			virtual bool isDirectory();
+			// null while the file is empty and was never written
+			FileData* findData() const noexcept;
+			FileData& ensureData();
 		};
 
 		struct Directory : public File {
-			std::shared_ptr<Directory> parent;
-			std::unordered_map<std::string, std::shared_ptr<File>> files;
-			std::unordered_map<std::string, std::shared_ptr<Directory>> childDirs;
+			// guards files, childDirs, parent and the name of this directory, and the names of the files in it
+			mutable std::shared_mutex mutex;
+			// keyed by views of the children's own names, so every name is stored once,
+			// a child is erased before it is renamed and re-inserted under the new name
+			std::unordered_map<std::string_view, std::shared_ptr<File>, TransparentStringHash, std::equal_to<>> files;
+			std::unordered_map<std::string_view, std::shared_ptr<Directory>, TransparentStringHash, std::equal_to<>> childDirs;
+			// this directory as of the last snapshot that included it, null if none did, only used under m_freezeMutex
+			std::shared_ptr<const Snapshot::Directory> frozen;
+			// set by freeze before it copies the entries and file data of this directory, cleared once it or a directory
+			// below changed, so frozen is only reused as it is while it is set;
+			// a writer that finds it set after its change queues the directory in markChanged
+			std::atomic<bool> isFrozen;
+			// set by every change to the entries or file data of this directory, cleared by freeze, which reuses the files
+			// of frozen while it is clear; while the directory is frozen only the change that sets it queues the directory
+			std::atomic<bool> isChanged;
+			// false until the entries of a directory from an image or a copy are built, imageIndex is its record in the image
+			std::atomic<bool> isLoaded;
+			uint32_t imageIndex;
+			// the frozen directory a copy is built from, null for any other directory and once the copy is built
+			std::shared_ptr<const Snapshot::Directory> copiedFrom;
+			// totals of everything below, each change is added along the parent chain while m_totalsMutex is held shared
+			std::atomic<uint64_t> bytesBelow;
+			std::atomic<uint64_t> numFilesBelow;
+			std::atomic<uint64_t> numDirsBelow;
 
-			Directory(const std::string& name, const std::shared_ptr<Directory>& parent);
+			Directory(InternedString name, const std::shared_ptr<Directory>& parent);
 
 			bool isDirectory() override;
 		};
 
+		/*
+		* image layout, native byte order, every offset counts from the start of the file:
+		* header, directory table, file table, block table, name pool, then the data blocks aligned to BLOCK_SIZE
+		* directories are stored breadth first from the root, so the child directories of one are consecutive records,
+		* as are its files and the blocks of a file, each run sorted by name or block index
+		* a name is stored once however many entries carry it, a block shared by several files is stored once
+		*/
+		struct ImageHeader {
+			uint64_t magic;
+			uint32_t version;
+			uint32_t blockSize;
+			uint64_t numDirs;
+			uint64_t numFiles;
+			uint64_t numBlocks;
+			uint64_t numDataBlocks;
+			uint64_t dirsOffset;
+			uint64_t filesOffset;
+			uint64_t blocksOffset;
+			uint64_t namesOffset;
+			uint64_t namesSize;
+			uint64_t dataOffset;
+		};
+
+		struct ImageDir {
+			uint64_t nameOffset;
+			uint32_t nameLength;
+			uint32_t firstChildDir;
+			uint32_t numChildDirs;
+			uint32_t firstFile;
+			uint32_t numFiles;
+			uint32_t padding;
+			uint64_t bytesBelow;
+			uint64_t numFilesBelow;
+			uint64_t numDirsBelow;
+		};
+
+		struct ImageFile {
+			uint64_t nameOffset;
+			uint64_t size;
+			uint32_t nameLength;
+			uint32_t firstBlock;
+			uint32_t numBlocks;
+			uint32_t padding;
+		};
+
+		struct ImageBlock {
+			// block index within its file
+			uint64_t index;
+			// which data block holds its bytes
+			uint64_t dataBlock;
+		};
+
+		// the tables of a mapped image, checked against the file size when it is opened
+		struct Image {
+			std::shared_ptr<MappedFile> file;
+			const ImageDir* dirs;
+			uint64_t numDirs;
+			const ImageFile* files;
+			uint64_t numFiles;
+			const ImageBlock* blocks;
+			uint64_t numBlocks;
+			std::string_view names;
+			std::byte* data;
+			uint64_t numDataBlocks;
+		};
+
+		// splits a path into its components without allocating, empty and "." components are skipped
+		class PathTokenizer {
+			std::string_view m_path;
+		public:
+			explicit PathTokenizer(std::string_view path);
+
+			// false once every component has been returned
+			bool next(std::string_view& token);
+		};
+
+		// a path is resolved relative to a base directory, the root for absolute paths and the pwd otherwise
+		struct DentryKey {
+			const Directory* base;
+			std::string path;
+		};
+
+		struct DentryKeyView {
+			const Directory* base;
+			std::string_view path;
+		};
+
+		struct DentryKeyHash {
+			using is_transparent = void;
+
+			size_t operator()(const DentryKey& key) const noexcept;
+			size_t operator()(const DentryKeyView& key) const noexcept;
+		};
+
+		struct DentryKeyEqual {
+			using is_transparent = void;
+
+			template <class KeyA, class KeyB>
+			bool operator()(const KeyA& a, const KeyB& b) const noexcept;
+		};
+
+		// a resolved directory is only trusted while no directory has been removed or moved since it was cached
+		struct Dentry {
+			uint64_t generation;
+			std::weak_ptr<Directory> dir;
+			// set by every hit under the shard's read lock, eviction passes over a referenced path once (CLOCK)
+			mutable std::atomic<bool> isReferenced;
+
+			// the map's sentinel is default constructed
+			Dentry();
+			Dentry(const uint64_t generation, std::weak_ptr<Directory> dir);
+		};
+
+		struct DentryShard {
+			// in insertion order, paths given a second chance by eviction go back to the tail
+			LinkedUnorderedMap<DentryKey, Dentry, DentryKeyHash, DentryKeyEqual, SingleThreaded> dentries;
+			// hits only read the shard, so they share it
+			mutable std::shared_mutex mutex;
+		};
+
+		struct FileIndexShard {
+			NameIndex<const void*, std::weak_ptr<Directory>> files;
+			mutable std::shared_mutex mutex;
+		};
+
+		struct Watch {
+			size_t id;
+			// absolute, empty for the root
+			std::string path;
+			bool isRecursive;
+			WatchCallback callback;
+		};
+
+		struct StampedWatchEvent {
+			// taken while the changed directory is write locked, so the events of one directory go out in the order of its changes
+			uint64_t sequence;
+			// with an empty path when the change turned out to be outside the tree, its sequence still has to be passed
+			WatchEvent event;
+		};
+
+		// every file and directory of the tree, shared with the nodes so a node handed out may outlive the FileSystem
+		const std::shared_ptr<SlabArena> m_inodeArena;
+		// the data blocks of every regular file
+		const std::shared_ptr<SlabArena> m_blockArena;
+		// the names of every file and directory
+		mutable StringPool m_names;
 		const std::shared_ptr<Directory> m_root;
 		// present working directory
 		std::shared_ptr<Directory> m_pwd;
-		std::recursive_mutex m_mutex;
+		mutable std::mutex m_pwdMutex;
+		// moves and copies change which directories are ancestors of which, they are serialised so the ancestry they check stays put
+		std::mutex m_renameMutex;
+		// bounded cache of resolved paths (dentry cache), a path not hit since eviction last passed it is evicted
+		mutable std::array<DentryShard, NUM_SHARDS> m_dentryShards;
+		// per shard
+		const size_t m_dentryCapacity;
+		std::atomic<uint64_t> m_dentryGeneration;
+		// set once by the image constructor
+		std::unique_ptr<const Image> m_image;
+		// the files of directories not yet built are indexed straight from the image before the first findFile
+		mutable std::once_flag m_imageIndexedFlag;
+		// set once the image is indexed, so removing a directory not yet built also drops the entries below it
+		mutable std::atomic<bool> m_isImageIndexed;
+		// by image record, filled while the image is indexed and read only afterwards
+		mutable std::vector<uint32_t> m_imageParents;
+		mutable std::vector<uint32_t> m_imageFileDirs;
+		// the directories built from an image by their record, so an index hit on a file of the image finds
+		// the directory above it wherever it was moved, a removed directory is dropped
+		mutable std::unordered_map<uint32_t, std::weak_ptr<Directory>> m_imageDirs;
+		// taken last, after any directory lock or name index lock
+		mutable std::mutex m_imageDirsMutex;
+		// started on the first traversal, so a tree that is never searched costs no threads
+		mutable std::once_flag m_traversalPoolFlag;
+		mutable std::unique_ptr<WorkStealingPool> m_traversalPool;
+		// writers hold it shared for the whole operation, snapshot holds it exclusively while it refreezes what changed
+		// during the freeze it ran alongside the writers
+		mutable std::shared_mutex m_snapshotMutex;
+		// one freeze at a time, by snapshot or copyFile, taken before m_snapshotMutex since freezes run alongside the writers
+		std::mutex m_freezeMutex;
+		// frozen directories changed since, the next freeze refreezes them and everything above them
+		mutable std::vector<std::weak_ptr<Directory>> m_changedDirs;
+		mutable std::mutex m_changedDirsMutex;
+		// every regular file by name, with the directory holding it, so findFile costs the matches rather than the tree
+		// writers update it while the changed directory is still write locked, it is never held while taking a directory lock,
+		// queries check each hit against the tree since a removal can land between the two
+		// keyed by the File, or by the ImageFile record with no directory for a file of a directory not built yet,
+		// building a directory swaps the entries of its records for its files
+		// sharded by name, so creates and removes of different names rarely wait for each other,
+		// bulk changes lock every shard in order
+		mutable std::array<FileIndexShard, NUM_SHARDS> m_filesByName;
+		// held shared while a change is added to the totals up a parent chain or a file's size changes,
+		// exclusively while a node changes parent, so no change is added along a chain its node has left
+		mutable std::shared_mutex m_totalsMutex;
+		// by path, a watch stays on its path when the directory there is moved away
+		std::vector<std::shared_ptr<const Watch>> m_watches;
+		size_t m_nextWatchId;
+		mutable std::mutex m_watchesMutex;
+		// writers only build events while something is watched
+		std::atomic<size_t> m_numWatches;
+		mutable MpscQueue<StampedWatchEvent> m_watchEvents;
+		// the sequence of the next event, queued events can arrive out of it and are held back until the gap fills
+		mutable std::atomic<uint64_t> m_nextWatchSequence;
+		// bumped when the queue turns non empty and on destruction, the delivery thread sleeps on it
+		mutable std::atomic<uint64_t> m_watchSignal;
+		std::atomic<bool> m_isWatchStopping;
+		// started by the first watch, joined by the destructor
+		std::thread m_watchThread;
 
-		using SplitPath = std::vector<std::string>;
+		// a change to the totals of the directories above an entry, negative when the entry shrinks or leaves
+		struct TotalsDelta {
+			int64_t bytes;
+			int64_t numFiles;
+			int64_t numDirs;
 
-		SplitPath tokenisePath(std::string&& path) const;
-		std::shared_ptr<Directory> getDirectory(SplitPath&& splitPath, const bool shouldCreateMissingDirectories) const;
-		std::shared_ptr<File> copyFile(std::string&& sourcePath, std::string&& destPath, const bool shouldRemoveOriginal);
-		std::string printTreeRecursive(const std::shared_ptr<Directory>& dir, const size_t numIndents) const;
-		std::vector<std::string> findFileRecursive(const std::shared_ptr<Directory>& dir, std::string currentPath, const std::string& fileName) const;
+			TotalsDelta operator-() const;
+		};
+		// a directory bulkLoad is inside, with the entries it has gathered for it but not yet added
+		struct BulkLevel {
+			std::shared_ptr<Directory> dir;
+			std::vector<std::shared_ptr<File>> files;
+			std::unordered_map<std::string_view, std::shared_ptr<Directory>> childDirs;
+		};
+
+		// splits off the last component, trailing slashes are ignored
+		static std::pair<std::string_view, std::string_view> splitLast(std::string_view path);
+		// follows parent pointers, only stable while m_renameMutex is held
+		static bool isAncestor(const Directory* ancestor, const Directory* dir);
+		std::shared_ptr<Directory> pwd() const;
+		// relative paths resolve against workingDir, the pwd of whichever session the call came from
+		std::shared_ptr<Directory> getDirectory(const std::shared_ptr<Directory>& workingDir, std::string_view path, const bool shouldCreateMissingDirectories) const;
+		std::shared_ptr<Directory> walkPath(std::shared_ptr<Directory> currentDir, std::string_view path, const bool shouldCreateMissingDirectories) const;
+		void invalidateDentries();
+		static Image openImage(const std::string& imagePath);
+		std::string_view imageName(const uint64_t offset, const uint32_t length) const;
+		// the record of a directory in the image, its ranges checked against the tables
+		const ImageDir& imageDir(const uint64_t index) const;
+		// builds the entries of a directory from its image record, dir must not be locked by the caller
+		void materialize(const std::shared_ptr<Directory>& dir) const;
+		// adds the files of every directory not yet built to m_filesByName, once
+		void indexImage() const;
+		// builds the directories above the record down to it, null once it was removed
+		std::shared_ptr<Directory> builtImageDir(const uint32_t index) const;
+		// null if key is not a record of the image
+		const ImageFile* imageFileOf(const void* key) const;
+		// called while the changed directory is write locked, empty when nothing is watched,
+		// every sequence handed out must be queued, by notifyWatches or queueWatchEvent
+		std::optional<uint64_t> stampWatchEvent() const;
+		// queues the event stamped with sequence for name in dir, moved to destName in destDir for a move
+		// the paths are built from the tree, so no directory lock may be held
+		void notifyWatches(const std::optional<uint64_t> sequence, const WatchEvent::Kind kind, const bool isDirectory, const std::shared_ptr<Directory>& dir,
+			std::string_view name, const std::shared_ptr<Directory>& destDir = nullptr, std::string_view destName = std::string_view()) const;
+		void queueWatchEvent(const uint64_t sequence, WatchEvent&& event) const;
+		// runs on m_watchThread until the destructor stops it
+		void deliverWatchEvents();
+		// a create undone by a remove of the same path later in the batch drops both
+		static void coalesce(std::vector<WatchEvent>& events);
+		// path is one of the entries watch covers, or the watched directory itself
+		static bool isWatched(const Watch& watch, std::string_view path);
+		size_t watch(const std::shared_ptr<Directory>& workingDir, std::string_view path, const bool isRecursive, WatchCallback callback);
+		// from dir up to the root, the caller holds m_totalsMutex
+		static void addToTotals(std::shared_ptr<Directory> dir, const TotalsDelta& delta);
+		// what a regular file or a whole subtree adds to the totals above it, reads the size of a file under its dataMutex
+		static TotalsDelta totalsOf(const std::shared_ptr<File>& node);
+		// called by writers after changing dir's entries or name, or the data of a file in it
+		void markChanged(const std::shared_ptr<Directory>& dir) const;
+		// clears isFrozen of the directories queued by markChanged and of everything above them, needs m_freezeMutex,
+		// unless m_snapshotMutex is held exclusively a concurrent move can leave a parent out, which it queues in turn
+		void thawChanged() const;
+		// reuses the frozen copy of every directory that has a current one, needs m_freezeMutex,
+		// unless m_snapshotMutex is held exclusively the copy can miss changes, which markChanged queues for the refreeze
+		std::shared_ptr<const Snapshot::Directory> freeze(const std::shared_ptr<Directory>& dir) const;
+		std::shared_ptr<File> makeFile(const std::shared_ptr<Directory>& workingDir, std::string_view pathToNewFile, const bool isDirectory, const bool shouldCreateMissingDirectories);
+		std::shared_ptr<File> removeFile(const std::shared_ptr<Directory>& workingDir, std::string_view pathToRemove);
+		std::shared_ptr<File> copyFile(const std::shared_ptr<Directory>& workingDir, std::string_view sourcePath, std::string_view destPath, const bool shouldRemoveOriginal);
+		std::string printTree(const std::shared_ptr<Directory>& workingDir, std::string_view path) const;
+		void printTree(const std::shared_ptr<Directory>& workingDir, std::string_view path, std::ostream& out, const PrintOptions& options) const;
+		static std::string pathOf(std::shared_ptr<Directory> dir);
+		// false if dir is no longer reachable from the root
+		bool pathFromRoot(std::shared_ptr<Directory> dir, std::string& path) const;
+		WorkStealingPool& traversalPool() const;
+		// appends one line per entry, each starting with a newline
+		void printTreeRecursive(WorkStealingPool& pool, const std::shared_ptr<Directory>& dir, const size_t numIndents, std::string& output) const;
+		// allocated in m_inodeArena
+		template <class Node, class... Args>
+		std::shared_ptr<Node> makeNode(Args&&... args) const;
+		// the directories of a copy of source named name, not built and without a parent, appended to copiedDirs top down
+		std::shared_ptr<Directory> copyTree(const std::shared_ptr<const Snapshot::Directory>& source, InternedString name, std::vector<std::shared_ptr<Directory>>& copiedDirs) const;
+		// adds the gathered entries to the directory in one go, returns the number of files that were not there yet
+		size_t flushBulkLevel(BulkLevel& level) const;
+		FileIndexShard& fileIndexShardOf(std::string_view name) const;
+		std::array<std::unique_lock<std::shared_mutex>, NUM_SHARDS> lockFileIndex() const;
+		void indexFile(const std::string& name, const std::shared_ptr<File>& file, const std::shared_ptr<Directory>& dir) const;
+		void unindexFile(const std::string& name, const File* file);
+		// adds the files of copied directories not built yet to m_filesByName, keyed by their frozen files
+		void indexCopy(const std::vector<std::shared_ptr<Directory>>& copiedDirs) const;
+		// drops the files of a removed subtree from m_filesByName, together with the records of what was never built
+		void unindexTree(const std::shared_ptr<Directory>& dir);
+		// query calls one of the forEach functions of the shard it is given with the visitor,
+		// a query by exact name only reads the shard of that name
+		template <class Query>
+		std::vector<std::string> findIndexed(Query&& query, const std::optional<std::string_view> name) const;
+		std::shared_ptr<File> getFile(const std::shared_ptr<Directory>& workingDir, std::string_view path) const;
+		std::shared_ptr<Block> makeBlock(const bool isZeroed) const;
+		// the block is not shared once this returns, so it can be written in place
+		void ensureOwned(std::shared_ptr<Block>& block) const;
+		// shares the block map of source, locks source for reading
+		static void copyContents(const File& source, File& dest);
+		// the block map of data, copied first if a copy or snapshot shares it, the caller holds data's mutex exclusively
+		static BlockMap& ownedBlocks(FileData& data);
+		// reads up to size, holes read as zeros, returns the number of bytes read
+		static size_t readBlocks(const BlockMap* blocks, const uint64_t size, const uint64_t offset, std::span<std::byte> buffer);
+		size_t write(const std::shared_ptr<Directory>& workingDir, std::string_view path, const uint64_t offset, std::span<const std::byte> data);
+		size_t read(const std::shared_ptr<Directory>& workingDir, std::string_view path, const uint64_t offset, std::span<std::byte> buffer) const;
+		void truncate(const std::shared_ptr<Directory>& workingDir, std::string_view path, const uint64_t size);
+		FileView readView(const std::shared_ptr<Directory>& workingDir, std::string_view path, const uint64_t offset, const uint64_t length) const;
+		uint64_t fileSize(const std::shared_ptr<Directory>& workingDir, std::string_view path) const;
+		Stat stat(const std::shared_ptr<Directory>& workingDir, std::string_view path) const;
 	public:
+		/*
+		* a client of the tree with its own working directory, so concurrent clients resolve relative paths independently
+		* and changing directory takes no lock shared with other sessions
+		* a session is a pointer and a working directory: cheap to open, meant to be used by one thread at a time,
+		* and it must not outlive its FileSystem
+		*/
+		class Session {
+			friend class FileSystem;
+
+			FileSystem* m_fileSystem;
+			std::shared_ptr<Directory> m_pwd;
+
+			Session(FileSystem& fileSystem, std::shared_ptr<Directory> pwd);
+		public:
+			std::shared_ptr<Directory> getPwd() const;
+
+			std::shared_ptr<File> makeFile(std::string&& pathToNewFile, const bool isDirectory, const bool shouldCreateMissingDirectories = false);
+			std::shared_ptr<Directory> changeDirectory(std::string&& path);
+			std::shared_ptr<File> removeFile(std::string&& pathToRemove);
+			std::shared_ptr<File> moveFile(std::string&& sourcePath, std::string&& destPath);
+			std::shared_ptr<File> copyFile(std::string&& sourcePath, std::string&& destPath);
+			std::string printTree(std::string&& path) const;
+			void printTree(std::string&& path, std::ostream& out, const PrintOptions& options = PrintOptions()) const;
+			std::string getCurrentPath() const;
+			std::vector<std::string> findFile(std::string&& fileName) const;
+			std::vector<std::string> findFileContaining(std::string&& fragment) const;
+			std::vector<std::string> findFileMatching(std::string&& pattern) const;
+			size_t write(std::string&& path, const uint64_t offset, std::span<const std::byte> data);
+			size_t read(std::string&& path, const uint64_t offset, std::span<std::byte> buffer) const;
+			FileView readView(std::string&& path, const uint64_t offset, const uint64_t length) const;
+			void truncate(std::string&& path, const uint64_t size);
+			uint64_t fileSize(std::string&& path) const;
+			Stat stat(std::string&& path) const;
+			size_t watch(std::string&& path, const bool isRecursive, WatchCallback callback);
+		};
+
 		FileSystem();
+		// dentryCacheCapacity is the number of resolved paths remembered, zero disables the cache
+		explicit FileSystem(const size_t dentryCacheCapacity);
+		// maps an image written by save, the file must not be changed while the FileSystem or any of its data is alive
+		explicit FileSystem(const std::string& imagePath);
+		// delivers the events already queued before it returns
+		~FileSystem();
 
 		const std::shared_ptr<Directory> getRoot() const;
 		std::shared_ptr<Directory> getPwd() const;
+		// the new session starts in the root directory
+		Session openSession();
+		// pauses writers while the directories changed since the last snapshot are copied, readers are not held up,
+		// directories no snapshot has seen yet, the whole tree the first time, are copied before writers are paused
+		Snapshot snapshot();
+		// pauses writers while the tree is flattened, replaces imagePath only once the whole image is written
+		void save(const std::string& imagePath) const;
+		/*
+		* creates the paths read from manifest, one per line, resolved from the root, a trailing slash marks a directory
+		* missing parents are created and entries that already exist are skipped, returns the number of entries created
+		* the directories of the path before stay resolved, so in sorted input every shared prefix is walked once,
+		* and each directory takes its new entries in one batch when the input leaves it, its maps sized once for them
+		* writers wait for the whole load, readers see each directory fill in as its batch lands
+		*/
+		size_t bulkLoad(std::istream& manifest);
 
 		std::shared_ptr<File> makeFile(std::string&& pathToNewFile, const bool isDirectory, const bool shouldCreateMissingDirectories = false);
 		std::shared_ptr<Directory> changeDirectory(std::string&& path);
@@ -50,8 +649,36 @@ namespace implementations {
 		std::shared_ptr<File> moveFile(std::string&& sourcePath, std::string&& destPath);
 		std::shared_ptr<File> copyFile(std::string&& sourcePath, std::string&& destPath);
 		std::string printTree(std::string&& path) const;
+		// streams the same lines as printTree, stops early once out fails
+		void printTree(std::string&& path, std::ostream& out, const PrintOptions& options = PrintOptions()) const;
 		std::string getCurrentPath() const;
+		// absolute paths of the regular files named exactly fileName
 		std::vector<std::string> findFile(std::string&& fileName) const;
+		// absolute paths of the regular files whose name contains fragment
+		std::vector<std::string> findFileContaining(std::string&& fragment) const;
+		// absolute paths of the regular files whose name matches a glob pattern with '*' and '?'
+		std::vector<std::string> findFileMatching(std::string&& pattern) const;
+		// writes data at offset, growing the file if it ends past the end, returns the number of bytes written
+		size_t write(std::string&& path, const uint64_t offset, std::span<const std::byte> data);
+		// reads up to the end of the file, returns the number of bytes read
+		size_t read(std::string&& path, const uint64_t offset, std::span<std::byte> buffer) const;
+		// up to length bytes from offset, cut short at the end of the file
+		FileView readView(std::string&& path, const uint64_t offset, const uint64_t length) const;
+		// shrinks or grows the file, growing leaves a hole
+		void truncate(std::string&& path, const uint64_t size);
+		uint64_t fileSize(std::string&& path) const;
+		// totals of a directory are kept up to date on every change, so this costs the path walk and not the subtree
+		Stat stat(std::string&& path) const;
+		/*
+		* callback gets the creates, removes and moves of the entries of the directory at path,
+		* and of everything below it if isRecursive, returns the id to unwatch it with
+		* a copied, moved or removed directory is one event, not one per entry inside it
+		* the events queued while the previous batch was delivered make up the next, so a burst arrives in few calls
+		* callbacks run one at a time on a background thread and must not throw
+		*/
+		size_t watch(std::string&& path, const bool isRecursive, WatchCallback callback);
+		// a batch already being delivered may still reach the callback
+		void unwatch(const size_t watchId);
 	};
 }
 
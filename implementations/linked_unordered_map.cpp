@@ -1,109 +1,482 @@
 #include "linked_unordered_map.h"
 
+#include <algorithm>
 #include <stdexcept>
+#include <type_traits>
 
 namespace implementations {
-	template <class K, class V>
-	LinkedUnorderedMap<K, V>::LinkedNode::LinkedNode(const K& key, const V& value, const LinkedNodePtr& next, const LinkedNodePtr& prev)
-		: key(key), value(value), next(next), prev(prev) {}
+	inline size_t TransparentStringHash::operator()(std::string_view key) const noexcept {
+		return std::hash<std::string_view>()(key);
+	}
+
+	template <class KeyLike>
+	std::string missingKeyMessage(const KeyLike& key) {
+		if constexpr (std::is_convertible_v<const KeyLike&, std::string_view>) {
+			return std::string(std::string_view(key)) + " does not exist in map";
+		}
+		else if constexpr (std::is_arithmetic_v<KeyLike>) {
+			return std::to_string(key) + " does not exist in map";
+		}
+		else {
+			return "Key does not exist in map";
+		}
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <class KeyArg, class ...Args>
+	LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::LinkedNode::LinkedNode(KeyArg&& key, Args&&... args)
+		: key(std::forward<KeyArg>(key)), value(std::forward<Args>(args)...), next(nullptr), prev(nullptr) {}
 
-	template <class K, class V>
-	LinkedUnorderedMap<K, V>::LinkedUnorderedMap()
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::LinkedUnorderedMap()
 		: m_nodesMap()
-		, m_head(std::make_shared<LinkedNode>(K(), V()))
-		, m_tail(m_head)
+		, m_readIndex()
+		, m_head(std::make_shared<LinkedNode>(K()))
+		, m_tail(m_head.get())
 		, m_length(0)
 		, m_mutex() {}
 
-	template<class K, class V>
-	bool LinkedUnorderedMap<K, V>::hasKey(const K& key) const
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::~LinkedUnorderedMap() {
+		// release the chain iteratively, letting each node destroy its successor would recurse once per node
+		m_nodesMap.clear();
+		m_tail = nullptr;
+		LinkedNodePtr node = std::move(m_head->next);
+		while (node) {
+			node = std::move(node->next);
+		}
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <class KeyLike>
+	auto LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::findNode(const KeyLike& key) const -> LinkedNode* {
+		if constexpr (Concurrency::hasLockFreeReads) {
+			return m_readIndex.find(key);
+		}
+		else {
+			const auto it = m_nodesMap.find(key);
+			return it == m_nodesMap.cend() ? nullptr : it->second.get();
+		}
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <class KeyLike>
+	bool LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::hasKey(const KeyLike& key) const
 	{
-		return m_nodesMap.find(key) != m_nodesMap.cend();
+		ReadLock lock(m_mutex);
+		return findNode(key) != nullptr;
 	}
 
-	template <class K, class V>
-	V& LinkedUnorderedMap<K, V>::operator[](const K& key) const {
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
-		const auto it = m_nodesMap.find(key);
-		if (it == m_nodesMap.cend()) {
-			throw std::invalid_argument(key + " does not exist in map");
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <class KeyLike>
+	V& LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::operator[](const KeyLike& key) const {
+		ReadLock lock(m_mutex);
+		LinkedNode* node = findNode(key);
+		if (!node) {
+			throw std::invalid_argument(missingKeyMessage(key));
+		}
+		return node->value;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <class KeyLike>
+	V* LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::find(const KeyLike& key) {
+		ReadLock lock(m_mutex);
+		LinkedNode* node = findNode(key);
+		return node ? &node->value : nullptr;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <class KeyLike>
+	const V* LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::find(const KeyLike& key) const {
+		ReadLock lock(m_mutex);
+		const LinkedNode* node = findNode(key);
+		return node ? &node->value : nullptr;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <class KeyLike, class Visitor>
+	bool LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::visit(const KeyLike& key, Visitor&& visitor) const {
+		ReadLock lock(m_mutex);
+		const LinkedNode* node = findNode(key);
+		if (!node) {
+			return false;
 		}
-		return it->second->value;
+		visitor(node->value);
+		return true;
 	}
 
-	template <class K, class V>
-	size_t LinkedUnorderedMap<K, V>::size() const noexcept {
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	size_t LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::size() const noexcept {
 		return m_length;
 	}
 
-	template <class K, class V>
-	bool LinkedUnorderedMap<K, V>::empty() const noexcept {
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	bool LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::empty() const noexcept {
 		return m_length == 0;
 	}
 
-	template <class K, class V>
-	bool LinkedUnorderedMap<K, V>::insertAtHead(const K& key, const V& value) {
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	bool LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::insertAtHead(const K& key, const V& value) {
+		return tryEmplaceAtHead(key, value);
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	bool LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::insertAtHead(K&& key, V&& value) {
+		return tryEmplaceAtHead(std::move(key), std::move(value));
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	bool LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::insertAtTail(const K& key, const V& value) {
+		return tryEmplaceAtTail(key, value);
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	bool LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::insertAtTail(K&& key, V&& value) {
+		return tryEmplaceAtTail(std::move(key), std::move(value));
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <class KeyArg, class ...Args>
+	bool LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::tryEmplaceAtHead(KeyArg&& key, Args&&... args) {
+		WriteLock lock(m_mutex);
+		return emplaceAtHeadUnlocked(std::forward<KeyArg>(key), std::forward<Args>(args)...);
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <class KeyArg, class ...Args>
+	bool LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::tryEmplaceAtTail(KeyArg&& key, Args&&... args) {
+		WriteLock lock(m_mutex);
+		return emplaceAtTailUnlocked(std::forward<KeyArg>(key), std::forward<Args>(args)...);
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	void LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::index(LinkedNodePtr&& node) {
+		if constexpr (Concurrency::hasLockFreeReads) {
+			m_readIndex.insert(node->key, node.get(), m_mutex.epochs);
+		}
+		m_length++;
+		m_nodesMap.emplace(node->key, std::move(node));
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <class KeyArg, class ...Args>
+	bool LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::emplaceAtHeadUnlocked(KeyArg&& key, Args&&... args) {
 		if (!m_head->next) {
-			return insertAtTail(key, value);
+			return emplaceAtTailUnlocked(std::forward<KeyArg>(key), std::forward<Args>(args)...);
 		}
 		if (m_nodesMap.find(key) != m_nodesMap.cend()) {
 			return false;
 		}
-		m_head->next = make_shared<LinkedNode>(key, value, m_head->next, m_head);
-		m_length++;
-		m_nodesMap[key] = m_head->next;
+		LinkedNodePtr node = std::make_shared<LinkedNode>(std::forward<KeyArg>(key), std::forward<Args>(args)...);
+		node->prev = m_head.get();
+		node->next = std::move(m_head->next);
+		node->next->prev = node.get();
+		m_head->next = node;
+		index(std::move(node));
 		return true;
 	}
 
-	template <class K, class V>
-	bool LinkedUnorderedMap<K, V>::insertAtTail(const K& key, const V& value) {
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <class KeyArg, class ...Args>
+	bool LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::emplaceAtTailUnlocked(KeyArg&& key, Args&&... args) {
 		if (m_nodesMap.find(key) != m_nodesMap.cend()) {
 			return false;
 		}
-		m_tail->next = make_shared<LinkedNode>(key, value, nullptr, m_tail);
-		m_tail = m_tail->next;
-		m_length++;
-		m_nodesMap[key] = m_tail;
+		LinkedNodePtr node = std::make_shared<LinkedNode>(std::forward<KeyArg>(key), std::forward<Args>(args)...);
+		node->prev = m_tail;
+		m_tail->next = node;
+		m_tail = node.get();
+		index(std::move(node));
 		return true;
 	}
 
-	template <class K, class V>
-	V LinkedUnorderedMap<K, V>::remove(const K& key) {
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
-		const auto it = m_nodesMap.find(key);
-		if (it == m_nodesMap.cend()) {
-			throw std::invalid_argument(key + " does not exist in map");
-		}
-		if (!it->second->next) {
-			m_tail = it->second->prev;
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	void LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::unlink(LinkedNode* node) {
+		if (!node->next) {
+			m_tail = node->prev;
 			m_tail->next = nullptr;
 		}
 		else {
-			it->second->prev->next = it->second->next;
-			it->second->next->prev = it->second->prev;
+			node->next->prev = node->prev;
+			node->prev->next = std::move(node->next);
 		}
-		V value = it->second->value;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	auto LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::removeUnlocked(const typename NodesMap::iterator it) -> LinkedNodePtr {
+		LinkedNodePtr node = std::move(it->second);
 		m_nodesMap.erase(it);
+		unlink(node.get());
 		m_length--;
-		return value;
+		if constexpr (Concurrency::hasLockFreeReads) {
+			// a reader may still hold the node, it is destroyed once the reader leaves its epoch
+			m_readIndex.erase(node->key, m_mutex.epochs);
+			m_mutex.epochs.retire(node);
+		}
+		return node;
 	}
 
-	template <class K, class V>
-	std::pair<K, V> LinkedUnorderedMap<K, V>::remove(const bool removeFirstItem) {
-		if (empty()) {
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <class KeyLike>
+	V LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::remove(const KeyLike& key) {
+		WriteLock lock(m_mutex);
+		const auto it = m_nodesMap.find(key);
+		if (it == m_nodesMap.end()) {
+			throw std::invalid_argument(missingKeyMessage(key));
+		}
+		if constexpr (Concurrency::hasLockFreeReads) {
+			// readers may still be reading the retired node, hand out a copy
+			return removeUnlocked(it)->value;
+		}
+		else {
+			return std::move(removeUnlocked(it)->value);
+		}
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	std::pair<K, V> LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::remove(const bool removeFirstItem) {
+		WriteLock lock(m_mutex);
+		if (m_length == 0) {
 			throw std::runtime_error("Cannot remove from empty map");
 		}
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
-		auto toBeRemoved = removeFirstItem ? m_head->next : m_tail;
-		remove(toBeRemoved->key);
-		return std::make_pair(toBeRemoved->key, toBeRemoved->value);
+		const LinkedNode* node = removeFirstItem ? m_head->next.get() : m_tail;
+		const LinkedNodePtr removed = removeUnlocked(m_nodesMap.find(node->key));
+		if constexpr (Concurrency::hasLockFreeReads) {
+			return std::make_pair(removed->key, removed->value);
+		}
+		else {
+			return std::make_pair(std::move(removed->key), std::move(removed->value));
+		}
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <class KeyLike>
+	bool LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::erase(const KeyLike& key) {
+		WriteLock lock(m_mutex);
+		const auto it = m_nodesMap.find(key);
+		if (it == m_nodesMap.end()) {
+			return false;
+		}
+		removeUnlocked(it);
+		return true;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <class KeyLike>
+	bool LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::moveToEnd(const KeyLike& key) {
+		WriteLock lock(m_mutex);
+		const auto it = m_nodesMap.find(key);
+		if (it == m_nodesMap.cend()) {
+			throw std::invalid_argument(missingKeyMessage(key));
+		}
+		const LinkedNodePtr node = it->second;
+		if (node.get() == m_tail) {
+			return true;
+		}
+		unlink(node.get());
+		node->prev = m_tail;
+		m_tail->next = node;
+		m_tail = node.get();
+		return true;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <bool IsConst, bool IsReverse>
+	LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::Iterator<IsConst, IsReverse>::Iterator(LinkedNode* node, const LinkedNode* sentinel)
+		: m_node(node), m_sentinel(sentinel) {}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <bool IsConst, bool IsReverse>
+	LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::Iterator<IsConst, IsReverse>::Iterator()
+		: m_node(nullptr), m_sentinel(nullptr) {}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <bool IsConst, bool IsReverse>
+	template <bool WasConst, class>
+	LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::Iterator<IsConst, IsReverse>::Iterator(const Iterator<WasConst, IsReverse>& other)
+		: m_node(other.m_node), m_sentinel(other.m_sentinel) {}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <bool IsConst, bool IsReverse>
+	auto LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::Iterator<IsConst, IsReverse>::operator*() const -> reference {
+		return reference(m_node->key, m_node->value);
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <bool IsConst, bool IsReverse>
+	const K& LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::Iterator<IsConst, IsReverse>::key() const {
+		return m_node->key;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <bool IsConst, bool IsReverse>
+	std::conditional_t<IsConst, const V&, V&> LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::Iterator<IsConst, IsReverse>::value() const {
+		return m_node->value;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <bool IsConst, bool IsReverse>
+	auto LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::Iterator<IsConst, IsReverse>::operator++() -> Iterator& {
+		if constexpr (IsReverse) {
+			m_node = m_node->prev == m_sentinel ? nullptr : m_node->prev;
+		}
+		else {
+			m_node = m_node->next.get();
+		}
+		return *this;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <bool IsConst, bool IsReverse>
+	auto LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::Iterator<IsConst, IsReverse>::operator++(int) -> Iterator {
+		Iterator previous = *this;
+		++(*this);
+		return previous;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <bool IsConst, bool IsReverse>
+	bool LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::Iterator<IsConst, IsReverse>::operator==(const Iterator& other) const {
+		return m_node == other.m_node;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <bool IsConst, bool IsReverse>
+	bool LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::Iterator<IsConst, IsReverse>::operator!=(const Iterator& other) const {
+		return m_node != other.m_node;
 	}
 
-	template <class K, class V>
-	bool LinkedUnorderedMap<K, V>::moveToEnd(const K& key) {
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
-		return insertAtTail(key, remove(key));
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	typename LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::iterator LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::begin() {
+		return iterator(m_head->next.get(), m_head.get());
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	typename LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::iterator LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::end() {
+		return iterator(nullptr, m_head.get());
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	typename LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::const_iterator LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::begin() const {
+		return const_iterator(m_head->next.get(), m_head.get());
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	typename LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::const_iterator LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::end() const {
+		return const_iterator(nullptr, m_head.get());
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	typename LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::const_iterator LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::cbegin() const {
+		return const_iterator(m_head->next.get(), m_head.get());
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	typename LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::const_iterator LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::cend() const {
+		return const_iterator(nullptr, m_head.get());
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	typename LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::reverse_iterator LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::rbegin() {
+		return reverse_iterator(m_tail == m_head.get() ? nullptr : m_tail, m_head.get());
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	typename LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::reverse_iterator LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::rend() {
+		return reverse_iterator(nullptr, m_head.get());
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	typename LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::const_reverse_iterator LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::rbegin() const {
+		return const_reverse_iterator(m_tail == m_head.get() ? nullptr : m_tail, m_head.get());
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	typename LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::const_reverse_iterator LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::rend() const {
+		return const_reverse_iterator(nullptr, m_head.get());
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	std::vector<V*> LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::getMany(std::span<const K> keys) {
+		// with an index that can prefetch (SwissTable), probes a batch of keys at a time, prefetching the group of
+		// every key of the batch before looking any of them up so the cache misses of the batch overlap
+		static constexpr size_t BATCH_SIZE = 16;
+		std::vector<V*> values(keys.size(), nullptr);
+		ReadLock lock(m_mutex);
+		if constexpr (Concurrency::hasLockFreeReads) {
+			// the published shards are not bucket addressable, lock free readers probe one key at a time
+			for (size_t i = 0; i < keys.size(); i++) {
+				LinkedNode* node = findNode(keys[i]);
+				values[i] = node ? &node->value : nullptr;
+			}
+			return values;
+		}
+		else {
+			if (m_nodesMap.empty()) {
+				return values;
+			}
+			const auto lookUp = [this, &keys, &values](const size_t i) {
+				const auto it = m_nodesMap.find(keys[i]);
+				if (it != m_nodesMap.cend()) {
+					values[i] = &it->second->value;
+				}
+			};
+			if constexpr (requires { m_nodesMap.prefetch(keys.front()); }) {
+				for (size_t batchStart = 0; batchStart < keys.size(); batchStart += BATCH_SIZE) {
+					const size_t batchEnd = std::min(batchStart + BATCH_SIZE, keys.size());
+					for (size_t i = batchStart; i < batchEnd; i++) {
+						m_nodesMap.prefetch(keys[i]);
+					}
+					for (size_t i = batchStart; i < batchEnd; i++) {
+						lookUp(i);
+					}
+				}
+			}
+			else {
+				// std::unordered_map only reaches a bucket's chain by hashing and walking it, which is the lookup itself
+				for (size_t i = 0; i < keys.size(); i++) {
+					lookUp(i);
+				}
+			}
+		}
+		return values;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	template <class InputIt>
+	size_t LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::insertMany(InputIt first, InputIt last) {
+		WriteLock lock(m_mutex);
+		if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>) {
+			m_nodesMap.reserve(m_nodesMap.size() + std::distance(first, last));
+		}
+		size_t numInserted = 0;
+		for (; first != last; ++first) {
+			auto&& entry = *first;
+			numInserted += emplaceAtTailUnlocked(std::get<0>(std::forward<decltype(entry)>(entry)), std::get<1>(std::forward<decltype(entry)>(entry)));
+		}
+		return numInserted;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	size_t LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::insertMany(std::span<const std::pair<K, V>> entries) {
+		return insertMany(entries.begin(), entries.end());
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Concurrency, template <class...> class Index>
+	std::vector<std::pair<K, V>> LinkedUnorderedMap<K, V, Hash, KeyEqual, Concurrency, Index>::drainFront(const size_t count) {
+		WriteLock lock(m_mutex);
+		std::vector<std::pair<K, V>> drained;
+		drained.reserve(std::min(count, size()));
+		while (drained.size() < count && m_head->next) {
+			const LinkedNodePtr removed = removeUnlocked(m_nodesMap.find(m_head->next->key));
+			if constexpr (Concurrency::hasLockFreeReads) {
+				drained.emplace_back(removed->key, removed->value);
+			}
+			else {
+				drained.emplace_back(std::move(removed->key), std::move(removed->value));
+			}
+		}
+		return drained;
 	}
-}
\ No newline at end of file
+}
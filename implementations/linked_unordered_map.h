@@ -1,16 +1,49 @@
 #pragma once
 
+#include "concurrency_policy.h"
+
+#include <functional>
+#include <iterator>
 #include <memory>
-#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace implementations {
+	/*
+	* transparent hash for string keys, lets maps keyed by std::string be probed
+	* with a std::string_view or const char* without allocating a temporary std::string
+	*/
+	struct TransparentStringHash {
+		using is_transparent = void;
+
+		size_t operator()(std::string_view key) const noexcept;
+	};
+
+	template <class KeyLike>
+	std::string missingKeyMessage(const KeyLike& key);
+
 	/*
 	* implementation of a linked unordered map
 	* similar to OrderedDict in Python or LinkedHashMap in Java
 	* O(1) insert at the ends, O(1) remove, O(1) lookup
+	* lookups accept any key type the hash and key equal accept, so with transparent functors
+	* (eg TransparentStringHash and std::equal_to<>) string keys can be probed with a std::string_view
+	* iteration follows the linked order, iterators are invalidated by removing the element they point to
+	* and must not be used while another thread mutates the map
+	* bulk operations take the lock once for the whole batch
+	* Concurrency picks the synchronisation, see concurrency_policy.h: SingleThreaded pays nothing,
+	* SharedMutexLocking lets readers run concurrently and EpochReclamation lets them run without a lock,
+	* at the price of a write also updating the lock free read index, O(1) amortised, and retiring what it removed,
+	* which waits for readers once EpochManager::MAX_RETIRED objects are pending,
+	* references and pointers handed out are only protected while no other thread removes the key, use visit for that,
+	* and writes through them are not synchronised
+	* Index is the hash table from keys to nodes, eg SwissTable with SeededHash for keys that come from untrusted input
 	*/
-	template <class K, class V>
+	template <class K, class V, class Hash = std::hash<K>, class KeyEqual = std::equal_to<K>, class Concurrency = SharedMutexLocking, template <class...> class Index = std::unordered_map>
 	class LinkedUnorderedMap
 	{
 		struct LinkedNode;
@@ -20,31 +53,129 @@ namespace implementations {
 			K key;
 			V value;
 			LinkedNodePtr next;
-			LinkedNodePtr prev;
+			// non-owning, an owning prev would form a reference cycle with next
+			LinkedNode* prev;
 
-			LinkedNode(const K& key, const V& value, const LinkedNodePtr& next = nullptr, const LinkedNodePtr& prev = nullptr);
+			template <class KeyArg, class ...Args>
+			LinkedNode(KeyArg&& key, Args&&... args);
 		};
 
-		std::unordered_map<K, LinkedNodePtr> m_nodesMap;
+		using NodesMap = Index<K, LinkedNodePtr, Hash, KeyEqual>;
+		using ReadLock = typename Concurrency::ReadLock;
+		using WriteLock = typename Concurrency::WriteLock;
+
+		// owned by writers, lock free readers go through m_readIndex instead
+		NodesMap m_nodesMap;
+		typename Concurrency::template ReadIndex<K, LinkedNode*, Hash, KeyEqual> m_readIndex;
+		// the sentinel head owns the chain through next
 		LinkedNodePtr m_head;
-		LinkedNodePtr m_tail;
-		size_t m_length;
-		mutable std::recursive_mutex m_mutex;
+		LinkedNode* m_tail;
+		typename Concurrency::Counter m_length;
+		mutable typename Concurrency::Mutex m_mutex;
+
+		// the helpers below expect the caller to hold the matching lock
+		template <class KeyLike>
+		LinkedNode* findNode(const KeyLike& key) const;
+		void unlink(LinkedNode* node);
+		void index(LinkedNodePtr&& node);
+		template <class KeyArg, class ...Args>
+		bool emplaceAtHeadUnlocked(KeyArg&& key, Args&&... args);
+		template <class KeyArg, class ...Args>
+		bool emplaceAtTailUnlocked(KeyArg&& key, Args&&... args);
+		LinkedNodePtr removeUnlocked(const typename NodesMap::iterator it);
+
+		template <bool IsConst, bool IsReverse>
+		class Iterator {
+			friend class LinkedUnorderedMap;
+			template <bool, bool>
+			friend class Iterator;
+
+			LinkedNode* m_node;
+			const LinkedNode* m_sentinel;
+
+			Iterator(LinkedNode* node, const LinkedNode* sentinel);
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using difference_type = std::ptrdiff_t;
+			using value_type = std::pair<const K, V>;
+			using reference = std::pair<const K&, std::conditional_t<IsConst, const V&, V&>>;
+
+			Iterator();
+			// lets a mutable iterator convert to its const counterpart
+			template <bool WasConst, class = std::enable_if_t<IsConst && !WasConst>>
+			Iterator(const Iterator<WasConst, IsReverse>& other);
+
+			reference operator*() const;
+			const K& key() const;
+			std::conditional_t<IsConst, const V&, V&> value() const;
+			Iterator& operator++();
+			Iterator operator++(int);
+			bool operator==(const Iterator& other) const;
+			bool operator!=(const Iterator& other) const;
+		};
 	public:
+		using iterator = Iterator<false, false>;
+		using const_iterator = Iterator<true, false>;
+		using reverse_iterator = Iterator<false, true>;
+		using const_reverse_iterator = Iterator<true, true>;
+
 		LinkedUnorderedMap();
+		~LinkedUnorderedMap();
 
-		bool hasKey(const K& key) const;
-		V& operator[](const K& key) const;
+		template <class KeyLike>
+		bool hasKey(const KeyLike& key) const;
+		template <class KeyLike>
+		V& operator[](const KeyLike& key) const;
+		// returns nullptr instead of throwing when the key is missing
+		template <class KeyLike>
+		V* find(const KeyLike& key);
+		template <class KeyLike>
+		const V* find(const KeyLike& key) const;
+		// calls visitor with the value while the read lock is held, the safe way to read a value another thread may remove
+		template <class KeyLike, class Visitor>
+		bool visit(const KeyLike& key, Visitor&& visitor) const;
 		size_t size() const noexcept;
 		bool empty() const noexcept;
 
 		bool insertAtHead(const K& key, const V& value);
+		bool insertAtHead(K&& key, V&& value);
 		bool insertAtTail(const K& key, const V& value);
+		bool insertAtTail(K&& key, V&& value);
+		// constructs the value in place from args, nothing is constructed if the key already exists
+		template <class KeyArg, class ...Args>
+		bool tryEmplaceAtHead(KeyArg&& key, Args&&... args);
+		template <class KeyArg, class ...Args>
+		bool tryEmplaceAtTail(KeyArg&& key, Args&&... args);
 
-		V remove(const K& key);
+		template <class KeyLike>
+		V remove(const KeyLike& key);
 		std::pair<K, V> remove(const bool removeFirstItem);
+		// removes without moving the value out
+		template <class KeyLike>
+		bool erase(const KeyLike& key);
+
+		// relinks the existing node, no allocation or rehashing
+		template <class KeyLike>
+		bool moveToEnd(const KeyLike& key);
 
-		bool moveToEnd(const K& key);
+		iterator begin();
+		iterator end();
+		const_iterator begin() const;
+		const_iterator end() const;
+		const_iterator cbegin() const;
+		const_iterator cend() const;
+		reverse_iterator rbegin();
+		reverse_iterator rend();
+		const_reverse_iterator rbegin() const;
+		const_reverse_iterator rend() const;
+
+		// one pointer per key, nullptr for missing keys
+		std::vector<V*> getMany(std::span<const K> keys);
+		// inserts at the tail, keys already present are skipped, returns the number inserted
+		template <class InputIt>
+		size_t insertMany(InputIt first, InputIt last);
+		size_t insertMany(std::span<const std::pair<K, V>> entries);
+		// removes up to count items from the head
+		std::vector<std::pair<K, V>> drainFront(const size_t count);
 	};
 }
-
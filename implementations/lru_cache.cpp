@@ -1,58 +1,467 @@
 #include "lru_cache.h"
 
 #include "linked_unordered_map.h"
+#include "thread_pool.h"
+#include "timer_wheel.h"
+
+#include <stdexcept>
 
 namespace implementations {
-	template <class K, class V>
-	LruCache<K, V>::LruCache(const size_t capacity)
-		: m_map(), m_capacity(capacity) {}
+	inline double CacheStats::hitRatio() const noexcept {
+		const uint64_t requests = hits + misses;
+		return requests == 0 ? 1.0 : static_cast<double>(hits) / requests;
+	}
+
+	inline std::chrono::nanoseconds CacheStats::averageLoadTime() const noexcept {
+		const uint64_t loads = loadSuccesses + loadFailures;
+		return loads == 0 ? std::chrono::nanoseconds::zero() : totalLoadTime / static_cast<int64_t>(loads);
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	LruCache<K, V, Hash, KeyEqual, Clock>::LruCache(const size_t capacity)
+		: LruCache(capacity, Duration::zero()) {}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	LruCache<K, V, Hash, KeyEqual, Clock>::LruCache(const size_t capacity, Weigher weigher)
+		: LruCache(capacity, std::move(weigher), Duration::zero()) {}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	LruCache<K, V, Hash, KeyEqual, Clock>::LruCache(const size_t capacity, const Duration defaultTtl)
+		: LruCache(capacity, [](const K&, const V&) -> size_t { return 1; }, defaultTtl) {}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	LruCache<K, V, Hash, KeyEqual, Clock>::LruCache(const size_t capacity, Weigher weigher, const Duration defaultTtl)
+		: m_map()
+		, m_capacity(capacity)
+		, m_weight(0)
+		, m_weigher(std::move(weigher))
+		, m_defaultTtl(defaultTtl)
+		, m_timerWheel(toTick(Clock::now()))
+		, m_loading()
+		, m_mutex()
+		, m_evictionListener()
+		, m_isRecordingStats(false)
+		, m_stats()
+		, m_refreshLoader()
+		, m_refreshFraction(1)
+		, m_refreshPool()
+		, m_refreshing()
+		, m_nextRefreshTicket(0)
+		, m_numPendingRefreshes(0)
+		, m_refreshesDone() {}
 
-	template<class K, class V>
-	size_t LruCache<K, V>::size() const
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	LruCache<K, V, Hash, KeyEqual, Clock>::~LruCache()
 	{
+		std::unique_lock<std::recursive_mutex> lock(m_mutex);
+		m_refreshesDone.wait(lock, [this]() { return m_numPendingRefreshes == 0; });
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	uint64_t LruCache<K, V, Hash, KeyEqual, Clock>::toTick(const TimePoint& time)
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	bool LruCache<K, V, Hash, KeyEqual, Clock>::isExpired(const Entry& entry, const TimePoint& now)
+	{
+		return entry.timer && entry.expiry <= now;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	size_t LruCache<K, V, Hash, KeyEqual, Clock>::size() const
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
 		return m_map.size();
 	}
 
-	template<class K, class V>
-	bool LruCache<K, V>::empty() const
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	size_t LruCache<K, V, Hash, KeyEqual, Clock>::weight() const
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		return m_weight;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	size_t LruCache<K, V, Hash, KeyEqual, Clock>::capacity() const
+	{
+		return m_capacity;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	typename LruCache<K, V, Hash, KeyEqual, Clock>::Duration LruCache<K, V, Hash, KeyEqual, Clock>::defaultTtl() const
+	{
+		return m_defaultTtl;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	bool LruCache<K, V, Hash, KeyEqual, Clock>::empty() const
 	{
 		return size() == 0;
 	}
 
-	template<class K, class V>
-	bool LruCache<K, V>::hasKey(const K& key) const
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	template <class KeyLike>
+	typename LruCache<K, V, Hash, KeyEqual, Clock>::Entry* LruCache<K, V, Hash, KeyEqual, Clock>::findLive(const KeyLike& key)
+	{
+		removeExpired();
+		Entry* entry = m_map.find(key);
+		if (entry && isExpired(*entry, Clock::now())) {
+			releaseEntry(*entry);
+			K expiredKey(key);
+			evict(std::move(expiredKey), m_map.remove(key), EvictionCause::Expired);
+			entry = nullptr;
+		}
+		record(entry ? m_stats.hits : m_stats.misses);
+		if (entry) {
+			refreshIfDue(key, *entry);
+		}
+		return entry;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	template <class KeyLike>
+	void LruCache<K, V, Hash, KeyEqual, Clock>::refreshIfDue(const KeyLike& key, const Entry& entry)
 	{
-		return m_map.hasKey(key);
+		if (!m_refreshLoader || !entry.timer) {
+			return;
+		}
+		const auto refreshAt = entry.expiry - std::chrono::duration_cast<Duration>(entry.ttl * (1 - m_refreshFraction));
+		if (Clock::now() < refreshAt) {
+			return;
+		}
+		K refreshKey(key);
+		if (m_refreshing.find(refreshKey) != m_refreshing.cend() || m_loading.find(refreshKey) != m_loading.cend()) {
+			return;
+		}
+		const uint64_t ticket = m_nextRefreshTicket++;
+		m_refreshing.emplace(refreshKey, ticket);
+		m_numPendingRefreshes++;
+		const bool isScheduled = m_refreshPool->trySubmit([this, refreshKey, ticket, ttl = entry.ttl, loader = m_refreshLoader]() {
+			refresh(refreshKey, ticket, ttl, loader);
+		});
+		if (!isScheduled) {
+			// the pool is saturated, the entry is served until it expires or a later hit finds room
+			m_refreshing.erase(refreshKey);
+			m_numPendingRefreshes--;
+			return;
+		}
+		record(m_stats.refreshes);
 	}
 
-	template<class K, class V>
-	V& LruCache<K, V>::get(const K& key)
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	void LruCache<K, V, Hash, KeyEqual, Clock>::refresh(const K& key, const uint64_t ticket, const Duration ttl, const RefreshLoader& loader)
 	{
-		if (m_map.moveToEnd(key)) {
-			return m_map[key];
+		std::optional<V> value;
+		const auto loadStart = std::chrono::steady_clock::now();
+		try {
+			value = loader(key);
+			record(m_stats.loadSuccesses);
+		}
+		catch (...) {
+			// a failed refresh leaves the current value to expire as it would have without refresh ahead
+			record(m_stats.loadFailures);
+		}
+		record(m_stats.totalLoadNanos, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - loadStart).count());
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		// declared after the lock, so the count drops while it is still held, however this task ends
+		struct PendingRefresh {
+			LruCache& cache;
+
+			~PendingRefresh() {
+				cache.m_numPendingRefreshes--;
+				cache.m_refreshesDone.notify_all();
+			}
+		} pendingRefresh{ *this };
+		const auto it = m_refreshing.find(key);
+		if (it != m_refreshing.end() && it->second == ticket) {
+			m_refreshing.erase(it);
+			if (value) {
+				try {
+					pushEntry(key, std::move(*value), ttl);
+				}
+				catch (...) {
+					// a throwing weigher or eviction listener loses the reloaded value, it must not escape the pool thread
+					record(m_stats.loadFailures);
+				}
+			}
 		}
-		throw std::invalid_argument(key + " does not exist in map");
 	}
 
-	template<class K, class V>
-	V& LruCache<K, V>::operator[](const K& key)
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	template <class KeyLike>
+	void LruCache<K, V, Hash, KeyEqual, Clock>::cancelRefresh(const KeyLike& key)
+	{
+		if (m_refreshing.empty()) {
+			return;
+		}
+		const auto it = m_refreshing.find(key);
+		if (it != m_refreshing.end()) {
+			m_refreshing.erase(it);
+		}
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	template <class KeyLike>
+	bool LruCache<K, V, Hash, KeyEqual, Clock>::hasKey(const KeyLike& key) const
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		const Entry* entry = m_map.find(key);
+		return entry && !isExpired(*entry, Clock::now());
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	template <class KeyLike>
+	V& LruCache<K, V, Hash, KeyEqual, Clock>::get(const KeyLike& key)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		Entry* entry = findLive(key);
+		if (!entry) {
+			throw std::invalid_argument(missingKeyMessage(key));
+		}
+		m_map.moveToEnd(key);
+		return entry->value;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	template <class KeyLike>
+	V& LruCache<K, V, Hash, KeyEqual, Clock>::operator[](const KeyLike& key)
 	{
 		return get(key);
 	}
 
-	template<class K, class V>
-	void LruCache<K, V>::push(const K& key, const V& value)
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	template <class KeyLike>
+	std::optional<V> LruCache<K, V, Hash, KeyEqual, Clock>::getIfPresent(const KeyLike& key)
 	{
-		if (hasKey(key)) {
-			m_map[key] = value;
-			m_map.moveToEnd(key);
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		Entry* entry = findLive(key);
+		if (!entry) {
+			return std::nullopt;
+		}
+		m_map.moveToEnd(key);
+		return entry->value;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	template <class Loader>
+	V LruCache<K, V, Hash, KeyEqual, Clock>::getOrLoad(const K& key, Loader&& loader)
+	{
+		std::promise<V> promise;
+		std::shared_future<V> loading;
+		{
+			std::lock_guard<std::recursive_mutex> lock(m_mutex);
+			if (Entry* entry = findLive(key)) {
+				m_map.moveToEnd(key);
+				return entry->value;
+			}
+			const auto loadingIt = m_loading.find(key);
+			if (loadingIt != m_loading.cend()) {
+				loading = loadingIt->second;
+			}
+			else {
+				m_loading.emplace(key, promise.get_future().share());
+			}
+		}
+		if (loading.valid()) {
+			return loading.get();
+		}
+		// the loader runs without the lock so other keys are not blocked behind a slow load
+		const auto loadStart = std::chrono::steady_clock::now();
+		const auto recordLoadTime = [this, &loadStart]() {
+			record(m_stats.totalLoadNanos, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - loadStart).count());
+		};
+		try {
+			V value = loader(key);
+			recordLoadTime();
+			record(m_stats.loadSuccesses);
+			{
+				std::lock_guard<std::recursive_mutex> lock(m_mutex);
+				push(key, value);
+				m_loading.erase(key);
+			}
+			promise.set_value(value);
+			return value;
+		}
+		catch (...) {
+			recordLoadTime();
+			record(m_stats.loadFailures);
+			{
+				std::lock_guard<std::recursive_mutex> lock(m_mutex);
+				m_loading.erase(key);
+			}
+			promise.set_exception(std::current_exception());
+			throw;
+		}
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	void LruCache<K, V, Hash, KeyEqual, Clock>::push(const K& key, const V& value)
+	{
+		pushEntry(key, value, m_defaultTtl);
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	void LruCache<K, V, Hash, KeyEqual, Clock>::push(K&& key, V&& value)
+	{
+		pushEntry(std::move(key), std::move(value), m_defaultTtl);
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	void LruCache<K, V, Hash, KeyEqual, Clock>::push(const K& key, const V& value, const Duration ttl)
+	{
+		pushEntry(key, value, ttl);
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	void LruCache<K, V, Hash, KeyEqual, Clock>::push(K&& key, V&& value, const Duration ttl)
+	{
+		pushEntry(std::move(key), std::move(value), ttl);
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	template <class KeyArg, class ValueArg>
+	void LruCache<K, V, Hash, KeyEqual, Clock>::pushEntry(KeyArg&& key, ValueArg&& value, const Duration ttl)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		removeExpired();
+		cancelRefresh(key);
+		const size_t weight = m_weigher(key, value);
+		if (Entry* existing = m_map.find(key)) {
+			releaseEntry(*existing);
+			m_map.erase(key);
+		}
+		// an entry heavier than the whole budget would flush every other entry and still not fit
+		if (weight > m_capacity) {
 			return;
 		}
-		m_map.insertAtTail(key, value);
-		if (size() > m_capacity) {
-			m_map.remove(true);
+		TimePoint expiry;
+		std::optional<TimerHandle> timer;
+		if (ttl > Duration::zero()) {
+			expiry = Clock::now() + ttl;
+			timer = m_timerWheel.schedule(key, toTick(std::chrono::ceil<std::chrono::milliseconds>(expiry)));
+		}
+		m_map.tryEmplaceAtTail(std::forward<KeyArg>(key), Entry{ std::forward<ValueArg>(value), weight, expiry, ttl, timer });
+		m_weight += weight;
+		record(m_stats.inserts);
+		evictUntilWithinCapacity();
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	template <class KeyLike>
+	std::optional<V> LruCache<K, V, Hash, KeyEqual, Clock>::remove(const KeyLike& key)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		cancelRefresh(key);
+		Entry* entry = m_map.find(key);
+		if (!entry) {
+			return std::nullopt;
+		}
+		const bool wasExpired = isExpired(*entry, Clock::now());
+		releaseEntry(*entry);
+		Entry removed = m_map.remove(key);
+		if (wasExpired) {
+			return std::nullopt;
 		}
+		return std::move(removed.value);
 	}
 
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	size_t LruCache<K, V, Hash, KeyEqual, Clock>::removeExpired()
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		return m_timerWheel.advance(toTick(Clock::now()), [this](const K& key) {
+			Entry entry = m_map.remove(key);
+			m_weight -= entry.weight;
+			K expiredKey(key);
+			evict(std::move(expiredKey), std::move(entry), EvictionCause::Expired);
+		});
+	}
 
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	void LruCache<K, V, Hash, KeyEqual, Clock>::releaseEntry(const Entry& entry)
+	{
+		m_weight -= entry.weight;
+		if (entry.timer) {
+			m_timerWheel.cancel(*entry.timer);
+		}
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	void LruCache<K, V, Hash, KeyEqual, Clock>::evictUntilWithinCapacity()
+	{
+		while (m_weight > m_capacity && !m_map.empty()) {
+			auto [key, entry] = m_map.remove(true);
+			releaseEntry(entry);
+			evict(std::move(key), std::move(entry), EvictionCause::Capacity);
+		}
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	void LruCache<K, V, Hash, KeyEqual, Clock>::evict(K&& key, Entry&& entry, const EvictionCause cause)
+	{
+		// a reload still running must not bring back what the listener is handed now
+		cancelRefresh(key);
+		record(cause == EvictionCause::Capacity ? m_stats.evictions : m_stats.expirations);
+		record(m_stats.evictedWeight, entry.weight);
+		if (m_evictionListener) {
+			m_evictionListener(key, std::move(entry.value), cause);
+		}
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	void LruCache<K, V, Hash, KeyEqual, Clock>::record(std::atomic<uint64_t>& counter, const uint64_t amount)
+	{
+		if (m_isRecordingStats.load(std::memory_order_relaxed)) {
+			counter.fetch_add(amount, std::memory_order_relaxed);
+		}
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	void LruCache<K, V, Hash, KeyEqual, Clock>::setEvictionListener(EvictionListener listener)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		m_evictionListener = std::move(listener);
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	void LruCache<K, V, Hash, KeyEqual, Clock>::setRefreshAhead(RefreshLoader loader, const double refreshFraction, std::shared_ptr<ThreadPool> pool)
+	{
+		if (!(refreshFraction > 0 && refreshFraction < 1)) {
+			throw std::invalid_argument("Refresh fraction must be between 0 and 1");
+		}
+		if (!pool) {
+			throw std::invalid_argument("Refresh ahead needs a thread pool");
+		}
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		m_refreshLoader = std::move(loader);
+		m_refreshFraction = refreshFraction;
+		m_refreshPool = std::move(pool);
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	void LruCache<K, V, Hash, KeyEqual, Clock>::recordStats(const bool isRecording)
+	{
+		m_isRecordingStats.store(isRecording, std::memory_order_relaxed);
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Clock>
+	CacheStats LruCache<K, V, Hash, KeyEqual, Clock>::stats() const
+	{
+		return CacheStats{
+			m_stats.hits.load(std::memory_order_relaxed),
+			m_stats.misses.load(std::memory_order_relaxed),
+			m_stats.inserts.load(std::memory_order_relaxed),
+			m_stats.evictions.load(std::memory_order_relaxed),
+			m_stats.expirations.load(std::memory_order_relaxed),
+			m_stats.evictedWeight.load(std::memory_order_relaxed),
+			m_stats.loadSuccesses.load(std::memory_order_relaxed),
+			m_stats.loadFailures.load(std::memory_order_relaxed),
+			m_stats.refreshes.load(std::memory_order_relaxed),
+			std::chrono::nanoseconds(m_stats.totalLoadNanos.load(std::memory_order_relaxed)),
+			size(),
+			weight()
+		};
+	}
 }
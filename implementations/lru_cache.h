@@ -1,23 +1,171 @@
 #pragma once
 
 #include "linked_unordered_map.h"
+#include "thread_pool.h"
+#include "timer_wheel.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 
 namespace implementations {
-	template <class K, class V>
+	// snapshot of the counters of an LruCache that records stats
+	struct CacheStats {
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t inserts;
+		uint64_t evictions;
+		uint64_t expirations;
+		uint64_t evictedWeight;
+		uint64_t loadSuccesses;
+		uint64_t loadFailures;
+		uint64_t refreshes;
+		std::chrono::nanoseconds totalLoadTime;
+		size_t size;
+		size_t weight;
+
+		double hitRatio() const noexcept;
+		std::chrono::nanoseconds averageLoadTime() const noexcept;
+	};
+
+	enum class EvictionCause {
+		Capacity,
+		Expired
+	};
+
+	/*
+	* LRU cache implemented on top of the LinkedUnorderedMap
+	* capacity is a weight budget: by default every entry weighs 1 so capacity is the number of entries,
+	* a custom weigher (eg value size in bytes) lets the cache be sized to a memory budget
+	* least recently used entries are evicted from the head of the map until the total weight fits the budget
+	* entries can expire after a per entry or default time to live (zero means never expire),
+	* expiry is checked lazily on lookup and expired entries are reclaimed through a timer wheel with millisecond ticks
+	* getOrLoad coalesces concurrent misses for the same key into a single call to the loader
+	* lookups are heterogeneous when Hash and KeyEqual are transparent, as in LinkedUnorderedMap
+	* stats are opt in and kept in relaxed atomics so they can be read without taking the cache lock
+	* the eviction listener receives ownership of every evicted or expired value, it runs under the cache lock
+	* with refresh ahead, a hit on an entry past a fraction of its time to live reloads it on a thread pool
+	* while the current value keeps being served, so hot keys are replaced before they expire instead of every reader
+	* waiting on a reload; a push or remove of the key while the reload runs wins over the reloaded value
+	*/
+	template <class K, class V, class Hash = std::hash<K>, class KeyEqual = std::equal_to<K>, class Clock = std::chrono::steady_clock>
 	class LruCache
 	{
-		LinkedUnorderedMap<K, V> m_map;
+	public:
+		using Weigher = std::function<size_t(const K&, const V&)>;
+		using Duration = typename Clock::duration;
+		using TimePoint = typename Clock::time_point;
+		using EvictionListener = std::function<void(const K&, V&&, const EvictionCause)>;
+		using RefreshLoader = std::function<V(const K&)>;
+	private:
+		using TimerHandle = typename TimerWheel<K>::Handle;
+
+		struct Entry {
+			V value;
+			size_t weight;
+			TimePoint expiry;
+			Duration ttl;
+			std::optional<TimerHandle> timer;
+		};
+
+		struct StatsCounters {
+			std::atomic<uint64_t> hits{ 0 };
+			std::atomic<uint64_t> misses{ 0 };
+			std::atomic<uint64_t> inserts{ 0 };
+			std::atomic<uint64_t> evictions{ 0 };
+			std::atomic<uint64_t> expirations{ 0 };
+			std::atomic<uint64_t> evictedWeight{ 0 };
+			std::atomic<uint64_t> loadSuccesses{ 0 };
+			std::atomic<uint64_t> loadFailures{ 0 };
+			std::atomic<uint64_t> refreshes{ 0 };
+			std::atomic<uint64_t> totalLoadNanos{ 0 };
+		};
+
+		// synchronised by m_mutex, so the map itself takes no lock
+		LinkedUnorderedMap<K, Entry, Hash, KeyEqual, SingleThreaded> m_map;
 		size_t m_capacity;
+		size_t m_weight;
+		Weigher m_weigher;
+		Duration m_defaultTtl;
+		TimerWheel<K> m_timerWheel;
+		// loads in flight, waiters for the same key share the future instead of calling the loader again
+		std::unordered_map<K, std::shared_future<V>, Hash, KeyEqual> m_loading;
+		mutable std::recursive_mutex m_mutex;
+		EvictionListener m_evictionListener;
+		std::atomic<bool> m_isRecordingStats;
+		StatsCounters m_stats;
+		RefreshLoader m_refreshLoader;
+		double m_refreshFraction;
+		std::shared_ptr<ThreadPool> m_refreshPool;
+		// reloads in flight by ticket, a push, remove or eviction of the key drops the ticket so the reloaded value is discarded
+		std::unordered_map<K, uint64_t, Hash, KeyEqual> m_refreshing;
+		uint64_t m_nextRefreshTicket;
+		// reloads queued or running, the destructor waits for them since they refer back to the cache
+		size_t m_numPendingRefreshes;
+		std::condition_variable_any m_refreshesDone;
+
+		static uint64_t toTick(const TimePoint& time);
+		static bool isExpired(const Entry& entry, const TimePoint& now);
+		// lazily drops the entry if it has expired
+		template <class KeyLike>
+		Entry* findLive(const KeyLike& key);
+		template <class KeyLike>
+		void refreshIfDue(const KeyLike& key, const Entry& entry);
+		void refresh(const K& key, const uint64_t ticket, const Duration ttl, const RefreshLoader& loader);
+		template <class KeyLike>
+		void cancelRefresh(const KeyLike& key);
+		void releaseEntry(const Entry& entry);
+		void evict(K&& key, Entry&& entry, const EvictionCause cause);
+		void record(std::atomic<uint64_t>& counter, const uint64_t amount = 1);
+		template <class KeyArg, class ValueArg>
+		void pushEntry(KeyArg&& key, ValueArg&& value, const Duration ttl);
+		void evictUntilWithinCapacity();
 	public:
 		LruCache(const size_t capacity);
+		LruCache(const size_t capacity, Weigher weigher);
+		LruCache(const size_t capacity, const Duration defaultTtl);
+		LruCache(const size_t capacity, Weigher weigher, const Duration defaultTtl);
+		LruCache(const LruCache&) = delete;
+		LruCache& operator=(const LruCache&) = delete;
+		~LruCache();
 
 		size_t size() const;
+		size_t weight() const;
+		size_t capacity() const;
+		Duration defaultTtl() const;
 		bool empty() const;
-		bool hasKey(const K& key) const;
-		V& get(const K& key);
-		V& operator[](const K& key);
+		template <class KeyLike>
+		bool hasKey(const KeyLike& key) const;
+		template <class KeyLike>
+		V& get(const KeyLike& key);
+		template <class KeyLike>
+		V& operator[](const KeyLike& key);
+		template <class KeyLike>
+		std::optional<V> getIfPresent(const KeyLike& key);
+		template <class Loader>
+		V getOrLoad(const K& key, Loader&& loader);
 
 		void push(const K& key, const V& value);
+		void push(K&& key, V&& value);
+		void push(const K& key, const V& value, const Duration ttl);
+		void push(K&& key, V&& value, const Duration ttl);
+		// drops the entry without notifying the eviction listener, returns its value unless it had expired
+		template <class KeyLike>
+		std::optional<V> remove(const KeyLike& key);
+		size_t removeExpired();
+
+		void setEvictionListener(EvictionListener listener);
+		// refreshFraction is the part of an entry's time to live after which a hit schedules a reload, in (0, 1)
+		// a refresh replaces the entry from a pool thread, so read refreshed caches through getIfPresent rather than keeping the reference get returns
+		void setRefreshAhead(RefreshLoader loader, const double refreshFraction, std::shared_ptr<ThreadPool> pool);
+		void recordStats(const bool isRecording = true);
+		CacheStats stats() const;
 	};
 }
-
@@ -0,0 +1,160 @@
+#include "lz_codec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace implementations {
+	inline uint32_t LzCodec::read32(const char* data) {
+		uint32_t value;
+		std::memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	inline uint32_t LzCodec::hashOf(const uint32_t sequence) {
+		return (sequence * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	inline void LzCodec::writeVarint(std::string& output, uint64_t value) {
+		while (value >= 0x80) {
+			output.push_back(static_cast<char>((value & 0x7f) | 0x80));
+			value >>= 7;
+		}
+		output.push_back(static_cast<char>(value));
+	}
+
+	inline uint64_t LzCodec::readVarint(std::string_view input, size_t& pos) {
+		uint64_t value = 0;
+		for (size_t shift = 0; shift < 64; shift += 7) {
+			if (pos >= input.size()) {
+				throw std::runtime_error("Truncated length in compressed data");
+			}
+			const uint8_t byte = static_cast<uint8_t>(input[pos++]);
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) {
+				return value;
+			}
+		}
+		throw std::runtime_error("Malformed length in compressed data");
+	}
+
+	inline void LzCodec::writeLength(std::string& output, size_t length) {
+		while (length >= UINT8_MAX) {
+			output.push_back(static_cast<char>(UINT8_MAX));
+			length -= UINT8_MAX;
+		}
+		output.push_back(static_cast<char>(length));
+	}
+
+	inline size_t LzCodec::readLength(std::string_view input, size_t& pos) {
+		size_t length = 0;
+		uint8_t byte;
+		do {
+			if (pos >= input.size()) {
+				throw std::runtime_error("Truncated sequence in compressed data");
+			}
+			byte = static_cast<uint8_t>(input[pos++]);
+			length += byte;
+		} while (byte == UINT8_MAX);
+		return length;
+	}
+
+	inline void LzCodec::writeSequence(std::string& output, std::string_view literals, const size_t offset, const size_t matchLength) {
+		const size_t extraMatch = matchLength == 0 ? 0 : matchLength - MIN_MATCH;
+		const uint8_t literalNibble = static_cast<uint8_t>(std::min<size_t>(literals.size(), NIBBLE_MAX));
+		const uint8_t matchNibble = static_cast<uint8_t>(std::min<size_t>(extraMatch, NIBBLE_MAX));
+		output.push_back(static_cast<char>((literalNibble << 4) | matchNibble));
+		if (literalNibble == NIBBLE_MAX) {
+			writeLength(output, literals.size() - NIBBLE_MAX);
+		}
+		output.append(literals);
+		if (matchLength == 0) {
+			return;
+		}
+		output.push_back(static_cast<char>(offset & 0xff));
+		output.push_back(static_cast<char>(offset >> 8));
+		if (matchNibble == NIBBLE_MAX) {
+			writeLength(output, extraMatch - NIBBLE_MAX);
+		}
+	}
+
+	inline std::string LzCodec::compress(std::string_view input) {
+		std::string output;
+		output.reserve(input.size() / 2 + 16);
+		writeVarint(output, input.size());
+		// positions are stored plus one so zero marks an empty slot
+		std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+		size_t anchor = 0;
+		size_t pos = 0;
+		while (pos + MIN_MATCH <= input.size()) {
+			const uint32_t sequence = read32(input.data() + pos);
+			uint32_t& slot = table[hashOf(sequence)];
+			const size_t candidate = slot;
+			slot = static_cast<uint32_t>(pos + 1);
+			if (candidate == 0 || pos + 1 - candidate > MAX_OFFSET || read32(input.data() + candidate - 1) != sequence) {
+				pos++;
+				continue;
+			}
+			const size_t matchStart = candidate - 1;
+			size_t matchLength = MIN_MATCH;
+			while (pos + matchLength < input.size() && input[matchStart + matchLength] == input[pos + matchLength]) {
+				matchLength++;
+			}
+			writeSequence(output, input.substr(anchor, pos - anchor), pos - matchStart, matchLength);
+			pos += matchLength;
+			anchor = pos;
+		}
+		writeSequence(output, input.substr(anchor), 0, 0);
+		return output;
+	}
+
+	inline std::string LzCodec::decompress(std::string_view compressed) {
+		size_t pos = 0;
+		const uint64_t originalSize = readVarint(compressed, pos);
+		if (originalSize > compressed.size() * (UINT8_MAX + MIN_MATCH + NIBBLE_MAX)) {
+			throw std::runtime_error("Implausible length in compressed data");
+		}
+		std::string output;
+		output.reserve(originalSize);
+		while (pos < compressed.size()) {
+			const uint8_t token = static_cast<uint8_t>(compressed[pos++]);
+			size_t literalLength = token >> 4;
+			if (literalLength == NIBBLE_MAX) {
+				literalLength += readLength(compressed, pos);
+			}
+			if (literalLength > compressed.size() - pos) {
+				throw std::runtime_error("Truncated literals in compressed data");
+			}
+			output.append(compressed.substr(pos, literalLength));
+			pos += literalLength;
+			if (pos == compressed.size()) {
+				break;
+			}
+			if (compressed.size() - pos < 2) {
+				throw std::runtime_error("Truncated offset in compressed data");
+			}
+			const size_t offset = static_cast<uint8_t>(compressed[pos]) | (static_cast<size_t>(static_cast<uint8_t>(compressed[pos + 1])) << 8);
+			pos += 2;
+			if (offset == 0 || offset > output.size()) {
+				throw std::runtime_error("Invalid offset in compressed data");
+			}
+			size_t matchLength = (token & NIBBLE_MAX) + MIN_MATCH;
+			if ((token & NIBBLE_MAX) == NIBBLE_MAX) {
+				matchLength += readLength(compressed, pos);
+			}
+			if (matchLength > originalSize - std::min<size_t>(originalSize, output.size())) {
+				throw std::runtime_error("Match overruns the original length in compressed data");
+			}
+			// copied byte by byte because a match may overlap the bytes it produces
+			size_t from = output.size() - offset;
+			for (size_t i = 0; i < matchLength; i++) {
+				output.push_back(output[from++]);
+			}
+		}
+		if (output.size() != originalSize) {
+			throw std::runtime_error("Compressed data does not match its original length");
+		}
+		return output;
+	}
+}
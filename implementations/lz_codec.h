@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace implementations {
+	/*
+	* byte oriented LZ77 codec in the spirit of LZ4, fast rather than tight, with no dependency on a compression library
+	* the output starts with the original length as a varint followed by sequences of
+	* a token (literal length in the high nibble, match length minus 4 in the low nibble, 15 meaning extra length bytes follow),
+	* any extra literal length bytes, the literals, a 2 byte little endian match offset and any extra match length bytes
+	* the last sequence stops after its literals
+	* matches are found in a single greedy pass through a hash table of 4 byte prefixes
+	*/
+	class LzCodec
+	{
+		static constexpr size_t MIN_MATCH = 4;
+		static constexpr size_t MAX_OFFSET = UINT16_MAX;
+		static constexpr size_t HASH_BITS = 12;
+		static constexpr uint8_t NIBBLE_MAX = 15;
+
+		static uint32_t read32(const char* data);
+		static uint32_t hashOf(const uint32_t sequence);
+		static void writeVarint(std::string& output, uint64_t value);
+		static uint64_t readVarint(std::string_view input, size_t& pos);
+		static void writeLength(std::string& output, size_t length);
+		static size_t readLength(std::string_view input, size_t& pos);
+		static void writeSequence(std::string& output, std::string_view literals, const size_t offset, const size_t matchLength);
+	public:
+		static std::string compress(std::string_view input);
+		// throws std::runtime_error if the input is not the output of compress
+		static std::string decompress(std::string_view compressed);
+	};
+}
@@ -0,0 +1,140 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace implementations {
+#ifdef _WIN32
+	inline MappedFile::MappedFile(const std::string& path, const size_t size)
+		: m_data(nullptr), m_size(size), m_isReadOnly(false), m_fileHandle(nullptr), m_mappingHandle(nullptr) {
+		m_fileHandle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (m_fileHandle == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("Cannot open " + path);
+		}
+		LARGE_INTEGER currentSize;
+		LARGE_INTEGER requestedSize;
+		requestedSize.QuadPart = static_cast<LONGLONG>(size);
+		if (!GetFileSizeEx(m_fileHandle, &currentSize)
+			|| (currentSize.QuadPart != requestedSize.QuadPart
+				&& (!SetFilePointerEx(m_fileHandle, requestedSize, nullptr, FILE_BEGIN) || !SetEndOfFile(m_fileHandle)))) {
+			CloseHandle(m_fileHandle);
+			throw std::runtime_error("Cannot resize " + path);
+		}
+		m_mappingHandle = CreateFileMappingA(m_fileHandle, nullptr, PAGE_READWRITE, requestedSize.HighPart, requestedSize.LowPart, nullptr);
+		m_data = m_mappingHandle ? MapViewOfFile(m_mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, size) : nullptr;
+		if (!m_data) {
+			if (m_mappingHandle) {
+				CloseHandle(m_mappingHandle);
+			}
+			CloseHandle(m_fileHandle);
+			throw std::runtime_error("Cannot map " + path);
+		}
+	}
+
+	inline MappedFile::MappedFile(const std::string& path)
+		: m_data(nullptr), m_size(0), m_isReadOnly(true), m_fileHandle(nullptr), m_mappingHandle(nullptr) {
+		m_fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (m_fileHandle == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("Cannot open " + path);
+		}
+		LARGE_INTEGER currentSize;
+		if (!GetFileSizeEx(m_fileHandle, &currentSize) || currentSize.QuadPart == 0) {
+			CloseHandle(m_fileHandle);
+			throw std::runtime_error("Cannot map empty " + path);
+		}
+		m_size = static_cast<size_t>(currentSize.QuadPart);
+		m_mappingHandle = CreateFileMappingA(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		m_data = m_mappingHandle ? MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, m_size) : nullptr;
+		if (!m_data) {
+			if (m_mappingHandle) {
+				CloseHandle(m_mappingHandle);
+			}
+			CloseHandle(m_fileHandle);
+			throw std::runtime_error("Cannot map " + path);
+		}
+	}
+
+	inline MappedFile::~MappedFile() {
+		UnmapViewOfFile(m_data);
+		CloseHandle(m_mappingHandle);
+		CloseHandle(m_fileHandle);
+	}
+
+	inline void MappedFile::flush() const {
+		if (m_isReadOnly) {
+			return;
+		}
+		FlushViewOfFile(m_data, m_size);
+		FlushFileBuffers(m_fileHandle);
+	}
+#else
+	inline MappedFile::MappedFile(const std::string& path, const size_t size)
+		: m_data(nullptr), m_size(size), m_isReadOnly(false), m_fd(::open(path.c_str(), O_RDWR | O_CREAT, 0644)) {
+		if (m_fd < 0) {
+			throw std::runtime_error("Cannot open " + path);
+		}
+		struct stat fileStat;
+		if (fstat(m_fd, &fileStat) != 0
+			|| (static_cast<size_t>(fileStat.st_size) != size && ftruncate(m_fd, static_cast<off_t>(size)) != 0)) {
+			::close(m_fd);
+			throw std::runtime_error("Cannot resize " + path);
+		}
+		m_data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+		if (m_data == MAP_FAILED) {
+			::close(m_fd);
+			throw std::runtime_error("Cannot map " + path);
+		}
+	}
+
+	inline MappedFile::MappedFile(const std::string& path)
+		: m_data(nullptr), m_size(0), m_isReadOnly(true), m_fd(::open(path.c_str(), O_RDONLY)) {
+		if (m_fd < 0) {
+			throw std::runtime_error("Cannot open " + path);
+		}
+		struct stat fileStat;
+		if (fstat(m_fd, &fileStat) != 0 || fileStat.st_size == 0) {
+			::close(m_fd);
+			throw std::runtime_error("Cannot map empty " + path);
+		}
+		m_size = static_cast<size_t>(fileStat.st_size);
+		m_data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+		if (m_data == MAP_FAILED) {
+			::close(m_fd);
+			throw std::runtime_error("Cannot map " + path);
+		}
+	}
+
+	inline MappedFile::~MappedFile() {
+		munmap(m_data, m_size);
+		::close(m_fd);
+	}
+
+	inline void MappedFile::flush() const {
+		if (m_isReadOnly) {
+			return;
+		}
+		msync(m_data, m_size, MS_SYNC);
+	}
+#endif
+
+	inline std::byte* MappedFile::data() const noexcept {
+		return static_cast<std::byte*>(m_data);
+	}
+
+	inline size_t MappedFile::size() const noexcept {
+		return m_size;
+	}
+
+	inline bool MappedFile::isReadOnly() const noexcept {
+		return m_isReadOnly;
+	}
+}
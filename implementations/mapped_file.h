@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace implementations {
+	/*
+	* shared mapping of a whole file
+	* read/write: the file is created or resized to the requested size
+	* read only: an existing file is mapped at its current size, writing through data() faults
+	*/
+	class MappedFile
+	{
+		void* m_data;
+		size_t m_size;
+		bool m_isReadOnly;
+#ifdef _WIN32
+		void* m_fileHandle;
+		void* m_mappingHandle;
+#else
+		int m_fd;
+#endif
+	public:
+		MappedFile(const std::string& path, const size_t size);
+		explicit MappedFile(const std::string& path);
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		std::byte* data() const noexcept;
+		size_t size() const noexcept;
+		bool isReadOnly() const noexcept;
+		void flush() const;
+	};
+}
@@ -0,0 +1,61 @@
+#include "mpsc_queue.h"
+
+#include <cstddef>
+#include <utility>
+
+namespace implementations {
+	template <class T>
+	MpscQueue<T>::MpscQueue()
+		: m_head(nullptr) {}
+
+	template <class T>
+	MpscQueue<T>::~MpscQueue() {
+		Node* node = m_head.load(std::memory_order_acquire);
+		while (node) {
+			Node* next = node->next;
+			delete node;
+			node = next;
+		}
+	}
+
+	template <class T>
+	bool MpscQueue<T>::push(T value) {
+		Node* head = m_head.load(std::memory_order_relaxed);
+		Node* node = new Node{ std::move(value), head };
+		// nodes are never popped one by one, so a head that was swapped out and back in cannot be mistaken for the old one
+		while (!m_head.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed)) {
+			node->next = head;
+		}
+		// the consumer may own node already, only the old head read here is safe to look at
+		return !head;
+	}
+
+	template <class T>
+	std::vector<T> MpscQueue<T>::popAll() {
+		Node* node = m_head.exchange(nullptr, std::memory_order_acquire);
+		// newest first, so the list is reversed before it is moved out
+		Node* oldest = nullptr;
+		size_t numNodes = 0;
+		while (node) {
+			Node* next = node->next;
+			node->next = oldest;
+			oldest = node;
+			node = next;
+			numNodes++;
+		}
+		std::vector<T> values;
+		values.reserve(numNodes);
+		while (oldest) {
+			Node* next = oldest->next;
+			values.push_back(std::move(oldest->value));
+			delete oldest;
+			oldest = next;
+		}
+		return values;
+	}
+
+	template <class T>
+	bool MpscQueue<T>::isEmpty() const noexcept {
+		return !m_head.load(std::memory_order_acquire);
+	}
+}
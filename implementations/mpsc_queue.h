@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+namespace implementations {
+	/*
+	* unbounded multi producer single consumer queue, lock free on both sides
+	* producers push onto an intrusive list with one compare and swap, the consumer takes everything queued in one exchange
+	* and reverses it into push order, so it pays per batch rather than per item and a burst arrives as one batch
+	* only one thread may pop at a time, any number may push
+	*/
+	template <class T>
+	class MpscQueue
+	{
+		struct Node {
+			T value;
+			Node* next;
+		};
+
+		// newest first
+		std::atomic<Node*> m_head;
+	public:
+		MpscQueue();
+		MpscQueue(const MpscQueue&) = delete;
+		MpscQueue& operator=(const MpscQueue&) = delete;
+		~MpscQueue();
+
+		// true if the queue was empty, so a consumer waiting for work needs waking
+		bool push(T value);
+		// everything pushed so far, oldest first
+		std::vector<T> popAll();
+		bool isEmpty() const noexcept;
+	};
+}
@@ -0,0 +1,174 @@
+#include "name_index.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace implementations {
+	template <class K, class V, class Hash>
+	NameIndex<K, V, Hash>::NameIndex()
+		: m_entriesByName()
+		, m_namesByTrigram()
+		, m_size(0) {}
+
+	template <class K, class V, class Hash>
+	uint32_t NameIndex<K, V, Hash>::trigramAt(std::string_view text, const size_t pos) noexcept {
+		return static_cast<uint32_t>(static_cast<unsigned char>(text[pos])) << 16
+			| static_cast<uint32_t>(static_cast<unsigned char>(text[pos + 1])) << 8
+			| static_cast<uint32_t>(static_cast<unsigned char>(text[pos + 2]));
+	}
+
+	template <class K, class V, class Hash>
+	std::vector<std::string_view> NameIndex<K, V, Hash>::literalsOf(std::string_view pattern) {
+		std::vector<std::string_view> literals;
+		size_t start = 0;
+		while (start < pattern.size()) {
+			const size_t end = std::min(pattern.find_first_of("*?", start), pattern.size());
+			if (end > start) {
+				literals.push_back(pattern.substr(start, end - start));
+			}
+			start = end + 1;
+		}
+		return literals;
+	}
+
+	template <class K, class V, class Hash>
+	size_t NameIndex<K, V, Hash>::size() const noexcept {
+		return m_size;
+	}
+
+	template <class K, class V, class Hash>
+	size_t NameIndex<K, V, Hash>::numNames() const noexcept {
+		return m_entriesByName.size();
+	}
+
+	template <class K, class V, class Hash>
+	bool NameIndex<K, V, Hash>::insert(std::string_view name, const K& key, const V& value) {
+		auto nameIt = m_entriesByName.find(name);
+		if (nameIt == m_entriesByName.end()) {
+			nameIt = m_entriesByName.emplace(std::string(name), Entries()).first;
+			for (size_t pos = 0; pos + 3 <= name.size(); pos++) {
+				m_namesByTrigram[trigramAt(name, pos)].insert(&nameIt->first);
+			}
+		}
+		// a key can come back for a new entry, eg an address reused by an allocator, so it takes the new value
+		if (!nameIt->second.insert_or_assign(key, value).second) {
+			return false;
+		}
+		m_size++;
+		return true;
+	}
+
+	template <class K, class V, class Hash>
+	bool NameIndex<K, V, Hash>::erase(std::string_view name, const K& key) {
+		const auto nameIt = m_entriesByName.find(name);
+		if (nameIt == m_entriesByName.end() || nameIt->second.erase(key) == 0) {
+			return false;
+		}
+		m_size--;
+		if (nameIt->second.empty()) {
+			for (size_t pos = 0; pos + 3 <= name.size(); pos++) {
+				const auto trigramIt = m_namesByTrigram.find(trigramAt(name, pos));
+				trigramIt->second.erase(&nameIt->first);
+				if (trigramIt->second.empty()) {
+					m_namesByTrigram.erase(trigramIt);
+				}
+			}
+			m_entriesByName.erase(nameIt);
+		}
+		return true;
+	}
+
+	template <class K, class V, class Hash>
+	template <class Visitor>
+	void NameIndex<K, V, Hash>::forEachNamed(std::string_view name, Visitor&& visitor) const {
+		const auto nameIt = m_entriesByName.find(name);
+		if (nameIt == m_entriesByName.cend()) {
+			return;
+		}
+		for (const auto& [key, value] : nameIt->second) {
+			visitor(nameIt->first, key, value);
+		}
+	}
+
+	template <class K, class V, class Hash>
+	template <class Matches, class Visitor>
+	void NameIndex<K, V, Hash>::forEachCandidate(const std::vector<std::string_view>& literals, Matches&& matches, Visitor&& visitor) const {
+		const auto visitIfMatches = [&](const std::string& name) {
+			if (!matches(name)) {
+				return;
+			}
+			for (const auto& [key, value] : m_entriesByName.find(name)->second) {
+				visitor(name, key, value);
+			}
+		};
+		// the rarest trigram bounds the candidates, matches checks the rest
+		const std::unordered_set<const std::string*>* rarest = nullptr;
+		for (const std::string_view literal : literals) {
+			for (size_t pos = 0; pos + 3 <= literal.size(); pos++) {
+				const auto trigramIt = m_namesByTrigram.find(trigramAt(literal, pos));
+				if (trigramIt == m_namesByTrigram.cend()) {
+					return;
+				}
+				if (!rarest || trigramIt->second.size() < rarest->size()) {
+					rarest = &trigramIt->second;
+				}
+			}
+		}
+		if (!rarest) {
+			for (const auto& [name, entries] : m_entriesByName) {
+				visitIfMatches(name);
+			}
+			return;
+		}
+		for (const std::string* name : *rarest) {
+			visitIfMatches(*name);
+		}
+	}
+
+	template <class K, class V, class Hash>
+	template <class Visitor>
+	void NameIndex<K, V, Hash>::forEachContaining(std::string_view fragment, Visitor&& visitor) const {
+		forEachCandidate({ fragment },
+			[fragment](const std::string& name) { return name.find(fragment) != std::string::npos; },
+			std::forward<Visitor>(visitor));
+	}
+
+	template <class K, class V, class Hash>
+	template <class Visitor>
+	void NameIndex<K, V, Hash>::forEachMatching(std::string_view pattern, Visitor&& visitor) const {
+		forEachCandidate(literalsOf(pattern),
+			[pattern](const std::string& name) { return globMatches(pattern, name); },
+			std::forward<Visitor>(visitor));
+	}
+
+	template <class K, class V, class Hash>
+	bool NameIndex<K, V, Hash>::globMatches(std::string_view pattern, std::string_view name) noexcept {
+		size_t p = 0;
+		size_t n = 0;
+		// where the last '*' was seen and the name position it was last tried against
+		size_t starPattern = std::string_view::npos;
+		size_t starName = 0;
+		while (n < name.size()) {
+			if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+				p++;
+				n++;
+			}
+			else if (p < pattern.size() && pattern[p] == '*') {
+				starPattern = p++;
+				starName = n;
+			}
+			else if (starPattern != std::string_view::npos) {
+				// let the last '*' swallow one more character and retry
+				p = starPattern + 1;
+				n = ++starName;
+			}
+			else {
+				return false;
+			}
+		}
+		while (p < pattern.size() && pattern[p] == '*') {
+			p++;
+		}
+		return p == pattern.size();
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "linked_unordered_map.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace implementations {
+	/*
+	* inverted index from names to the entries that carry them, eg file name to the files with that name
+	* every indexed name is also filed under each of its trigrams (three consecutive bytes), so a substring or glob query
+	* only checks the names sharing the rarest trigram of its literal parts instead of every name,
+	* queries shorter than a trigram fall back to checking every distinct name
+	* an entry is a key unique among the entries of its name plus a value, visitors are called with (name, key, value)
+	* glob patterns support '*' for any run of characters and '?' for one character
+	* not synchronised, callers lock around it
+	*/
+	template <class K, class V, class Hash = std::hash<K>>
+	class NameIndex
+	{
+		using Entries = std::unordered_map<K, V, Hash>;
+
+		std::unordered_map<std::string, Entries, TransparentStringHash, std::equal_to<>> m_entriesByName;
+		// the names point at keys of m_entriesByName, which stay put until the name's last entry is erased
+		std::unordered_map<uint32_t, std::unordered_set<const std::string*>> m_namesByTrigram;
+		size_t m_size;
+
+		static uint32_t trigramAt(std::string_view text, const size_t pos) noexcept;
+		// literal runs of a glob pattern, the parts between wildcards
+		static std::vector<std::string_view> literalsOf(std::string_view pattern);
+		// calls visitor for every entry whose name contains all literals and passes matches
+		template <class Matches, class Visitor>
+		void forEachCandidate(const std::vector<std::string_view>& literals, Matches&& matches, Visitor&& visitor) const;
+	public:
+		NameIndex();
+
+		// number of entries
+		size_t size() const noexcept;
+		size_t numNames() const noexcept;
+
+		// false if the name already has an entry with this key, its value is replaced then
+		bool insert(std::string_view name, const K& key, const V& value);
+		// false if the name has no entry with this key
+		bool erase(std::string_view name, const K& key);
+
+		template <class Visitor>
+		void forEachNamed(std::string_view name, Visitor&& visitor) const;
+		template <class Visitor>
+		void forEachContaining(std::string_view fragment, Visitor&& visitor) const;
+		template <class Visitor>
+		void forEachMatching(std::string_view pattern, Visitor&& visitor) const;
+
+		static bool globMatches(std::string_view pattern, std::string_view name) noexcept;
+	};
+}
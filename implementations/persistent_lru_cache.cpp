@@ -0,0 +1,286 @@
+#include "persistent_lru_cache.h"
+
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace implementations {
+	template <class K, class V>
+	uint32_t PersistentLruCache<K, V>::bucketCountFor(const uint32_t capacity) {
+		if (capacity == 0 || capacity > (UINT32_MAX >> 1)) {
+			throw std::invalid_argument("Capacity must be between 1 and 2^31");
+		}
+		uint32_t bucketCount = 1;
+		while (bucketCount < capacity) {
+			bucketCount <<= 1;
+		}
+		return bucketCount;
+	}
+
+	template <class K, class V>
+	size_t PersistentLruCache<K, V>::fileSizeFor(const uint32_t capacity) {
+		const size_t bucketsEnd = sizeof(Header) + bucketCountFor(capacity) * sizeof(uint32_t);
+		const size_t nodesOffset = (bucketsEnd + alignof(Node) - 1) / alignof(Node) * alignof(Node);
+		return nodesOffset + capacity * sizeof(Node);
+	}
+
+	template <class K, class V>
+	uint64_t PersistentLruCache<K, V>::hashBytes(const void* data, const size_t length, uint64_t hash) {
+		// FNV-1a over 8 byte words, checksumming a large file a byte at a time would dominate the reopen time
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		size_t remaining = length;
+		for (; remaining >= sizeof(uint64_t); remaining -= sizeof(uint64_t), bytes += sizeof(uint64_t)) {
+			uint64_t word;
+			std::memcpy(&word, bytes, sizeof(uint64_t));
+			hash = (hash ^ word) * 0x100000001b3;
+			hash ^= hash >> 29;
+		}
+		for (; remaining > 0; remaining--, bytes++) {
+			hash = (hash ^ *bytes) * 0x100000001b3;
+		}
+		return hash;
+	}
+
+	template <class K, class V>
+	uint32_t PersistentLruCache<K, V>::layoutChecksum() const {
+		return static_cast<uint32_t>(hashBytes(m_header, offsetof(Header, layoutChecksum), 0xcbf29ce484222325));
+	}
+
+	template <class K, class V>
+	uint32_t PersistentLruCache<K, V>::checksumOf(const Node& node) {
+		return static_cast<uint32_t>(hashBytes(&node.value, sizeof(V), hashBytes(&node.key, sizeof(K), 0xcbf29ce484222325)));
+	}
+
+	template <class K, class V>
+	bool PersistentLruCache<K, V>::hasValidLayout() const {
+		return m_header->magic == MAGIC
+			&& m_header->version == VERSION
+			&& m_header->keySize == sizeof(K)
+			&& m_header->valueSize == sizeof(V)
+			&& m_header->capacity == m_capacity
+			&& m_header->bucketCount == m_bucketCount
+			&& m_header->layoutChecksum == layoutChecksum();
+	}
+
+	template <class K, class V>
+	void PersistentLruCache<K, V>::reset() {
+		*m_header = Header{ MAGIC, VERSION, sizeof(K), sizeof(V), m_capacity, m_bucketCount, 0, NIL, NIL, 0, 0 };
+		m_header->layoutChecksum = layoutChecksum();
+		for (uint32_t bucket = 0; bucket < m_bucketCount; bucket++) {
+			m_buckets[bucket] = NIL;
+		}
+		for (uint32_t index = 0; index < m_capacity; index++) {
+			m_nodes[index].prev = NIL;
+			m_nodes[index].next = index + 1 < m_capacity ? index + 1 : NIL;
+			m_nodes[index].hashNext = NIL;
+		}
+	}
+
+	template <class K, class V>
+	void PersistentLruCache<K, V>::recover() {
+		for (uint32_t bucket = 0; bucket < m_bucketCount; bucket++) {
+			m_buckets[bucket] = NIL;
+		}
+		// only next links are followed, and each node at most once, so a torn or looping list still ends
+		std::vector<bool> isSeen(m_capacity, false);
+		std::vector<bool> isKept(m_capacity, false);
+		uint32_t index = m_header->head;
+		m_header->head = NIL;
+		m_header->tail = NIL;
+		m_header->size = 0;
+		while (index < m_capacity && !isSeen[index]) {
+			isSeen[index] = true;
+			const uint32_t next = m_nodes[index].next;
+			if (m_nodes[index].checksum == checksumOf(m_nodes[index])) {
+				// the list runs oldest to newest, so a key listed twice keeps its later entry
+				const uint32_t older = findNode(m_nodes[index].key);
+				if (older != NIL) {
+					unlinkFromBucket(older);
+					unlinkFromList(older);
+					isKept[older] = false;
+					m_header->size--;
+				}
+				appendToList(index);
+				linkIntoBucket(index);
+				isKept[index] = true;
+				m_header->size++;
+			}
+			index = next;
+		}
+		m_header->freeHead = NIL;
+		for (uint32_t freeIndex = m_capacity; freeIndex-- > 0;) {
+			if (!isKept[freeIndex]) {
+				m_nodes[freeIndex].prev = NIL;
+				m_nodes[freeIndex].hashNext = NIL;
+				m_nodes[freeIndex].next = m_header->freeHead;
+				m_header->freeHead = freeIndex;
+			}
+		}
+	}
+
+	template <class K, class V>
+	uint32_t PersistentLruCache<K, V>::bucketOf(const K& key) const {
+		return static_cast<uint32_t>(hashBytes(&key, sizeof(K), 0xcbf29ce484222325) & (m_bucketCount - 1));
+	}
+
+	template <class K, class V>
+	uint32_t PersistentLruCache<K, V>::findNode(const K& key) const {
+		uint32_t index = m_buckets[bucketOf(key)];
+		while (index != NIL && std::memcmp(&m_nodes[index].key, &key, sizeof(K)) != 0) {
+			index = m_nodes[index].hashNext;
+		}
+		return index;
+	}
+
+	template <class K, class V>
+	void PersistentLruCache<K, V>::unlinkFromList(const uint32_t index) {
+		Node& node = m_nodes[index];
+		(node.prev == NIL ? m_header->head : m_nodes[node.prev].next) = node.next;
+		(node.next == NIL ? m_header->tail : m_nodes[node.next].prev) = node.prev;
+		node.prev = NIL;
+		node.next = NIL;
+	}
+
+	template <class K, class V>
+	void PersistentLruCache<K, V>::appendToList(const uint32_t index) {
+		Node& node = m_nodes[index];
+		node.prev = m_header->tail;
+		node.next = NIL;
+		(m_header->tail == NIL ? m_header->head : m_nodes[m_header->tail].next) = index;
+		m_header->tail = index;
+	}
+
+	template <class K, class V>
+	void PersistentLruCache<K, V>::unlinkFromBucket(const uint32_t index) {
+		uint32_t* link = &m_buckets[bucketOf(m_nodes[index].key)];
+		while (*link != index) {
+			link = &m_nodes[*link].hashNext;
+		}
+		*link = m_nodes[index].hashNext;
+		m_nodes[index].hashNext = NIL;
+	}
+
+	template <class K, class V>
+	void PersistentLruCache<K, V>::linkIntoBucket(const uint32_t index) {
+		const uint32_t bucket = bucketOf(m_nodes[index].key);
+		m_nodes[index].hashNext = m_buckets[bucket];
+		m_buckets[bucket] = index;
+	}
+
+	template <class K, class V>
+	PersistentLruCache<K, V>::PersistentLruCache(const std::string& path, const uint32_t capacity)
+		: m_capacity(capacity)
+		, m_bucketCount(bucketCountFor(capacity))
+		, m_file(path, fileSizeFor(capacity))
+		, m_header(reinterpret_cast<Header*>(m_file.data()))
+		, m_buckets(reinterpret_cast<uint32_t*>(m_file.data() + sizeof(Header)))
+		, m_nodes(reinterpret_cast<Node*>(m_file.data() + m_file.size() - capacity * sizeof(Node)))
+		, m_wasRecovered(false)
+		, m_mutex() {
+		m_wasRecovered = hasValidLayout();
+		if (m_wasRecovered) {
+			recover();
+		}
+		else {
+			reset();
+		}
+	}
+
+	template <class K, class V>
+	PersistentLruCache<K, V>::~PersistentLruCache() {
+		m_file.flush();
+	}
+
+	template <class K, class V>
+	bool PersistentLruCache<K, V>::wasRecovered() const noexcept {
+		return m_wasRecovered;
+	}
+
+	template <class K, class V>
+	size_t PersistentLruCache<K, V>::size() const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_header->size;
+	}
+
+	template <class K, class V>
+	size_t PersistentLruCache<K, V>::capacity() const noexcept {
+		return m_capacity;
+	}
+
+	template <class K, class V>
+	bool PersistentLruCache<K, V>::empty() const {
+		return size() == 0;
+	}
+
+	template <class K, class V>
+	bool PersistentLruCache<K, V>::hasKey(const K& key) const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return findNode(key) != NIL;
+	}
+
+	template <class K, class V>
+	std::optional<V> PersistentLruCache<K, V>::get(const K& key) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const uint32_t index = findNode(key);
+		if (index == NIL) {
+			return std::nullopt;
+		}
+		if (index != m_header->tail) {
+			unlinkFromList(index);
+			appendToList(index);
+		}
+		return m_nodes[index].value;
+	}
+
+	template <class K, class V>
+	void PersistentLruCache<K, V>::push(const K& key, const V& value) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		uint32_t index = findNode(key);
+		if (index != NIL) {
+			m_nodes[index].value = value;
+			m_nodes[index].checksum = checksumOf(m_nodes[index]);
+			unlinkFromList(index);
+			appendToList(index);
+			return;
+		}
+		if (m_header->freeHead == NIL) {
+			const uint32_t evicted = m_header->head;
+			unlinkFromBucket(evicted);
+			unlinkFromList(evicted);
+			m_nodes[evicted].next = NIL;
+			m_header->freeHead = evicted;
+			m_header->size--;
+		}
+		index = m_header->freeHead;
+		m_header->freeHead = m_nodes[index].next;
+		Node& node = m_nodes[index];
+		node.key = key;
+		node.value = value;
+		node.checksum = checksumOf(node);
+		linkIntoBucket(index);
+		appendToList(index);
+		m_header->size++;
+	}
+
+	template <class K, class V>
+	bool PersistentLruCache<K, V>::remove(const K& key) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const uint32_t index = findNode(key);
+		if (index == NIL) {
+			return false;
+		}
+		unlinkFromBucket(index);
+		unlinkFromList(index);
+		m_nodes[index].next = m_header->freeHead;
+		m_header->freeHead = index;
+		m_header->size--;
+		return true;
+	}
+
+	template <class K, class V>
+	void PersistentLruCache<K, V>::flush() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_file.flush();
+	}
+}
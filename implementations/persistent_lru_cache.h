@@ -0,0 +1,101 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+
+namespace implementations {
+	/*
+	* LRU cache whose nodes and index live in a file backed memory mapping so a restarted process reopens it warm
+	* links are node indices rather than pointers so the mapping can land at any address,
+	* hence keys and values must be trivially copyable and keys are hashed and compared by their bytes
+	* every entry carries a checksum of its key and value, written after them, and the header one of its layout fields
+	* opening walks the LRU list once and rebuilds the index and free list from it, dropping any entry whose checksum
+	* does not match or whose links lead nowhere, so a file left behind by a killed process reopens warm minus at most
+	* the entry it was writing; the cost is one pass over the entries and buckets, the file is never hashed whole
+	* a file with a corrupt header or laid out for different types or capacity is reset to empty
+	*/
+	template <class K, class V>
+	class PersistentLruCache
+	{
+		static_assert(std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<V>, "PersistentLruCache stores raw bytes");
+		static_assert(std::has_unique_object_representations_v<K>, "PersistentLruCache compares keys by their bytes");
+
+		static constexpr uint64_t MAGIC = 0x4c52554341434845; // "LRUCACHE"
+		static constexpr uint32_t VERSION = 2;
+		static constexpr uint32_t NIL = UINT32_MAX;
+
+		struct Header {
+			uint64_t magic;
+			uint32_t version;
+			uint32_t keySize;
+			uint32_t valueSize;
+			uint32_t capacity;
+			uint32_t bucketCount;
+			// of the fields above, written once when the file is laid out
+			uint32_t layoutChecksum;
+			uint32_t head;
+			uint32_t tail;
+			uint32_t freeHead;
+			uint32_t size;
+		};
+
+		struct Node {
+			K key;
+			V value;
+			uint32_t prev;
+			uint32_t next;
+			uint32_t hashNext;
+			// of key and value, a mismatch means the process died while writing them
+			uint32_t checksum;
+		};
+
+		const uint32_t m_capacity;
+		const uint32_t m_bucketCount;
+		MappedFile m_file;
+		Header* m_header;
+		uint32_t* m_buckets;
+		Node* m_nodes;
+		bool m_wasRecovered;
+		mutable std::mutex m_mutex;
+
+		static uint32_t bucketCountFor(const uint32_t capacity);
+		static size_t fileSizeFor(const uint32_t capacity);
+		static uint64_t hashBytes(const void* data, const size_t length, uint64_t hash);
+		uint32_t layoutChecksum() const;
+		static uint32_t checksumOf(const Node& node);
+		bool hasValidLayout() const;
+		void reset();
+		// relinks the entries reachable from the head of the list, the rest become free
+		void recover();
+		uint32_t bucketOf(const K& key) const;
+		uint32_t findNode(const K& key) const;
+		void unlinkFromList(const uint32_t index);
+		void appendToList(const uint32_t index);
+		void unlinkFromBucket(const uint32_t index);
+		void linkIntoBucket(const uint32_t index);
+	public:
+		PersistentLruCache(const std::string& path, const uint32_t capacity);
+		PersistentLruCache(const PersistentLruCache&) = delete;
+		PersistentLruCache& operator=(const PersistentLruCache&) = delete;
+		~PersistentLruCache();
+
+		// whether the entries of a previous process were recovered from the file
+		bool wasRecovered() const noexcept;
+		size_t size() const;
+		size_t capacity() const noexcept;
+		bool empty() const;
+		bool hasKey(const K& key) const;
+		std::optional<V> get(const K& key);
+
+		void push(const K& key, const V& value);
+		bool remove(const K& key);
+		// writes the mapping back to the file, the cache stays usable afterwards
+		void flush();
+	};
+}
@@ -0,0 +1,155 @@
+#include "slab_arena.h"
+
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+namespace implementations {
+	inline SlabArena::SizeClass::SizeClass(const size_t slotSize, SizeClass* next)
+		: slotSize(slotSize)
+		, next(next)
+		, freeSlots(nullptr)
+		, unusedSlots(nullptr)
+		, numUnusedSlots(0)
+		, chunks()
+		, mutex() {}
+
+	inline SlabArena::SlabArena(const size_t slotsPerChunk)
+		: m_sizeClasses(nullptr)
+		, m_sizeClassesMutex()
+		, m_slotsPerChunk(slotsPerChunk)
+		, m_numSlotsInUse(0) {
+		if (slotsPerChunk == 0) {
+			throw std::invalid_argument("Slab arena chunks need at least one slot");
+		}
+	}
+
+	inline SlabArena::~SlabArena() {
+		SizeClass* sizeClass = m_sizeClasses.load(std::memory_order_relaxed);
+		while (sizeClass) {
+			for (void* chunk : sizeClass->chunks) {
+				::operator delete(chunk);
+			}
+			delete std::exchange(sizeClass, sizeClass->next);
+		}
+	}
+
+	inline size_t SlabArena::slotSizeOf(const size_t size) noexcept {
+		// a free slot holds the pointer to the next one, and every slot stays aligned like the chunk
+		const size_t alignment = alignof(std::max_align_t);
+		const size_t slotSize = size < sizeof(void*) ? sizeof(void*) : size;
+		return (slotSize + alignment - 1) / alignment * alignment;
+	}
+
+	inline SlabArena::SizeClass* SlabArena::findSizeClass(const size_t slotSize) const noexcept {
+		// a handful of sizes per arena, a scan beats hashing
+		for (SizeClass* sizeClass = m_sizeClasses.load(std::memory_order_acquire); sizeClass; sizeClass = sizeClass->next) {
+			if (sizeClass->slotSize == slotSize) {
+				return sizeClass;
+			}
+		}
+		return nullptr;
+	}
+
+	inline SlabArena::SizeClass& SlabArena::sizeClassOf(const size_t slotSize) {
+		if (SizeClass* sizeClass = findSizeClass(slotSize)) {
+			return *sizeClass;
+		}
+		std::lock_guard<std::mutex> lock(m_sizeClassesMutex);
+		// another thread may have added it meanwhile
+		if (SizeClass* sizeClass = findSizeClass(slotSize)) {
+			return *sizeClass;
+		}
+		SizeClass* sizeClass = new SizeClass(slotSize, m_sizeClasses.load(std::memory_order_relaxed));
+		m_sizeClasses.store(sizeClass, std::memory_order_release);
+		return *sizeClass;
+	}
+
+	inline void* SlabArena::allocate(const size_t size) {
+		SizeClass& sizeClass = sizeClassOf(slotSizeOf(size));
+		void* slot;
+		{
+			std::lock_guard<std::mutex> lock(sizeClass.mutex);
+			if (sizeClass.freeSlots) {
+				slot = sizeClass.freeSlots;
+				sizeClass.freeSlots = *static_cast<void**>(slot);
+			}
+			else {
+				if (sizeClass.numUnusedSlots == 0) {
+					sizeClass.chunks.reserve(sizeClass.chunks.size() + 1);
+					void* chunk = ::operator new(sizeClass.slotSize * m_slotsPerChunk);
+					sizeClass.chunks.push_back(chunk);
+					sizeClass.unusedSlots = static_cast<std::byte*>(chunk);
+					sizeClass.numUnusedSlots = m_slotsPerChunk;
+				}
+				slot = sizeClass.unusedSlots;
+				sizeClass.unusedSlots += sizeClass.slotSize;
+				sizeClass.numUnusedSlots--;
+			}
+		}
+		m_numSlotsInUse.fetch_add(1, std::memory_order_relaxed);
+		return slot;
+	}
+
+	inline void SlabArena::deallocate(void* slot, const size_t size) noexcept {
+		// the size class exists since the slot was allocated from it
+		SizeClass& sizeClass = *findSizeClass(slotSizeOf(size));
+		{
+			std::lock_guard<std::mutex> lock(sizeClass.mutex);
+			*static_cast<void**>(slot) = sizeClass.freeSlots;
+			sizeClass.freeSlots = slot;
+		}
+		m_numSlotsInUse.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	inline size_t SlabArena::numChunks() const {
+		size_t numChunks = 0;
+		for (SizeClass* sizeClass = m_sizeClasses.load(std::memory_order_acquire); sizeClass; sizeClass = sizeClass->next) {
+			std::lock_guard<std::mutex> lock(sizeClass->mutex);
+			numChunks += sizeClass->chunks.size();
+		}
+		return numChunks;
+	}
+
+	inline size_t SlabArena::numSlotsInUse() const {
+		return m_numSlotsInUse.load(std::memory_order_relaxed);
+	}
+
+	template <class T>
+	SlabAllocator<T>::SlabAllocator(std::shared_ptr<SlabArena> arena) noexcept
+		: m_arena(std::move(arena)) {}
+
+	template <class T>
+	template <class U>
+	SlabAllocator<T>::SlabAllocator(const SlabAllocator<U>& other) noexcept
+		: m_arena(other.m_arena) {}
+
+	template <class T>
+	bool SlabAllocator<T>::isSlabbed(const size_t n) noexcept {
+		return n == 1 && alignof(T) <= alignof(std::max_align_t);
+	}
+
+	template <class T>
+	T* SlabAllocator<T>::allocate(const size_t n) {
+		if (isSlabbed(n)) {
+			return static_cast<T*>(m_arena->allocate(sizeof(T)));
+		}
+		return std::allocator<T>().allocate(n);
+	}
+
+	template <class T>
+	void SlabAllocator<T>::deallocate(T* p, const size_t n) noexcept {
+		if (isSlabbed(n)) {
+			m_arena->deallocate(p, sizeof(T));
+		}
+		else {
+			std::allocator<T>().deallocate(p, n);
+		}
+	}
+
+	template <class T>
+	template <class U>
+	bool SlabAllocator<T>::operator==(const SlabAllocator<U>& other) const noexcept {
+		return m_arena == other.m_arena;
+	}
+}
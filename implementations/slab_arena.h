@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace implementations {
+	/*
+	* fixed size slots carved out of large chunks, for many small objects of a handful of sizes that come and go,
+	* eg the nodes of a tree
+	* saves the per allocation header and scattering of the general purpose heap, each size has its own free list
+	* and a freed slot is handed to the next allocation of that size, chunks are only released with the arena
+	* thread safe, each size has its own mutex, so allocations of different sizes never wait for each other,
+	* and a size is found without a lock
+	*/
+	class SlabArena
+	{
+		struct SizeClass {
+			const size_t slotSize;
+			// the size class added before this one, fixed once published
+			SizeClass* const next;
+			// freed slots, each holding the next one
+			void* freeSlots;
+			// first slot of the newest chunk never handed out, and how many follow it
+			std::byte* unusedSlots;
+			size_t numUnusedSlots;
+			std::vector<void*> chunks;
+			mutable std::mutex mutex;
+
+			SizeClass(const size_t slotSize, SizeClass* next);
+		};
+
+		// newest first, a size class is only ever prepended, so readers walk it without a lock
+		std::atomic<SizeClass*> m_sizeClasses;
+		// serialises adding a size class
+		std::mutex m_sizeClassesMutex;
+		const size_t m_slotsPerChunk;
+		std::atomic<size_t> m_numSlotsInUse;
+
+		SizeClass* findSizeClass(const size_t slotSize) const noexcept;
+		SizeClass& sizeClassOf(const size_t slotSize);
+	public:
+		explicit SlabArena(const size_t slotsPerChunk = 1024);
+		SlabArena(const SlabArena&) = delete;
+		SlabArena& operator=(const SlabArena&) = delete;
+		~SlabArena();
+
+		// one slot of at least size bytes, aligned for any scalar type
+		void* allocate(const size_t size);
+		// size must be the one the slot was allocated with
+		void deallocate(void* slot, const size_t size) noexcept;
+
+		// slot size a request of size bytes is rounded up to
+		static size_t slotSizeOf(const size_t size) noexcept;
+		size_t numChunks() const;
+		size_t numSlotsInUse() const;
+	};
+
+	/*
+	* standard allocator handing out single objects from a shared SlabArena, eg for std::allocate_shared
+	* every copy shares the arena, so objects allocated through it keep the arena alive,
+	* arrays and over aligned types go to the general purpose heap
+	*/
+	template <class T>
+	class SlabAllocator
+	{
+		template <class U>
+		friend class SlabAllocator;
+
+		std::shared_ptr<SlabArena> m_arena;
+
+		static bool isSlabbed(const size_t n) noexcept;
+	public:
+		using value_type = T;
+
+		explicit SlabAllocator(std::shared_ptr<SlabArena> arena) noexcept;
+		template <class U>
+		SlabAllocator(const SlabAllocator<U>& other) noexcept;
+
+		T* allocate(const size_t n);
+		void deallocate(T* p, const size_t n) noexcept;
+
+		template <class U>
+		bool operator==(const SlabAllocator<U>& other) const noexcept;
+	};
+}
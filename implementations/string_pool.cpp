@@ -0,0 +1,126 @@
+#include "string_pool.h"
+
+namespace implementations {
+	struct InternedString::Entry {
+		std::string text;
+		std::atomic<size_t> numRefs;
+		// keeps the table this entry is filed in alive
+		std::shared_ptr<StringPool::Table> table;
+	};
+
+	inline InternedString::InternedString() noexcept
+		: m_entry(nullptr) {}
+
+	inline InternedString::InternedString(Entry* entry) noexcept
+		: m_entry(entry) {}
+
+	inline InternedString::InternedString(const InternedString& other) noexcept
+		: m_entry(other.m_entry) {
+		if (m_entry) {
+			// the other handle holds a reference, so the count cannot drop to zero meanwhile
+			m_entry->numRefs.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	inline InternedString::InternedString(InternedString&& other) noexcept
+		: m_entry(other.m_entry) {
+		other.m_entry = nullptr;
+	}
+
+	inline InternedString& InternedString::operator=(const InternedString& other) noexcept {
+		if (m_entry != other.m_entry) {
+			InternedString copy(other);
+			std::swap(m_entry, copy.m_entry);
+		}
+		return *this;
+	}
+
+	inline InternedString& InternedString::operator=(InternedString&& other) noexcept {
+		if (this != &other) {
+			release();
+			m_entry = other.m_entry;
+			other.m_entry = nullptr;
+		}
+		return *this;
+	}
+
+	inline InternedString::~InternedString() {
+		release();
+	}
+
+	inline void InternedString::release() noexcept {
+		if (!m_entry) {
+			return;
+		}
+		Entry* entry = m_entry;
+		m_entry = nullptr;
+		// any reference but the last drops without the lock, so only the pool's mutex sees a count reach zero
+		size_t numRefs = entry->numRefs.load(std::memory_order_relaxed);
+		while (numRefs > 1) {
+			if (entry->numRefs.compare_exchange_weak(numRefs, numRefs - 1, std::memory_order_release, std::memory_order_relaxed)) {
+				return;
+			}
+		}
+		StringPool::releaseLast(entry);
+	}
+
+	inline const std::string& InternedString::str() const noexcept {
+		static const std::string emptyString;
+		return m_entry ? m_entry->text : emptyString;
+	}
+
+	inline InternedString::operator std::string_view() const noexcept {
+		return str();
+	}
+
+	inline size_t InternedString::size() const noexcept {
+		return str().size();
+	}
+
+	inline bool InternedString::empty() const noexcept {
+		return str().empty();
+	}
+
+	inline bool operator==(const InternedString& a, std::string_view b) noexcept {
+		return std::string_view(a.str()) == b;
+	}
+
+	inline std::ostream& operator<<(std::ostream& stream, const InternedString& s) {
+		return stream << s.str();
+	}
+
+	inline StringPool::StringPool()
+		: m_table(std::make_shared<Table>()) {}
+
+	inline InternedString StringPool::intern(std::string_view text) {
+		std::lock_guard<std::mutex> lock(m_table->mutex);
+		const auto entryIt = m_table->entries.find(text);
+		if (entryIt != m_table->entries.cend()) {
+			// under the lock, so the count is not on its way from one to zero
+			entryIt->second->numRefs.fetch_add(1, std::memory_order_relaxed);
+			return InternedString(entryIt->second);
+		}
+		std::unique_ptr<InternedString::Entry> entry(new InternedString::Entry{ std::string(text), 1, m_table });
+		m_table->entries.emplace(entry->text, entry.get());
+		return InternedString(entry.release());
+	}
+
+	inline size_t StringPool::size() const {
+		std::lock_guard<std::mutex> lock(m_table->mutex);
+		return m_table->entries.size();
+	}
+
+	inline void StringPool::releaseLast(InternedString::Entry* entry) noexcept {
+		// released after the lock, it may be the last owner of the table
+		const std::shared_ptr<Table> table = entry->table;
+		{
+			std::lock_guard<std::mutex> lock(table->mutex);
+			// intern may have handed out another reference since the count was read
+			if (entry->numRefs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+				return;
+			}
+			table->entries.erase(entry->text);
+		}
+		delete entry;
+	}
+}
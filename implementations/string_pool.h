@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace implementations {
+	class StringPool;
+
+	/*
+	* handle to a string interned in a StringPool, the size of a pointer, copies share the pooled string
+	* immutable, assigning another handle repoints this one, a default constructed handle reads as empty
+	*/
+	class InternedString
+	{
+		friend class StringPool;
+
+		struct Entry;
+
+		Entry* m_entry;
+
+		explicit InternedString(Entry* entry) noexcept;
+		void release() noexcept;
+	public:
+		InternedString() noexcept;
+		InternedString(const InternedString& other) noexcept;
+		InternedString(InternedString&& other) noexcept;
+		InternedString& operator=(const InternedString& other) noexcept;
+		InternedString& operator=(InternedString&& other) noexcept;
+		~InternedString();
+
+		const std::string& str() const noexcept;
+		operator std::string_view() const noexcept;
+		size_t size() const noexcept;
+		bool empty() const noexcept;
+
+		friend bool operator==(const InternedString& a, std::string_view b) noexcept;
+		friend std::ostream& operator<<(std::ostream& stream, const InternedString& s);
+	};
+
+	/*
+	* interns strings, so equal strings share one copy, eg the names of a tree where most names repeat
+	* a pooled string is freed with its last handle, and handles keep the pool's table alive, so they may outlive the pool
+	* thread safe: copying a handle is an atomic increment, only interning and dropping the last handle of a string
+	* take the pool's mutex
+	*/
+	class StringPool
+	{
+		struct Table {
+			// keyed by views of the entries' own strings
+			std::unordered_map<std::string_view, InternedString::Entry*> entries;
+			std::mutex mutex;
+		};
+
+		std::shared_ptr<Table> m_table;
+
+		friend class InternedString;
+		static void releaseLast(InternedString::Entry* entry) noexcept;
+	public:
+		StringPool();
+
+		InternedString intern(std::string_view text);
+		// number of distinct strings alive
+		size_t size() const;
+	};
+}
@@ -0,0 +1,449 @@
+#include "swiss_table.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <new>
+#include <random>
+#include <tuple>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SWISS_TABLE_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#endif
+
+namespace implementations {
+	inline const std::array<uint64_t, 2>& SeededHash::processSeed() {
+		static const std::array<uint64_t, 2> seed = []() {
+			std::random_device device;
+			std::array<uint64_t, 2> drawn;
+			for (uint64_t& word : drawn) {
+				word = (static_cast<uint64_t>(device()) << 32) ^ device();
+			}
+			return drawn;
+		}();
+		return seed;
+	}
+
+	inline SeededHash::SeededHash()
+		: m_seed(processSeed()) {}
+
+	inline SeededHash::SeededHash(const uint64_t seed0, const uint64_t seed1)
+		: m_seed{ seed0, seed1 } {}
+
+	inline uint64_t SeededHash::sipHash13(const std::array<uint64_t, 2>& seed, std::string_view bytes) noexcept {
+		uint64_t v0 = seed[0] ^ 0x736f6d6570736575ull;
+		uint64_t v1 = seed[1] ^ 0x646f72616e646f6dull;
+		uint64_t v2 = seed[0] ^ 0x6c7967656e657261ull;
+		uint64_t v3 = seed[1] ^ 0x7465646279746573ull;
+		const auto round = [&]() {
+			v0 += v1; v1 = std::rotl(v1, 13); v1 ^= v0; v0 = std::rotl(v0, 32);
+			v2 += v3; v3 = std::rotl(v3, 16); v3 ^= v2;
+			v0 += v3; v3 = std::rotl(v3, 21); v3 ^= v0;
+			v2 += v1; v1 = std::rotl(v1, 17); v1 ^= v2; v2 = std::rotl(v2, 32);
+		};
+		const auto readLittleEndian = [](const char* data, const size_t length) {
+			uint64_t word = 0;
+			for (size_t i = 0; i < length; i++) {
+				word |= static_cast<uint64_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+			}
+			return word;
+		};
+		const size_t numWords = bytes.size() / 8;
+		for (size_t i = 0; i < numWords; i++) {
+			const uint64_t word = readLittleEndian(bytes.data() + 8 * i, 8);
+			v3 ^= word;
+			round();
+			v0 ^= word;
+		}
+		const uint64_t last = (static_cast<uint64_t>(bytes.size()) << 56) | readLittleEndian(bytes.data() + 8 * numWords, bytes.size() % 8);
+		v3 ^= last;
+		round();
+		v0 ^= last;
+		v2 ^= 0xff;
+		round();
+		round();
+		round();
+		return v0 ^ v1 ^ v2 ^ v3;
+	}
+
+	inline uint64_t SeededHash::mix(const std::array<uint64_t, 2>& seed, uint64_t value) noexcept {
+		value ^= seed[0];
+		value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+		value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+		value ^= seed[1];
+		return value ^ (value >> 31);
+	}
+
+	template <class KeyLike>
+	size_t SeededHash::operator()(const KeyLike& key) const noexcept {
+		if constexpr (std::is_convertible_v<const KeyLike&, std::string_view>) {
+			return static_cast<size_t>(sipHash13(m_seed, std::string_view(key)));
+		}
+		else {
+			return static_cast<size_t>(mix(m_seed, static_cast<uint64_t>(std::hash<KeyLike>()(key))));
+		}
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	SwissTable<K, T, Hash, KeyEqual>::Group::Group(const int8_t* control)
+		: m_control(control) {}
+
+#ifdef SWISS_TABLE_SSE2
+	template <class K, class T, class Hash, class KeyEqual>
+	uint32_t SwissTable<K, T, Hash, KeyEqual>::Group::match(const int8_t h2) const {
+		const __m128i control = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_control));
+		return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), control)));
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	uint32_t SwissTable<K, T, Hash, KeyEqual>::Group::matchEmptyOrDeleted() const {
+		// empty and deleted are the only control bytes with the sign bit set
+		return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(m_control))));
+	}
+#else
+	template <class K, class T, class Hash, class KeyEqual>
+	uint32_t SwissTable<K, T, Hash, KeyEqual>::Group::match(const int8_t h2) const {
+		uint32_t mask = 0;
+		for (size_t i = 0; i < GROUP_WIDTH; i++) {
+			mask |= static_cast<uint32_t>(m_control[i] == h2) << i;
+		}
+		return mask;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	uint32_t SwissTable<K, T, Hash, KeyEqual>::Group::matchEmptyOrDeleted() const {
+		uint32_t mask = 0;
+		for (size_t i = 0; i < GROUP_WIDTH; i++) {
+			mask |= static_cast<uint32_t>(m_control[i] < 0) << i;
+		}
+		return mask;
+	}
+#endif
+
+	template <class K, class T, class Hash, class KeyEqual>
+	uint32_t SwissTable<K, T, Hash, KeyEqual>::Group::matchEmpty() const {
+		return match(EMPTY);
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	SwissTable<K, T, Hash, KeyEqual>::SwissTable()
+		: m_control()
+		, m_slots()
+		, m_numGroups(0)
+		, m_size(0)
+		, m_growthLeft(0)
+		, m_hash()
+		, m_equal() {}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	SwissTable<K, T, Hash, KeyEqual>::~SwissTable() {
+		destroyAll();
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	size_t SwissTable<K, T, Hash, KeyEqual>::capacity() const noexcept {
+		return m_numGroups * GROUP_WIDTH;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	size_t SwissTable<K, T, Hash, KeyEqual>::maxLoad(const size_t capacity) noexcept {
+		return capacity - capacity / 8;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	int8_t SwissTable<K, T, Hash, KeyEqual>::h2Of(const size_t hash) noexcept {
+		return static_cast<int8_t>(hash & 0x7f);
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	size_t SwissTable<K, T, Hash, KeyEqual>::size() const noexcept {
+		return m_size;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	bool SwissTable<K, T, Hash, KeyEqual>::empty() const noexcept {
+		return m_size == 0;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <class KeyLike>
+	size_t SwissTable<K, T, Hash, KeyEqual>::findIndex(const KeyLike& key, const size_t hash) const {
+		if (m_size == 0) {
+			return capacity();
+		}
+		const int8_t h2 = h2Of(hash);
+		const size_t groupMask = m_numGroups - 1;
+		size_t group = (hash >> 7) & groupMask;
+		// triangular steps visit every group once when the number of groups is a power of two
+		for (size_t step = 1; step <= m_numGroups; step++) {
+			const Group controls(m_control.get() + group * GROUP_WIDTH);
+			for (uint32_t matches = controls.match(h2); matches; matches &= matches - 1) {
+				const size_t index = group * GROUP_WIDTH + std::countr_zero(matches);
+				if (m_equal(m_slots[index].value.first, key)) {
+					return index;
+				}
+			}
+			if (controls.matchEmpty()) {
+				break;
+			}
+			group = (group + step) & groupMask;
+		}
+		return capacity();
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	size_t SwissTable<K, T, Hash, KeyEqual>::findInsertIndex(const size_t hash) const {
+		const size_t groupMask = m_numGroups - 1;
+		size_t group = (hash >> 7) & groupMask;
+		for (size_t step = 1; ; step++) {
+			const uint32_t available = Group(m_control.get() + group * GROUP_WIDTH).matchEmptyOrDeleted();
+			if (available) {
+				return group * GROUP_WIDTH + std::countr_zero(available);
+			}
+			group = (group + step) & groupMask;
+		}
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	void SwissTable<K, T, Hash, KeyEqual>::setControl(const size_t index, const int8_t control) {
+		m_control[index] = control;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	void SwissTable<K, T, Hash, KeyEqual>::rehash(const size_t numGroups) {
+		std::unique_ptr<int8_t[]> oldControl = std::move(m_control);
+		std::unique_ptr<Slot[]> oldSlots = std::move(m_slots);
+		const size_t oldCapacity = capacity();
+		m_numGroups = numGroups;
+		m_control = std::make_unique<int8_t[]>(capacity());
+		std::memset(m_control.get(), EMPTY, capacity());
+		m_slots = std::make_unique<Slot[]>(capacity());
+		for (size_t i = 0; i < oldCapacity; i++) {
+			if (oldControl[i] < 0) {
+				continue;
+			}
+			value_type& value = oldSlots[i].value;
+			const size_t hash = m_hash(value.first);
+			const size_t index = findInsertIndex(hash);
+			new (&m_slots[index].value) value_type(std::move(value));
+			setControl(index, h2Of(hash));
+			value.~value_type();
+		}
+		m_growthLeft = maxLoad(capacity()) - m_size;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	void SwissTable<K, T, Hash, KeyEqual>::destroyAll() {
+		if constexpr (!std::is_trivially_destructible_v<value_type>) {
+			for (size_t i = 0; i < capacity(); i++) {
+				if (m_control[i] >= 0) {
+					m_slots[i].value.~value_type();
+				}
+			}
+		}
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	void SwissTable<K, T, Hash, KeyEqual>::reserve(const size_t count) {
+		size_t numGroups = std::max<size_t>(m_numGroups, 1);
+		while (maxLoad(numGroups * GROUP_WIDTH) < count) {
+			numGroups *= 2;
+		}
+		if (numGroups != m_numGroups) {
+			rehash(numGroups);
+		}
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	void SwissTable<K, T, Hash, KeyEqual>::clear() {
+		destroyAll();
+		if (m_numGroups > 0) {
+			std::memset(m_control.get(), EMPTY, capacity());
+		}
+		m_size = 0;
+		m_growthLeft = maxLoad(capacity());
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <class KeyLike>
+	auto SwissTable<K, T, Hash, KeyEqual>::find(const KeyLike& key) -> iterator {
+		return iterator(this, findIndex(key, m_hash(key)));
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <class KeyLike>
+	auto SwissTable<K, T, Hash, KeyEqual>::find(const KeyLike& key) const -> const_iterator {
+		return const_iterator(this, findIndex(key, m_hash(key)));
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <class KeyLike>
+	bool SwissTable<K, T, Hash, KeyEqual>::contains(const KeyLike& key) const {
+		return findIndex(key, m_hash(key)) != capacity();
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <class KeyLike>
+	void SwissTable<K, T, Hash, KeyEqual>::prefetch(const KeyLike& key) const {
+		if (m_numGroups == 0) {
+			return;
+		}
+		const size_t group = (m_hash(key) >> 7) & (m_numGroups - 1);
+#if defined(__GNUC__) || defined(__clang__)
+		__builtin_prefetch(m_control.get() + group * GROUP_WIDTH);
+		__builtin_prefetch(&m_slots[group * GROUP_WIDTH]);
+#elif defined(_MSC_VER)
+		_mm_prefetch(reinterpret_cast<const char*>(m_control.get() + group * GROUP_WIDTH), _MM_HINT_T0);
+		_mm_prefetch(reinterpret_cast<const char*>(&m_slots[group * GROUP_WIDTH]), _MM_HINT_T0);
+#endif
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <class KeyArg, class ...Args>
+	auto SwissTable<K, T, Hash, KeyEqual>::emplace(KeyArg&& key, Args&&... args) -> std::pair<iterator, bool> {
+		const size_t hash = m_hash(key);
+		const size_t existing = findIndex(key, hash);
+		if (existing != capacity()) {
+			return { iterator(this, existing), false };
+		}
+		if (m_growthLeft == 0) {
+			// a table mostly full of tombstones is cleaned in place rather than grown
+			rehash(m_size * 2 < maxLoad(capacity()) ? std::max<size_t>(m_numGroups, 1) : std::max<size_t>(m_numGroups * 2, 1));
+		}
+		const size_t index = findInsertIndex(hash);
+		new (&m_slots[index].value) value_type(std::piecewise_construct, std::forward_as_tuple(std::forward<KeyArg>(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+		if (m_control[index] == EMPTY) {
+			m_growthLeft--;
+		}
+		setControl(index, h2Of(hash));
+		m_size++;
+		return { iterator(this, index), true };
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	auto SwissTable<K, T, Hash, KeyEqual>::erase(iterator it) -> iterator {
+		return erase(const_iterator(it));
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	auto SwissTable<K, T, Hash, KeyEqual>::erase(const_iterator it) -> iterator {
+		const size_t index = it.m_index;
+		m_slots[index].value.~value_type();
+		m_size--;
+		// once a group has filled up it never regains an empty slot before a rehash, so a group that still has one
+		// was never full, no probe went past it and the slot can be emptied instead of left as a tombstone
+		const size_t groupStart = index - index % GROUP_WIDTH;
+		if (Group(m_control.get() + groupStart).matchEmpty()) {
+			setControl(index, EMPTY);
+			m_growthLeft++;
+		}
+		else {
+			setControl(index, DELETED);
+		}
+		iterator next(this, index);
+		next.skipToFull();
+		return next;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <class KeyLike>
+	size_t SwissTable<K, T, Hash, KeyEqual>::erase(const KeyLike& key) {
+		const size_t index = findIndex(key, m_hash(key));
+		if (index == capacity()) {
+			return 0;
+		}
+		erase(const_iterator(this, index));
+		return 1;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <bool IsConst>
+	SwissTable<K, T, Hash, KeyEqual>::Iterator<IsConst>::Iterator(std::conditional_t<IsConst, const SwissTable*, SwissTable*> table, const size_t index)
+		: m_table(table), m_index(index) {}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <bool IsConst>
+	SwissTable<K, T, Hash, KeyEqual>::Iterator<IsConst>::Iterator()
+		: m_table(nullptr), m_index(0) {}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <bool IsConst>
+	template <bool WasConst, class>
+	SwissTable<K, T, Hash, KeyEqual>::Iterator<IsConst>::Iterator(const Iterator<WasConst>& other)
+		: m_table(other.m_table), m_index(other.m_index) {}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <bool IsConst>
+	void SwissTable<K, T, Hash, KeyEqual>::Iterator<IsConst>::skipToFull() {
+		while (m_index < m_table->capacity() && m_table->m_control[m_index] < 0) {
+			m_index++;
+		}
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <bool IsConst>
+	auto SwissTable<K, T, Hash, KeyEqual>::Iterator<IsConst>::operator*() const -> reference {
+		return m_table->m_slots[m_index].value;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <bool IsConst>
+	auto SwissTable<K, T, Hash, KeyEqual>::Iterator<IsConst>::operator->() const -> pointer {
+		return &m_table->m_slots[m_index].value;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <bool IsConst>
+	auto SwissTable<K, T, Hash, KeyEqual>::Iterator<IsConst>::operator++() -> Iterator& {
+		m_index++;
+		skipToFull();
+		return *this;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	template <bool IsConst>
+	auto SwissTable<K, T, Hash, KeyEqual>::Iterator<IsConst>::operator++(int) -> Iterator {
+		Iterator previous = *this;
+		++(*this);
+		return previous;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	auto SwissTable<K, T, Hash, KeyEqual>::begin() -> iterator {
+		iterator first(this, 0);
+		first.skipToFull();
+		return first;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	auto SwissTable<K, T, Hash, KeyEqual>::end() -> iterator {
+		return iterator(this, capacity());
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	auto SwissTable<K, T, Hash, KeyEqual>::begin() const -> const_iterator {
+		const_iterator first(this, 0);
+		first.skipToFull();
+		return first;
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	auto SwissTable<K, T, Hash, KeyEqual>::end() const -> const_iterator {
+		return const_iterator(this, capacity());
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	auto SwissTable<K, T, Hash, KeyEqual>::cbegin() const -> const_iterator {
+		return begin();
+	}
+
+	template <class K, class T, class Hash, class KeyEqual>
+	auto SwissTable<K, T, Hash, KeyEqual>::cend() const -> const_iterator {
+		return end();
+	}
+}
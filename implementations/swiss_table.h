@@ -0,0 +1,165 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace implementations {
+	/*
+	* keyed hash for tables fed with untrusted keys
+	* string like keys are hashed with SipHash-1-3, every other key has its std::hash mixed with the seed,
+	* so without the seed an attacker cannot pick keys that share buckets
+	* default constructed instances share a seed drawn from std::random_device once per process
+	* transparent, so string keys can be probed with a std::string_view
+	*/
+	class SeededHash
+	{
+		std::array<uint64_t, 2> m_seed;
+
+		static const std::array<uint64_t, 2>& processSeed();
+		static uint64_t sipHash13(const std::array<uint64_t, 2>& seed, std::string_view bytes) noexcept;
+		static uint64_t mix(const std::array<uint64_t, 2>& seed, uint64_t value) noexcept;
+	public:
+		using is_transparent = void;
+
+		SeededHash();
+		SeededHash(const uint64_t seed0, const uint64_t seed1);
+
+		template <class KeyLike>
+		size_t operator()(const KeyLike& key) const noexcept;
+	};
+
+	/*
+	* open addressing hash table in the style of Abseil's Swiss tables
+	* every slot has a control byte: empty, deleted, or the low 7 bits of the hash of its key,
+	* slots are grouped by 16 and a lookup compares the 7 hash bits against a whole group at once (SSE2 when available),
+	* so most probes touch one cache line of control bytes and compare at most one key
+	* groups are probed triangularly starting at the group picked by the high bits of the hash, a lookup stops at a group with an empty slot
+	* erased slots become tombstones unless their group still has an empty slot, the table rehashes once 7/8 of the slots are used
+	* relies on a well mixed hash such as SeededHash, identity hashes put many keys behind the same 7 bits
+	* has the subset of the std::unordered_map interface LinkedUnorderedMap uses, so it can back its index
+	* iterators and references are invalidated by any insertion that rehashes, the key of an element must not be modified
+	*/
+	template <class K, class T, class Hash = SeededHash, class KeyEqual = std::equal_to<K>>
+	class SwissTable
+	{
+	public:
+		using key_type = K;
+		using mapped_type = T;
+		using value_type = std::pair<K, T>;
+	private:
+		static constexpr size_t GROUP_WIDTH = 16;
+		static constexpr int8_t EMPTY = -128;
+		static constexpr int8_t DELETED = -2;
+
+		union Slot {
+			value_type value;
+
+			Slot() {}
+			~Slot() {}
+		};
+
+		// one group of control bytes, each match returns a bitmask with bit i set for a matching byte i
+		class Group {
+			const int8_t* m_control;
+		public:
+			explicit Group(const int8_t* control);
+
+			uint32_t match(const int8_t h2) const;
+			uint32_t matchEmpty() const;
+			uint32_t matchEmptyOrDeleted() const;
+		};
+
+		std::unique_ptr<int8_t[]> m_control;
+		std::unique_ptr<Slot[]> m_slots;
+		size_t m_numGroups;
+		size_t m_size;
+		size_t m_growthLeft;
+		Hash m_hash;
+		KeyEqual m_equal;
+
+		size_t capacity() const noexcept;
+		static size_t maxLoad(const size_t capacity) noexcept;
+		static int8_t h2Of(const size_t hash) noexcept;
+		// capacity() when the key is missing
+		template <class KeyLike>
+		size_t findIndex(const KeyLike& key, const size_t hash) const;
+		size_t findInsertIndex(const size_t hash) const;
+		void setControl(const size_t index, const int8_t control);
+		void rehash(const size_t numGroups);
+		void destroyAll();
+
+		template <bool IsConst>
+		class Iterator {
+			friend class SwissTable;
+			template <bool>
+			friend class Iterator;
+
+			std::conditional_t<IsConst, const SwissTable*, SwissTable*> m_table;
+			size_t m_index;
+
+			Iterator(std::conditional_t<IsConst, const SwissTable*, SwissTable*> table, const size_t index);
+			void skipToFull();
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using difference_type = std::ptrdiff_t;
+			using value_type = typename SwissTable::value_type;
+			using reference = std::conditional_t<IsConst, const value_type&, value_type&>;
+			using pointer = std::conditional_t<IsConst, const value_type*, value_type*>;
+
+			Iterator();
+			template <bool WasConst, class = std::enable_if_t<IsConst && !WasConst>>
+			Iterator(const Iterator<WasConst>& other);
+
+			reference operator*() const;
+			pointer operator->() const;
+			Iterator& operator++();
+			Iterator operator++(int);
+			friend bool operator==(const Iterator& a, const Iterator& b) { return a.m_index == b.m_index; }
+			friend bool operator!=(const Iterator& a, const Iterator& b) { return a.m_index != b.m_index; }
+		};
+	public:
+		using iterator = Iterator<false>;
+		using const_iterator = Iterator<true>;
+
+		SwissTable();
+		SwissTable(const SwissTable&) = delete;
+		SwissTable& operator=(const SwissTable&) = delete;
+		~SwissTable();
+
+		size_t size() const noexcept;
+		bool empty() const noexcept;
+		void reserve(const size_t count);
+		void clear();
+
+		template <class KeyLike>
+		iterator find(const KeyLike& key);
+		template <class KeyLike>
+		const_iterator find(const KeyLike& key) const;
+		template <class KeyLike>
+		bool contains(const KeyLike& key) const;
+		// pulls the control bytes and slots the key probes first into cache ahead of a find
+		template <class KeyLike>
+		void prefetch(const KeyLike& key) const;
+
+		template <class KeyArg, class ...Args>
+		std::pair<iterator, bool> emplace(KeyArg&& key, Args&&... args);
+		iterator erase(iterator it);
+		iterator erase(const_iterator it);
+		template <class KeyLike>
+		size_t erase(const KeyLike& key);
+
+		iterator begin();
+		iterator end();
+		const_iterator begin() const;
+		const_iterator end() const;
+		const_iterator cbegin() const;
+		const_iterator cend() const;
+	};
+}
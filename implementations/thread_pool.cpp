@@ -0,0 +1,69 @@
+#include "thread_pool.h"
+
+#include <stdexcept>
+
+namespace implementations {
+	inline ThreadPool::ThreadPool(const size_t numThreads, const size_t maxQueued)
+		: m_workers()
+		, m_tasks()
+		, m_maxQueued(maxQueued)
+		, m_isStopping(false)
+		, m_mutex()
+		, m_hasWork() {
+		if (numThreads == 0) {
+			throw std::invalid_argument("Thread pool needs at least one thread");
+		}
+		m_workers.reserve(numThreads);
+		for (size_t i = 0; i < numThreads; i++) {
+			m_workers.emplace_back([this]() { run(); });
+		}
+	}
+
+	inline ThreadPool::~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_isStopping = true;
+		}
+		m_hasWork.notify_all();
+		for (std::thread& worker : m_workers) {
+			worker.join();
+		}
+	}
+
+	inline void ThreadPool::run() {
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_hasWork.wait(lock, [this]() { return m_isStopping || !m_tasks.empty(); });
+				if (m_tasks.empty()) {
+					return;
+				}
+				task = std::move(m_tasks.front());
+				m_tasks.pop_front();
+			}
+			task();
+		}
+	}
+
+	inline size_t ThreadPool::numThreads() const noexcept {
+		return m_workers.size();
+	}
+
+	inline size_t ThreadPool::numQueued() const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_tasks.size();
+	}
+
+	inline bool ThreadPool::trySubmit(std::function<void()> task) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_isStopping || m_tasks.size() >= m_maxQueued) {
+				return false;
+			}
+			m_tasks.push_back(std::move(task));
+		}
+		m_hasWork.notify_one();
+		return true;
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace implementations {
+	/*
+	* fixed number of worker threads fed from a bounded queue
+	* trySubmit refuses work instead of blocking once the queue is full, so bursts of best effort work
+	* (eg cache refreshes) are shed rather than piling up behind slow tasks
+	* tasks must not throw, destruction runs the tasks already queued and joins the workers
+	*/
+	class ThreadPool
+	{
+		std::vector<std::thread> m_workers;
+		std::deque<std::function<void()>> m_tasks;
+		const size_t m_maxQueued;
+		bool m_isStopping;
+		mutable std::mutex m_mutex;
+		std::condition_variable m_hasWork;
+
+		void run();
+	public:
+		ThreadPool(const size_t numThreads, const size_t maxQueued);
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		~ThreadPool();
+
+		size_t numThreads() const noexcept;
+		size_t numQueued() const;
+		// false when the queue is full
+		bool trySubmit(std::function<void()> task);
+	};
+}
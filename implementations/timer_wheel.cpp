@@ -0,0 +1,120 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace implementations {
+	template <class T>
+	TimerWheel<T>::TimerWheel(const uint64_t now)
+		: m_slots(), m_occupied(), m_now(now), m_size(0) {}
+
+	template <class T>
+	uint64_t TimerWheel<T>::now() const noexcept {
+		return m_now;
+	}
+
+	template <class T>
+	size_t TimerWheel<T>::size() const noexcept {
+		return m_size;
+	}
+
+	template <class T>
+	bool TimerWheel<T>::empty() const noexcept {
+		return m_size == 0;
+	}
+
+	template <class T>
+	void TimerWheel<T>::place(Slot& source, const typename Slot::iterator timer) {
+		const uint64_t expiry = std::max(timer->expiry, m_now);
+		const uint64_t delta = expiry - m_now;
+		size_t level = 0;
+		while (level + 1 < NUM_LEVELS && delta >= (uint64_t(1) << (BITS_PER_LEVEL * (level + 1)))) {
+			level++;
+		}
+		// timers beyond the range of the wheel are parked in the furthest slot and placed again when it cascades
+		const uint64_t range = uint64_t(1) << (BITS_PER_LEVEL * NUM_LEVELS);
+		const uint64_t slotTick = delta >= range ? m_now + range - 1 : expiry;
+		const size_t slot = (slotTick >> (BITS_PER_LEVEL * level)) & SLOT_MASK;
+		timer->level = level;
+		timer->slot = slot;
+		m_slots[level][slot].splice(m_slots[level][slot].end(), source, timer);
+		m_occupied[level] |= uint64_t(1) << slot;
+	}
+
+	template <class T>
+	void TimerWheel<T>::cascade(const size_t level) {
+		const size_t slot = (m_now >> (BITS_PER_LEVEL * level)) & SLOT_MASK;
+		if (slot == 0 && level + 1 < NUM_LEVELS) {
+			cascade(level + 1);
+		}
+		if (!(m_occupied[level] & (uint64_t(1) << slot))) {
+			return;
+		}
+		Slot cascading;
+		cascading.splice(cascading.end(), m_slots[level][slot]);
+		m_occupied[level] &= ~(uint64_t(1) << slot);
+		while (!cascading.empty()) {
+			place(cascading, cascading.begin());
+		}
+	}
+
+	template <class T>
+	template <class Callback>
+	size_t TimerWheel<T>::fire(const size_t slot, Callback& onExpired) {
+		if (!(m_occupied[0] & (uint64_t(1) << slot))) {
+			return 0;
+		}
+		Slot expired;
+		expired.splice(expired.end(), m_slots[0][slot]);
+		m_occupied[0] &= ~(uint64_t(1) << slot);
+		m_size -= expired.size();
+		for (const Timer& timer : expired) {
+			onExpired(timer.payload);
+		}
+		return expired.size();
+	}
+
+	template <class T>
+	typename TimerWheel<T>::Handle TimerWheel<T>::schedule(const T& payload, const uint64_t expiry) {
+		Slot pending;
+		pending.push_back(Timer{ payload, std::max(expiry, m_now + 1), 0, 0 });
+		const Handle handle = pending.begin();
+		place(pending, handle);
+		m_size++;
+		return handle;
+	}
+
+	template <class T>
+	void TimerWheel<T>::cancel(const Handle handle) {
+		const size_t level = handle->level;
+		const size_t slotIndex = handle->slot;
+		Slot& slot = m_slots[level][slotIndex];
+		slot.erase(handle);
+		if (slot.empty()) {
+			m_occupied[level] &= ~(uint64_t(1) << slotIndex);
+		}
+		m_size--;
+	}
+
+	template <class T>
+	template <class Callback>
+	size_t TimerWheel<T>::advance(const uint64_t now, Callback&& onExpired) {
+		size_t numFired = 0;
+		while (m_now < now) {
+			if (m_size == 0) {
+				m_now = now;
+				break;
+			}
+			// jump straight to the next occupied level 0 slot, stopping at the block boundary to cascade
+			const uint64_t index = m_now & SLOT_MASK;
+			const uint64_t laterSlots = index == SLOT_MASK ? 0 : m_occupied[0] & ~((uint64_t(2) << index) - 1);
+			const uint64_t next = laterSlots ? (m_now & ~SLOT_MASK) + std::countr_zero(laterSlots) : (m_now | SLOT_MASK) + 1;
+			m_now = std::min(next, now);
+			if ((m_now & SLOT_MASK) == 0) {
+				cascade(1);
+			}
+			numFired += fire(m_now & SLOT_MASK, onExpired);
+		}
+		return numFired;
+	}
+}
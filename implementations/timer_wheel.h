@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+
+namespace implementations {
+	/*
+	* hierarchical timer wheel, time is measured in integer ticks
+	* each level has 64 slots, a slot on level n spans 64^n ticks
+	* O(1) schedule, O(1) cancel, each timer is cascaded at most once per level before it fires
+	* an occupancy bitmap per level lets advance skip empty slots instead of visiting every tick
+	*/
+	template <class T>
+	class TimerWheel
+	{
+		static constexpr size_t BITS_PER_LEVEL = 6;
+		static constexpr size_t SLOTS_PER_LEVEL = size_t(1) << BITS_PER_LEVEL;
+		static constexpr uint64_t SLOT_MASK = SLOTS_PER_LEVEL - 1;
+		static constexpr size_t NUM_LEVELS = 5;
+
+		struct Timer {
+			T payload;
+			uint64_t expiry;
+			size_t level;
+			size_t slot;
+		};
+		using Slot = std::list<Timer>;
+
+		std::array<std::array<Slot, SLOTS_PER_LEVEL>, NUM_LEVELS> m_slots;
+		std::array<uint64_t, NUM_LEVELS> m_occupied;
+		uint64_t m_now;
+		size_t m_size;
+
+		void place(Slot& source, const typename Slot::iterator timer);
+		void cascade(const size_t level);
+		template <class Callback>
+		size_t fire(const size_t slot, Callback& onExpired);
+	public:
+		using Handle = typename Slot::iterator;
+
+		TimerWheel(const uint64_t now = 0);
+
+		uint64_t now() const noexcept;
+		size_t size() const noexcept;
+		bool empty() const noexcept;
+
+		Handle schedule(const T& payload, const uint64_t expiry);
+		void cancel(const Handle handle);
+
+		// fires every timer with expiry <= now, calling onExpired(payload) for each
+		template <class Callback>
+		size_t advance(const uint64_t now, Callback&& onExpired);
+	};
+}
@@ -0,0 +1,134 @@
+#include "two_tier_lru_cache.h"
+
+#include "lru_cache.h"
+#include "lz_codec.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+namespace implementations {
+	template <class V>
+	std::string ValueBytes<V>::toBytes(const V& value) {
+		if constexpr (std::is_convertible_v<const V&, std::string_view>) {
+			return std::string(std::string_view(value));
+		}
+		else {
+			static_assert(std::is_trivially_copyable_v<V>, "specialise ValueBytes for this value type");
+			return std::string(reinterpret_cast<const char*>(&value), sizeof(V));
+		}
+	}
+
+	template <class V>
+	V ValueBytes<V>::fromBytes(std::string_view bytes) {
+		if constexpr (std::is_convertible_v<const V&, std::string_view>) {
+			return V(bytes);
+		}
+		else {
+			if (bytes.size() != sizeof(V)) {
+				throw std::runtime_error("Stored value has the wrong size");
+			}
+			V value;
+			std::memcpy(&value, bytes.data(), sizeof(V));
+			return value;
+		}
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Serializer>
+	TwoTierLruCache<K, V, Hash, KeyEqual, Serializer>::TwoTierLruCache(const size_t hotCapacity, const size_t coldCapacityBytes)
+		: TwoTierLruCache(hotCapacity, [](const K&, const V&) -> size_t { return 1; }, coldCapacityBytes) {}
+
+	template <class K, class V, class Hash, class KeyEqual, class Serializer>
+	TwoTierLruCache<K, V, Hash, KeyEqual, Serializer>::TwoTierLruCache(const size_t hotCapacity, typename LruCache<K, V, Hash, KeyEqual>::Weigher hotWeigher, const size_t coldCapacityBytes)
+		: m_hot(hotCapacity, std::move(hotWeigher))
+		, m_cold(coldCapacityBytes, [](const K&, const std::string& compressed) { return compressed.size(); })
+		, m_mutex()
+		, m_hotHits(0)
+		, m_coldHits(0)
+		, m_misses(0)
+		, m_demotions(0) {
+		m_hot.setEvictionListener([this](const K& key, V&& value, const EvictionCause cause) {
+			if (cause == EvictionCause::Capacity) {
+				demote(key, value);
+			}
+		});
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Serializer>
+	void TwoTierLruCache<K, V, Hash, KeyEqual, Serializer>::demote(const K& key, const V& value)
+	{
+		m_cold.push(key, LzCodec::compress(Serializer::toBytes(value)));
+		m_demotions.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Serializer>
+	size_t TwoTierLruCache<K, V, Hash, KeyEqual, Serializer>::size() const
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		return m_hot.size() + m_cold.size();
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Serializer>
+	bool TwoTierLruCache<K, V, Hash, KeyEqual, Serializer>::empty() const
+	{
+		return size() == 0;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Serializer>
+	bool TwoTierLruCache<K, V, Hash, KeyEqual, Serializer>::hasKey(const K& key) const
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		return m_hot.hasKey(key) || m_cold.hasKey(key);
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Serializer>
+	std::optional<V> TwoTierLruCache<K, V, Hash, KeyEqual, Serializer>::get(const K& key)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		if (std::optional<V> value = m_hot.getIfPresent(key)) {
+			m_hotHits.fetch_add(1, std::memory_order_relaxed);
+			return value;
+		}
+		std::optional<std::string> compressed = m_cold.remove(key);
+		if (!compressed) {
+			m_misses.fetch_add(1, std::memory_order_relaxed);
+			return std::nullopt;
+		}
+		m_coldHits.fetch_add(1, std::memory_order_relaxed);
+		V value = Serializer::fromBytes(LzCodec::decompress(*compressed));
+		m_hot.push(key, value);
+		return value;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Serializer>
+	void TwoTierLruCache<K, V, Hash, KeyEqual, Serializer>::push(const K& key, const V& value)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		m_cold.remove(key);
+		m_hot.push(key, value);
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Serializer>
+	bool TwoTierLruCache<K, V, Hash, KeyEqual, Serializer>::remove(const K& key)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		const bool wasHot = m_hot.remove(key).has_value();
+		const bool wasCold = m_cold.remove(key).has_value();
+		return wasHot || wasCold;
+	}
+
+	template <class K, class V, class Hash, class KeyEqual, class Serializer>
+	TwoTierStats TwoTierLruCache<K, V, Hash, KeyEqual, Serializer>::stats() const
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		return TwoTierStats{
+			m_hotHits.load(std::memory_order_relaxed),
+			m_coldHits.load(std::memory_order_relaxed),
+			m_misses.load(std::memory_order_relaxed),
+			m_demotions.load(std::memory_order_relaxed),
+			m_hot.size(),
+			m_cold.size(),
+			m_cold.weight()
+		};
+	}
+}
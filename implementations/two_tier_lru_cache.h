@@ -0,0 +1,66 @@
+#pragma once
+
+#include "lru_cache.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace implementations {
+	// converts values to bytes for the compressed tier, specialise it for values that are neither strings nor trivially copyable
+	template <class V>
+	struct ValueBytes {
+		static std::string toBytes(const V& value);
+		static V fromBytes(std::string_view bytes);
+	};
+
+	struct TwoTierStats {
+		uint64_t hotHits;
+		uint64_t coldHits;
+		uint64_t misses;
+		uint64_t demotions;
+		size_t hotSize;
+		size_t coldSize;
+		size_t compressedBytes;
+	};
+
+	/*
+	* LRU cache with a compressed second tier
+	* entries evicted from the head of the hot LruCache for capacity are compressed with LzCodec and kept in a cold LruCache
+	* weighed by compressed size, so the cold budget is in bytes; expired entries are dropped rather than demoted
+	* a cold hit decompresses the value and promotes it back into the hot tier, which may demote another entry in turn
+	* a key lives in at most one tier
+	*/
+	template <class K, class V, class Hash = std::hash<K>, class KeyEqual = std::equal_to<K>, class Serializer = ValueBytes<V>>
+	class TwoTierLruCache
+	{
+		LruCache<K, V, Hash, KeyEqual> m_hot;
+		LruCache<K, std::string, Hash, KeyEqual> m_cold;
+		mutable std::recursive_mutex m_mutex;
+		std::atomic<uint64_t> m_hotHits;
+		std::atomic<uint64_t> m_coldHits;
+		std::atomic<uint64_t> m_misses;
+		std::atomic<uint64_t> m_demotions;
+
+		void demote(const K& key, const V& value);
+	public:
+		TwoTierLruCache(const size_t hotCapacity, const size_t coldCapacityBytes);
+		TwoTierLruCache(const size_t hotCapacity, typename LruCache<K, V, Hash, KeyEqual>::Weigher hotWeigher, const size_t coldCapacityBytes);
+		// the hot tier's eviction listener points back at this cache
+		TwoTierLruCache(const TwoTierLruCache&) = delete;
+		TwoTierLruCache& operator=(const TwoTierLruCache&) = delete;
+
+		size_t size() const;
+		bool empty() const;
+		bool hasKey(const K& key) const;
+		std::optional<V> get(const K& key);
+
+		void push(const K& key, const V& value);
+		bool remove(const K& key);
+		TwoTierStats stats() const;
+	};
+}
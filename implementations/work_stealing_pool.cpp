@@ -0,0 +1,159 @@
+#include "work_stealing_pool.h"
+
+#include <stdexcept>
+
+namespace implementations {
+	inline WorkStealingPool::TaskGroup::TaskGroup(WorkStealingPool& pool)
+		: m_pool(pool)
+		, m_numPending(0)
+		, m_errorMutex()
+		, m_error() {}
+
+	inline WorkStealingPool::TaskGroup::~TaskGroup() {
+		try {
+			wait();
+		}
+		catch (...) {
+			// a destructor must not throw, a caller that wants the error calls wait
+		}
+	}
+
+	inline void WorkStealingPool::TaskGroup::spawn(std::function<void()> task) {
+		m_numPending.fetch_add(1, std::memory_order_relaxed);
+		m_pool.push([this, task = std::move(task)]() {
+			try {
+				task();
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(m_errorMutex);
+				if (!m_error) {
+					m_error = std::current_exception();
+				}
+			}
+			m_numPending.fetch_sub(1, std::memory_order_acq_rel);
+		});
+	}
+
+	inline void WorkStealingPool::TaskGroup::wait() {
+		while (m_numPending.load(std::memory_order_acquire) > 0) {
+			if (!m_pool.tryRunOne()) {
+				std::this_thread::yield();
+			}
+		}
+		std::lock_guard<std::mutex> lock(m_errorMutex);
+		if (m_error) {
+			std::exception_ptr error = m_error;
+			m_error = nullptr;
+			std::rethrow_exception(error);
+		}
+	}
+
+	inline WorkStealingPool::WorkStealingPool(const size_t numThreads)
+		: m_queues()
+		, m_workers()
+		, m_numQueued(0)
+		, m_numIdle(0)
+		, m_isStopping(false)
+		, m_sleepMutex()
+		, m_hasWork() {
+		if (numThreads == 0) {
+			throw std::invalid_argument("Work stealing pool needs at least one thread");
+		}
+		for (size_t i = 0; i <= numThreads; i++) {
+			m_queues.push_back(std::make_unique<Queue>());
+		}
+		m_workers.reserve(numThreads);
+		for (size_t i = 0; i < numThreads; i++) {
+			m_workers.emplace_back([this, i]() { run(i); });
+		}
+	}
+
+	inline WorkStealingPool::~WorkStealingPool() {
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_isStopping = true;
+		}
+		m_hasWork.notify_all();
+		for (std::thread& worker : m_workers) {
+			worker.join();
+		}
+	}
+
+	inline size_t WorkStealingPool::numThreads() const noexcept {
+		return m_workers.size();
+	}
+
+	inline bool WorkStealingPool::isHungry() const noexcept {
+		return m_numIdle.load(std::memory_order_relaxed) > m_numQueued.load(std::memory_order_relaxed);
+	}
+
+	inline WorkStealingPool::Worker& WorkStealingPool::currentWorker() noexcept {
+		thread_local Worker worker{ nullptr, 0 };
+		return worker;
+	}
+
+	inline size_t WorkStealingPool::homeQueue() const noexcept {
+		const Worker& worker = currentWorker();
+		return worker.pool == this ? worker.queueIndex : m_queues.size() - 1;
+	}
+
+	inline void WorkStealingPool::push(std::function<void()> task) {
+		// counted before it is visible, so the count never drops below the number of tasks a thief can find
+		m_numQueued.fetch_add(1);
+		Queue& queue = *m_queues[homeQueue()];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.tasks.push_back(std::move(task));
+		}
+		// sequentially consistent with the worker announcing itself idle, so one of the two sees the other
+		if (m_numIdle.load() > 0) {
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_hasWork.notify_one();
+		}
+	}
+
+	inline bool WorkStealingPool::tryRunOne() {
+		if (m_numQueued.load(std::memory_order_acquire) == 0) {
+			return false;
+		}
+		const size_t home = homeQueue();
+		std::function<void()> task;
+		for (size_t offset = 0; offset < m_queues.size() && !task; offset++) {
+			Queue& queue = *m_queues[(home + offset) % m_queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.tasks.empty()) {
+				continue;
+			}
+			if (offset == 0) {
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+			}
+			else {
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+			}
+		}
+		if (!task) {
+			return false;
+		}
+		m_numQueued.fetch_sub(1, std::memory_order_relaxed);
+		task();
+		return true;
+	}
+
+	inline void WorkStealingPool::run(const size_t index) {
+		currentWorker() = Worker{ this, index };
+		while (true) {
+			if (tryRunOne()) {
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_numIdle.fetch_add(1);
+			m_hasWork.wait(lock, [this]() { return m_isStopping || m_numQueued.load() > 0; });
+			m_numIdle.fetch_sub(1);
+			if (m_isStopping && m_numQueued.load() == 0) {
+				return;
+			}
+		}
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace implementations {
+	/*
+	* fixed number of worker threads for fork-join work, eg parallel tree traversals
+	* every worker has its own deque: it pushes and pops its own tasks at the back, so it keeps working on the subtree
+	* it just split, and idle workers steal from the front of the others, where the oldest and largest pieces of work sit
+	* threads outside the pool push to a shared injection queue
+	* a thread waiting on a TaskGroup runs queued tasks until its group is done instead of blocking,
+	* so tasks can spawn and wait on subtasks at any depth without starving the pool
+	* isHungry tells a running task that a worker is idle, so work is split on demand rather than up front
+	*/
+	class WorkStealingPool
+	{
+		struct Queue {
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		// one queue per worker, the last one is the injection queue for threads outside the pool
+		std::vector<std::unique_ptr<Queue>> m_queues;
+		std::vector<std::thread> m_workers;
+		std::atomic<size_t> m_numQueued;
+		std::atomic<size_t> m_numIdle;
+		bool m_isStopping;
+		std::mutex m_sleepMutex;
+		std::condition_variable m_hasWork;
+
+		// the pool and queue of the worker running on the calling thread, pool is nullptr outside any pool
+		struct Worker {
+			const WorkStealingPool* pool;
+			size_t queueIndex;
+		};
+
+		static Worker& currentWorker() noexcept;
+		// index of the calling thread's queue
+		size_t homeQueue() const noexcept;
+		void push(std::function<void()> task);
+		// pops from the home queue, else steals from another, false when every queue is empty
+		bool tryRunOne();
+		void run(const size_t index);
+	public:
+		// tasks spawned together and waited on together, the destructor waits so tasks can refer to the caller's locals
+		class TaskGroup {
+			WorkStealingPool& m_pool;
+			std::atomic<size_t> m_numPending;
+			std::mutex m_errorMutex;
+			std::exception_ptr m_error;
+		public:
+			explicit TaskGroup(WorkStealingPool& pool);
+			TaskGroup(const TaskGroup&) = delete;
+			TaskGroup& operator=(const TaskGroup&) = delete;
+			~TaskGroup();
+
+			void spawn(std::function<void()> task);
+			// helps run queued tasks until every task of the group has finished, rethrows the first exception one threw
+			void wait();
+		};
+
+		explicit WorkStealingPool(const size_t numThreads);
+		WorkStealingPool(const WorkStealingPool&) = delete;
+		WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+		~WorkStealingPool();
+
+		size_t numThreads() const noexcept;
+		// true while more workers are idle than there are tasks queued for them
+		bool isHungry() const noexcept;
+	};
+}
@@ -0,0 +1,173 @@
+#include "pch.h"
+
+#include "../implementations/concurrency_policy.cpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace implementations;
+
+TEST(EpochManagerTest, RetiredObjectOutlivesReaderOfItsEpoch) {
+	// GIVEN
+	EpochManager epochs;
+	auto object = std::make_shared<int>(1);
+	const std::weak_ptr<int> observer = object;
+
+	// WHEN
+	auto guard = std::make_unique<EpochManager::Guard>(epochs);
+	epochs.retire(std::move(object));
+	const bool advancedWhileReading = epochs.tryAdvance();
+	const bool aliveWhileReading = !observer.expired();
+	guard.reset();
+	const bool advancedAfterReading = epochs.tryAdvance();
+
+	// THEN
+	EXPECT_FALSE(advancedWhileReading);
+	EXPECT_TRUE(aliveWhileReading);
+	EXPECT_TRUE(advancedAfterReading);
+	EXPECT_TRUE(observer.expired());
+	EXPECT_EQ(0, epochs.numRetired());
+}
+
+TEST(EpochManagerTest, RetiredObjectIsFreedTwoEpochsLater) {
+	// GIVEN
+	EpochManager epochs;
+	auto object = std::make_shared<int>(1);
+	const std::weak_ptr<int> observer = object;
+
+	// WHEN
+	epochs.retire(std::move(object));
+	const bool aliveAfterRetire = !observer.expired();
+	epochs.tryAdvance();
+
+	// THEN
+	EXPECT_TRUE(aliveAfterRetire);
+	EXPECT_TRUE(observer.expired());
+	EXPECT_EQ(2, epochs.epoch());
+}
+
+TEST(EpochManagerTest, PinnedReaderBoundsTheRetiredObjects) {
+	// GIVEN
+	EpochManager epochs;
+	std::promise<void> isPinned;
+	std::promise<void> canLeave;
+	std::thread reader([&epochs, &isPinned, &canLeave]() {
+		EpochManager::Guard guard(epochs);
+		isPinned.set_value();
+		canLeave.get_future().wait();
+	});
+	isPinned.get_future().wait();
+	size_t maxRetired = 0;
+
+	// WHEN
+	std::thread writer([&epochs, &maxRetired]() {
+		for (size_t i = 0; i < 2 * EpochManager::MAX_RETIRED; i++) {
+			epochs.retire(std::make_shared<size_t>(i));
+			maxRetired = std::max(maxRetired, epochs.numRetired());
+		}
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	canLeave.set_value();
+	reader.join();
+	writer.join();
+
+	// THEN
+	EXPECT_LE(maxRetired, EpochManager::MAX_RETIRED);
+}
+
+TEST(RcuShardedIndexTest, InsertFindErase) {
+	// GIVEN
+	EpochManager epochs;
+	RcuShardedIndex<std::string, int, std::hash<std::string>, std::equal_to<std::string>> index;
+
+	// WHEN
+	for (int i = 0; i < 100; i++) {
+		index.insert(std::to_string(i), i + 1, epochs);
+	}
+	index.erase(std::string("7"), epochs);
+	index.erase(std::string("missing"), epochs);
+	index.insert("8", 80, epochs);
+
+	// THEN
+	EpochManager::Guard guard(epochs);
+	EXPECT_EQ(1, index.find(std::string("0")));
+	EXPECT_EQ(100, index.find(std::string("99")));
+	EXPECT_EQ(0, index.find(std::string("7")));
+	EXPECT_EQ(80, index.find(std::string("8")));
+}
+
+TEST(RcuShardedIndexTest, GrowsWithoutLosingKeys) {
+	// GIVEN
+	EpochManager epochs;
+	RcuShardedIndex<int, int, std::hash<int>, std::equal_to<int>> index;
+
+	// WHEN
+	for (int key = 0; key < 100000; key++) {
+		index.insert(key, key + 1, epochs);
+	}
+	for (int key = 0; key < 100000; key += 3) {
+		index.erase(key, epochs);
+	}
+	for (int key = 1; key < 100000; key += 3) {
+		index.insert(key, -key, epochs);
+	}
+
+	// THEN
+	EpochManager::Guard guard(epochs);
+	size_t numMismatches = 0;
+	for (int key = 0; key < 100000; key++) {
+		const int expected = key % 3 == 0 ? 0 : (key % 3 == 1 ? -key : key + 1);
+		if (index.find(key) != expected) {
+			numMismatches++;
+		}
+	}
+	EXPECT_EQ(0, numMismatches);
+	EXPECT_LE(epochs.numRetired(), EpochManager::MAX_RETIRED);
+}
+
+TEST(RcuShardedIndexTest, ReadersRunConcurrentlyWithWriter) {
+	// GIVEN
+	EpochManager epochs;
+	RcuShardedIndex<int, int, std::hash<int>, std::equal_to<int>> index;
+	std::atomic<bool> isWriting = true;
+	std::atomic<size_t> numMismatches = 0;
+
+	// WHEN
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 4; r++) {
+		readers.emplace_back([&]() {
+			while (isWriting) {
+				for (int key = 0; key < 256; key++) {
+					EpochManager::Guard guard(epochs);
+					const int value = index.find(key);
+					if (value != 0 && value != key + 1) {
+						numMismatches++;
+					}
+				}
+			}
+		});
+	}
+	for (int round = 0; round < 20; round++) {
+		for (int key = 0; key < 256; key++) {
+			index.insert(key, key + 1, epochs);
+		}
+		for (int key = 0; key < 256; key += 2) {
+			index.erase(key, epochs);
+		}
+	}
+	isWriting = false;
+	for (std::thread& reader : readers) {
+		reader.join();
+	}
+
+	// THEN
+	EXPECT_EQ(0, numMismatches);
+	EpochManager::Guard guard(epochs);
+	EXPECT_EQ(0, index.find(0));
+	EXPECT_EQ(2, index.find(1));
+}
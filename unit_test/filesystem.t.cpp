@@ -1,6 +1,24 @@
 #include "pch.h"
 
 #include "../implementations/filesystem.cpp"
+#include "../implementations/linked_unordered_map.cpp"
+#include "../implementations/concurrency_policy.cpp"
+#include "../implementations/work_stealing_pool.cpp"
+#include "../implementations/name_index.cpp"
+#include "../implementations/slab_arena.cpp"
+#include "../implementations/mapped_file.cpp"
+#include "../implementations/mpsc_queue.cpp"
+#include "../implementations/string_pool.cpp"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace implementations;
 
@@ -64,8 +82,8 @@ TEST(FileSystemTest, ChangeToSiblingDirectory) {
 	// THEN
 	EXPECT_EQ("inner", pwd->name);
 	EXPECT_EQ("inner2", siblingPwd->name);
-	EXPECT_EQ("test", pwd->parent->name);
-	EXPECT_EQ("test", siblingPwd->parent->name);
+	EXPECT_EQ("test", pwd->parent.lock()->name);
+	EXPECT_EQ("test", siblingPwd->parent.lock()->name);
 }
 
 TEST(FileSystemTest, CreateFileRecursively) {
@@ -137,7 +155,7 @@ TEST(FileSystemTest, CopyDirectory) {
 	ASSERT_EQ(1, pwd->childDirs["test"]->childDirs.size());
 	EXPECT_TRUE(pwd->childDirs["test"]->childDirs.find("subtest") != pwd->childDirs["test"]->childDirs.cend());
 	ASSERT_TRUE(pwd->childDirs.find("test2") != pwd->childDirs.cend());
-	EXPECT_TRUE(pwd->childDirs["test2"]->files.find("test1.txt") != pwd->childDirs["test2"]->files.cend());
+	EXPECT_EQ("test2\n\ttest1.txt", filesystem.printTree("/test2"));
 }
 
 TEST(FileSystemTest, PrintTree) {
@@ -211,4 +229,1208 @@ TEST(FileSystemTest, FindFileParallel) {
 	EXPECT_EQ("/a/b/c/d/e/f.txt", foundPaths[0]);
 	EXPECT_EQ("/a/g/f.txt", foundPaths[1]);
 	EXPECT_EQ("/a/h/i/f.txt", foundPaths[2]);
-}
\ No newline at end of file
+}
+
+TEST(FileSystemTest, ResolvesRedundantSeparators) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("a/b/c.txt", false, true);
+
+	// WHEN
+	const auto dir = filesystem.changeDirectory("//a/./b/");
+
+	// THEN
+	EXPECT_EQ("b", dir->name);
+	EXPECT_EQ("/a/b", filesystem.getCurrentPath());
+	EXPECT_THROW(filesystem.makeFile("/", false), std::invalid_argument);
+}
+
+TEST(FileSystemTest, MovedDirectoryIsNotResolvedFromCache) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("a/b/c/d.txt", false, true);
+	const auto cached = filesystem.changeDirectory("/a/b/c");
+	filesystem.changeDirectory("/");
+
+	// WHEN
+	filesystem.moveFile("/a/b", "/x");
+
+	// THEN
+	EXPECT_THROW(filesystem.changeDirectory("/a/b/c"), std::invalid_argument);
+	EXPECT_EQ(cached, filesystem.changeDirectory("/x/c"));
+}
+
+TEST(FileSystemTest, RemovedDirectoryIsNotResolvedFromCache) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("a/b/c.txt", false, true);
+	filesystem.printTree("/a/b");
+
+	// WHEN
+	filesystem.removeFile("/a/b");
+	filesystem.makeFile("/a/b", true);
+
+	// THEN
+	EXPECT_EQ("b", filesystem.printTree("/a/b"));
+}
+
+TEST(FileSystemTest, RelativePathsAreCachedPerDirectory) {
+	// GIVEN
+	FileSystem filesystem(2);
+	filesystem.makeFile("a/inner/x.txt", false, true);
+	filesystem.makeFile("b/inner/y.txt", false, true);
+
+	// WHEN
+	filesystem.changeDirectory("/a");
+	const std::string treeA = filesystem.printTree("inner");
+	filesystem.changeDirectory("/b");
+	const std::string treeB = filesystem.printTree("inner");
+
+	// THEN
+	EXPECT_EQ("inner\n\tx.txt", treeA);
+	EXPECT_EQ("inner\n\ty.txt", treeB);
+}
+
+TEST(FileSystemTest, ConcurrentLookupsThroughAFullCache) {
+	// GIVEN
+	FileSystem filesystem(16);
+	const size_t numDirs = 64;
+	for (size_t i = 0; i < numDirs; i++) {
+		filesystem.makeFile("/d" + std::to_string(i) + "/f.txt", false, true);
+	}
+	filesystem.makeFile("/moving/g.txt", false, true);
+	std::atomic<bool> isMismatched(false);
+
+	// WHEN
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < 4; i++) {
+		threads.emplace_back([&filesystem, &isMismatched, i]() {
+			for (size_t j = 0; j < 2000; j++) {
+				// a few hot paths hit over and over, the rest evict each other
+				const size_t dir = j % 3 == 0 ? (i + j) % numDirs : j % 4;
+				if (filesystem.printTree("/d" + std::to_string(dir)) != "d" + std::to_string(dir) + "\n\tf.txt") {
+					isMismatched = true;
+				}
+			}
+		});
+	}
+	// every move invalidates the cached paths
+	for (size_t i = 0; i < 50; i++) {
+		filesystem.moveFile(i % 2 == 0 ? "/moving" : "/moved", i % 2 == 0 ? "/moved" : "/moving");
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	// THEN
+	EXPECT_FALSE(isMismatched);
+	EXPECT_EQ("moving\n\tg.txt", filesystem.printTree("/moving"));
+	EXPECT_THROW(filesystem.printTree("/moved"), std::invalid_argument);
+}
+
+TEST(FileSystemTest, MovedDirectoryKnowsItsNewParent) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("a/b/c.txt", false, true);
+	filesystem.makeFile("x", true);
+
+	// WHEN
+	filesystem.moveFile("/a/b", "/x/y");
+	filesystem.changeDirectory("/x/y");
+
+	// THEN
+	EXPECT_EQ("/x/y", filesystem.getCurrentPath());
+	EXPECT_EQ("x", filesystem.changeDirectory("..")->name);
+}
+
+TEST(FileSystemTest, CannotMoveDirectoryIntoItself) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("a/b/c", true, true);
+
+	// WHEN
+	EXPECT_THROW(filesystem.moveFile("/a", "/a/b/c/a"), std::invalid_argument);
+	EXPECT_THROW(filesystem.moveFile("/a/b", "/a/b/b"), std::invalid_argument);
+	filesystem.changeDirectory("/a/b/c");
+
+	// THEN
+	EXPECT_EQ("/a/b/c", filesystem.getCurrentPath());
+}
+
+TEST(FileSystemTest, ConcurrentWritersInSeparateSubtrees) {
+	// GIVEN
+	FileSystem filesystem;
+	const size_t numThreads = 4;
+	const size_t numFiles = 200;
+	std::vector<std::thread> threads;
+
+	// WHEN
+	for (size_t t = 0; t < numThreads; t++) {
+		threads.emplace_back([&filesystem, t]() {
+			const std::string dir = "/tenant" + std::to_string(t);
+			for (size_t i = 0; i < numFiles; i++) {
+				filesystem.makeFile(dir + "/sub" + std::to_string(i % 10) + "/f" + std::to_string(i), false, true);
+				if (i % 2 == 1) {
+					filesystem.removeFile(dir + "/sub" + std::to_string((i - 1) % 10) + "/f" + std::to_string(i - 1));
+				}
+			}
+		});
+	}
+	threads.emplace_back([&filesystem]() {
+		for (size_t i = 0; i < 50; i++) {
+			filesystem.printTree("/");
+			filesystem.findFile("f1");
+		}
+	});
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	// THEN
+	for (size_t t = 0; t < numThreads; t++) {
+		const std::string tree = filesystem.printTree("/tenant" + std::to_string(t));
+		EXPECT_EQ(numFiles / 2, std::count(tree.cbegin(), tree.cend(), 'f'));
+	}
+}
+
+TEST(FileSystemTest, OpposingMovesDoNotDeadlock) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("a/item", true, true);
+	filesystem.makeFile("b", true);
+	const size_t numMoves = 200;
+
+	// WHEN
+	std::thread forth([&filesystem]() {
+		for (size_t i = 0; i < numMoves; i++) {
+			try {
+				filesystem.moveFile("/a/item", "/b/item");
+			}
+			catch (const std::invalid_argument&) {}
+		}
+	});
+	std::thread back([&filesystem]() {
+		for (size_t i = 0; i < numMoves; i++) {
+			try {
+				filesystem.moveFile("/b/item", "/a/item");
+			}
+			catch (const std::invalid_argument&) {}
+		}
+	});
+	forth.join();
+	back.join();
+
+	// THEN
+	const std::string tree = filesystem.printTree("/");
+	EXPECT_EQ(1, std::count(tree.cbegin(), tree.cend(), 'i'));
+}
+
+TEST(FileSystemTest, SessionsHaveTheirOwnWorkingDirectory) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("a/inner", true, true);
+	filesystem.makeFile("b/inner", true, true);
+	FileSystem::Session first = filesystem.openSession();
+	FileSystem::Session second = filesystem.openSession();
+
+	// WHEN
+	first.changeDirectory("a");
+	second.changeDirectory("/b");
+	first.makeFile("inner/x.txt", false);
+	second.makeFile("inner/y.txt", false);
+
+	// THEN
+	EXPECT_EQ("/a", first.getCurrentPath());
+	EXPECT_EQ("/b", second.getCurrentPath());
+	EXPECT_EQ("", filesystem.getCurrentPath());
+	EXPECT_EQ("inner\n\tx.txt", first.printTree("inner"));
+	EXPECT_EQ("inner\n\ty.txt", second.printTree("inner"));
+}
+
+TEST(FileSystemTest, ConcurrentSessionsResolveRelativePaths) {
+	// GIVEN
+	FileSystem filesystem;
+	const size_t numSessions = 8;
+	for (size_t s = 0; s < numSessions; s++) {
+		filesystem.makeFile("home/user" + std::to_string(s), true, true);
+	}
+	std::vector<std::thread> threads;
+
+	// WHEN
+	for (size_t s = 0; s < numSessions; s++) {
+		threads.emplace_back([&filesystem, s]() {
+			FileSystem::Session session = filesystem.openSession();
+			for (size_t i = 0; i < 50; i++) {
+				session.changeDirectory("/home/user" + std::to_string(s));
+				session.makeFile("file" + std::to_string(i), false);
+				session.changeDirectory("..");
+			}
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	// THEN
+	for (size_t s = 0; s < numSessions; s++) {
+		const auto userDir = filesystem.changeDirectory("/home/user" + std::to_string(s));
+		EXPECT_EQ(50, userDir->files.size());
+	}
+}
+
+TEST(FileSystemTest, FindFileInManyDirectories) {
+	// GIVEN
+	FileSystem filesystem;
+	std::vector<std::string> expectedPaths;
+	for (size_t i = 0; i < 20; i++) {
+		const std::string dir = "/top" + std::to_string(i % 3) + "/mid" + std::to_string(i) + "/leaf";
+		filesystem.makeFile(dir + "/f.txt", false, true);
+		filesystem.makeFile(dir + "/g.txt", false);
+		expectedPaths.push_back(dir + "/f.txt");
+	}
+
+	// WHEN
+	auto foundPaths = filesystem.findFile("f.txt");
+
+	// THEN
+	std::sort(foundPaths.begin(), foundPaths.end());
+	std::sort(expectedPaths.begin(), expectedPaths.end());
+	EXPECT_EQ(expectedPaths, foundPaths);
+}
+
+TEST(FileSystemTest, PrintTreeKeepsOrderWhenSplit) {
+	// GIVEN
+	FileSystem serial;
+	FileSystem parallel;
+	for (size_t i = 0; i < 200; i++) {
+		const std::string path = "d" + std::to_string(i % 7) + "/e" + std::to_string(i % 13) + "/f" + std::to_string(i);
+		serial.makeFile(std::string(path), false, true);
+		parallel.makeFile(std::string(path), false, true);
+	}
+
+	// WHEN
+	const std::string tree = parallel.printTree("/");
+
+	// THEN
+	EXPECT_EQ(serial.printTree("/"), tree);
+	EXPECT_EQ(1 + 7 + 7 * 13 + 200, std::count(tree.cbegin(), tree.cend(), '\n') + 1);
+}
+
+TEST(FileSystemTest, FindFileBySubstringAndPattern) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("src/main.cpp", false, true);
+	filesystem.makeFile("src/main.h", false);
+	filesystem.makeFile("test/main_test.cpp", false, true);
+	filesystem.makeFile("docs/readme.md", false, true);
+
+	// WHEN
+	auto containing = filesystem.findFileContaining("main");
+	auto matching = filesystem.findFileMatching("*.cpp");
+	const auto shortFragment = filesystem.findFileContaining("h");
+
+	// THEN
+	std::sort(containing.begin(), containing.end());
+	std::sort(matching.begin(), matching.end());
+	EXPECT_EQ(std::vector<std::string>({ "/src/main.cpp", "/src/main.h", "/test/main_test.cpp" }), containing);
+	EXPECT_EQ(std::vector<std::string>({ "/src/main.cpp", "/test/main_test.cpp" }), matching);
+	EXPECT_EQ(std::vector<std::string>({ "/src/main.h" }), shortFragment);
+}
+
+TEST(FileSystemTest, FindFileFollowsMovesAndRemovals) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("a/b/f.txt", false, true);
+	filesystem.makeFile("a/c/f.txt", false, true);
+	filesystem.makeFile("d/g.txt", false, true);
+
+	// WHEN
+	filesystem.moveFile("a/b", "/e");
+	filesystem.removeFile("a/c");
+	filesystem.moveFile("d/g.txt", "/d/f.txt");
+	auto foundPaths = filesystem.findFile("f.txt");
+
+	// THEN
+	std::sort(foundPaths.begin(), foundPaths.end());
+	EXPECT_EQ(std::vector<std::string>({ "/d/f.txt", "/e/f.txt" }), foundPaths);
+	EXPECT_TRUE(filesystem.findFile("g.txt").empty());
+}
+
+TEST(FileSystemTest, FindFileWhileCreatingAndRemoving) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("/a", true);
+	filesystem.makeFile("/b", true);
+	std::vector<std::thread> writers;
+
+	// WHEN
+	for (const std::string dir : { "/a", "/b" }) {
+		writers.emplace_back([&filesystem, dir]() {
+			for (size_t i = 0; i < 2000; i++) {
+				try {
+					filesystem.makeFile(dir + "/x", false);
+				}
+				catch (const std::invalid_argument&) {}
+			}
+		});
+		writers.emplace_back([&filesystem, dir]() {
+			for (size_t i = 0; i < 2000; i++) {
+				try {
+					filesystem.removeFile(dir + "/x");
+				}
+				catch (const std::invalid_argument&) {}
+			}
+		});
+	}
+	for (std::thread& writer : writers) {
+		writer.join();
+	}
+	for (const std::string dir : { "/a", "/b" }) {
+		try {
+			filesystem.makeFile(dir + "/x", false);
+		}
+		catch (const std::invalid_argument&) {}
+	}
+
+	// THEN
+	auto foundPaths = filesystem.findFile("x");
+	std::sort(foundPaths.begin(), foundPaths.end());
+	EXPECT_EQ(std::vector<std::string>({ "/a/x", "/b/x" }), foundPaths);
+}
+
+TEST(FileSystemTest, CopyDirectoryIsDeep) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("a/b/f.txt", false, true);
+
+	// WHEN
+	filesystem.copyFile("a/b", "/c");
+	filesystem.makeFile("c/g.txt", false);
+	auto foundPaths = filesystem.findFile("f.txt");
+
+	// THEN
+	std::sort(foundPaths.begin(), foundPaths.end());
+	EXPECT_EQ(std::vector<std::string>({ "/a/b/f.txt", "/c/f.txt" }), foundPaths);
+	EXPECT_EQ(std::vector<std::string>({ "/c/g.txt" }), filesystem.findFile("g.txt"));
+	EXPECT_EQ("b", filesystem.changeDirectory("/a/b")->name);
+	EXPECT_THROW(filesystem.copyFile("/a", "/a/b/a"), std::invalid_argument);
+}
+
+TEST(FileSystemTest, StreamedTreeMatchesPrintTree) {
+	// GIVEN
+	FileSystem filesystem;
+	for (size_t i = 0; i < 50; i++) {
+		filesystem.makeFile("d" + std::to_string(i % 5) + "/e" + std::to_string(i % 3) + "/f" + std::to_string(i), false, true);
+	}
+	std::ostringstream out;
+
+	// WHEN
+	filesystem.printTree("/d1", out);
+
+	// THEN
+	EXPECT_EQ(filesystem.printTree("/d1"), out.str());
+}
+
+TEST(FileSystemTest, StreamedTreeSortedToDepth) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("b/y/deep.txt", false, true);
+	filesystem.makeFile("b/x.txt", false);
+	filesystem.makeFile("a/z.txt", false, true);
+	filesystem.makeFile("c.txt", false);
+	FileSystem::PrintOptions options;
+	options.isSorted = true;
+	options.maxDepth = 2;
+	std::ostringstream out;
+	std::ostringstream rootOnly;
+
+	// WHEN
+	filesystem.printTree("/", out, options);
+	options.maxDepth = 0;
+	filesystem.printTree("/", rootOnly, options);
+
+	// THEN
+	EXPECT_EQ("root\n\tc.txt\n\ta\n\t\tz.txt\n\tb\n\t\tx.txt\n\t\ty", out.str());
+	EXPECT_EQ("root", rootOnly.str());
+}
+
+TEST(FileSystemTest, RemovedDirectoryIsFreed) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("a/b/c/f.txt", false, true);
+	const std::weak_ptr removed(filesystem.changeDirectory("/a/b/c"));
+	filesystem.changeDirectory("/");
+
+	// WHEN
+	filesystem.removeFile("/a");
+
+	// THEN
+	EXPECT_TRUE(removed.expired());
+	EXPECT_TRUE(filesystem.findFile("f.txt").empty());
+}
+
+TEST(FileSystemTest, HeldDirectoryOutlivesItsRemovedParent) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("a/b/f.txt", false, true);
+	auto session = filesystem.openSession();
+	session.changeDirectory("a/b");
+
+	// WHEN
+	filesystem.removeFile("/a");
+
+	// THEN
+	EXPECT_EQ("b", session.getPwd()->name);
+	EXPECT_TRUE(session.getPwd()->parent.expired());
+	EXPECT_THROW(session.changeDirectory(".."), std::invalid_argument);
+	EXPECT_NO_THROW(session.makeFile("g.txt", false));
+}
+
+TEST(FileSystemTest, SnapshotKeepsThePointInTime) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("a/b/f.txt", false, true);
+	filesystem.makeFile("c/g.txt", false, true);
+	const FileSystem::Snapshot snapshot = filesystem.snapshot();
+
+	// WHEN
+	filesystem.removeFile("/a/b/f.txt");
+	filesystem.moveFile("/c", "/a/d");
+	filesystem.makeFile("/a/h.txt", false);
+
+	// THEN
+	EXPECT_EQ("root\n\ta\n\t\tb\n\t\t\tf.txt\n\tc\n\t\tg.txt", snapshot.printTree("/"));
+	EXPECT_EQ(std::vector<std::string>({ "/a/b/f.txt" }), snapshot.findFile("f.txt"));
+	EXPECT_EQ("root\n\ta\n\t\th.txt\n\t\tb\n\t\td\n\t\t\tg.txt", filesystem.snapshot().printTree("/"));
+	EXPECT_THROW(snapshot.getDirectory("/a/d"), std::invalid_argument);
+}
+
+TEST(FileSystemTest, SnapshotsShareUnchangedDirectories) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("a/b/f.txt", false, true);
+	filesystem.makeFile("c/d/g.txt", false, true);
+	const FileSystem::Snapshot first = filesystem.snapshot();
+
+	// WHEN
+	const FileSystem::Snapshot unchanged = filesystem.snapshot();
+	filesystem.makeFile("a/b/h.txt", false);
+	const FileSystem::Snapshot changed = filesystem.snapshot();
+
+	// THEN
+	EXPECT_EQ(first.getRoot(), unchanged.getRoot());
+	EXPECT_NE(first.getRoot(), changed.getRoot());
+	EXPECT_NE(first.getDirectory("a/b"), changed.getDirectory("a/b"));
+	EXPECT_EQ(first.getDirectory("c"), changed.getDirectory("c"));
+	EXPECT_EQ(first.getDirectory("c/d/.."), changed.getDirectory("/c"));
+	ASSERT_EQ(2, changed.getDirectory("/a/b")->files.size());
+	EXPECT_EQ("f.txt", changed.getDirectory("/a/b")->files[0].name);
+	EXPECT_EQ("h.txt", changed.getDirectory("/a/b")->files[1].name);
+}
+
+TEST(FileSystemTest, SnapshotWhileWriting) {
+	// GIVEN
+	FileSystem filesystem;
+	std::vector<std::thread> writers;
+
+	// WHEN
+	for (size_t i = 0; i < 4; i++) {
+		writers.emplace_back([&filesystem, i]() {
+			for (size_t j = 0; j < 200; j++) {
+				filesystem.makeFile("w" + std::to_string(i) + "/d" + std::to_string(j % 10) + "/f" + std::to_string(j), false, true);
+			}
+		});
+	}
+	std::vector<FileSystem::Snapshot> snapshots;
+	for (size_t i = 0; i < 20; i++) {
+		snapshots.push_back(filesystem.snapshot());
+	}
+	for (std::thread& writer : writers) {
+		writer.join();
+	}
+	snapshots.push_back(filesystem.snapshot());
+
+	// THEN
+	size_t previousSize = 0;
+	for (const FileSystem::Snapshot& snapshot : snapshots) {
+		const std::string tree = snapshot.printTree("/");
+		const size_t size = std::count(tree.cbegin(), tree.cend(), '\n');
+		EXPECT_LE(previousSize, size);
+		previousSize = size;
+	}
+	EXPECT_EQ(4 + 4 * 10 + 4 * 200, previousSize);
+}
+
+TEST(FileSystemTest, FirstSnapshotWhileMoving) {
+	for (size_t round = 0; round < 10; round++) {
+		// GIVEN
+		FileSystem filesystem;
+		for (size_t i = 0; i < 50; i++) {
+			for (size_t j = 0; j < 20; j++) {
+				filesystem.makeFile("p/d" + std::to_string(i) + "/f" + std::to_string(j), false, true);
+			}
+		}
+		filesystem.makeFile("p/x/g.txt", false, true);
+		filesystem.makeFile("q", true);
+		std::atomic<bool> isStopping = false;
+		std::thread mover([&filesystem, &isStopping]() {
+			while (!isStopping) {
+				filesystem.moveFile("/p/x", "/q/x");
+				filesystem.moveFile("/q/x", "/p/x");
+			}
+		});
+		std::thread maker([&filesystem, &isStopping]() {
+			for (size_t i = 0; !isStopping; i++) {
+				filesystem.makeFile("/p/d" + std::to_string(i % 50) + "/n" + std::to_string(i), false);
+			}
+		});
+
+		// WHEN
+		const FileSystem::Snapshot first = filesystem.snapshot();
+		isStopping = true;
+		mover.join();
+		maker.join();
+		const FileSystem::Snapshot last = filesystem.snapshot();
+
+		// THEN
+		EXPECT_EQ(1, first.findFile("g.txt").size());
+		EXPECT_EQ(std::vector<std::string>({ "/p/x/g.txt" }), last.findFile("g.txt"));
+		const std::string tree = filesystem.printTree("/");
+		const std::string frozenTree = last.printTree("/");
+		EXPECT_EQ(std::count(tree.cbegin(), tree.cend(), '\n'), std::count(frozenTree.cbegin(), frozenTree.cend(), '\n'));
+	}
+}
+
+namespace {
+	std::vector<std::byte> bytesOf(const std::string& text) {
+		std::vector<std::byte> bytes(text.size());
+		std::transform(text.cbegin(), text.cend(), bytes.begin(), [](const char c) { return static_cast<std::byte>(c); });
+		return bytes;
+	}
+
+	std::string textOf(std::span<const std::byte> bytes) {
+		std::string text(bytes.size(), '\0');
+		std::transform(bytes.begin(), bytes.end(), text.begin(), [](const std::byte b) { return static_cast<char>(b); });
+		return text;
+	}
+
+	std::string textOf(const FileSystem::FileView& view) {
+		std::string text;
+		for (const std::span<const std::byte> span : view.spans()) {
+			text += textOf(span);
+		}
+		return text;
+	}
+}
+
+TEST(FileSystemTest, WriteAndReadAcrossBlocks) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("/data.bin", false);
+	std::string text;
+	for (size_t i = 0; i < 10000; i++) {
+		text += static_cast<char>('a' + i % 26);
+	}
+
+	// WHEN
+	const size_t numWritten = filesystem.write("/data.bin", 0, bytesOf(text));
+	std::vector<std::byte> buffer(6000);
+	const size_t numRead = filesystem.read("/data.bin", 4000, buffer);
+	std::vector<std::byte> tail(100);
+	const size_t numTailRead = filesystem.read("/data.bin", 9990, tail);
+
+	// THEN
+	EXPECT_EQ(10000, numWritten);
+	EXPECT_EQ(10000, filesystem.fileSize("/data.bin"));
+	EXPECT_EQ(6000, numRead);
+	EXPECT_EQ(text.substr(4000, 6000), textOf(buffer));
+	EXPECT_EQ(10, numTailRead);
+	EXPECT_EQ(0, filesystem.read("/data.bin", 20000, tail));
+}
+
+TEST(FileSystemTest, SparseFileReadsZerosInHoles) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("/sparse", false);
+
+	// WHEN
+	filesystem.write("/sparse", 1ull << 40, bytesOf("end"));
+	std::vector<std::byte> buffer(5);
+	filesystem.read("/sparse", (1ull << 40) - 2, buffer);
+	const FileSystem::FileView view = filesystem.readView("/sparse", 10, 8190);
+
+	// THEN
+	EXPECT_EQ((1ull << 40) + 3, filesystem.fileSize("/sparse"));
+	EXPECT_EQ(std::string("\0\0end", 5), textOf(buffer));
+	EXPECT_EQ(8190, view.size());
+	EXPECT_EQ(std::string(8190, '\0'), textOf(view));
+}
+
+TEST(FileSystemTest, ViewsAndCopiesDoNotSeeLaterWrites) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("/a.txt", false);
+	filesystem.write("/a.txt", 0, bytesOf("hello world"));
+
+	// WHEN
+	const FileSystem::FileView view = filesystem.readView("/a.txt", 6, 100);
+	filesystem.copyFile("/a.txt", "/b.txt");
+	filesystem.write("/a.txt", 6, bytesOf("there"));
+	std::vector<std::byte> copied(11);
+	filesystem.read("/b.txt", 0, copied);
+	std::vector<std::byte> original(11);
+	filesystem.read("/a.txt", 0, original);
+
+	// THEN
+	ASSERT_EQ(1, view.spans().size());
+	EXPECT_EQ("world", textOf(view));
+	EXPECT_EQ("hello world", textOf(copied));
+	EXPECT_EQ("hello there", textOf(original));
+}
+
+TEST(FileSystemTest, CopiedDirectoryIsBuiltOnFirstAccess) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("a/b/f.txt", false, true);
+	filesystem.makeFile("a/c/g.txt", false, true);
+	filesystem.write("a/b/f.txt", 0, bytesOf("shared"));
+
+	// WHEN
+	filesystem.copyFile("/a", "/copy");
+	const auto copiedB = filesystem.getRoot()->childDirs["copy"]->childDirs["b"];
+	const auto copiedC = filesystem.getRoot()->childDirs["copy"]->childDirs["c"];
+	const bool wasLoaded = copiedB->isLoaded;
+	const FileSystem::Snapshot beforeWrite = filesystem.snapshot();
+	auto foundPaths = filesystem.findFile("f.txt");
+	filesystem.write("copy/b/f.txt", 0, bytesOf("copied"));
+	filesystem.write("a/b/f.txt", 6, bytesOf("!"));
+	const FileSystem::Stat copy = filesystem.stat("/copy");
+
+	// THEN
+	std::sort(foundPaths.begin(), foundPaths.end());
+	EXPECT_FALSE(wasLoaded);
+	EXPECT_EQ(beforeWrite.getFile("a/b/f.txt").blocks, beforeWrite.getFile("copy/b/f.txt").blocks);
+	EXPECT_EQ(std::vector<std::string>({ "/a/b/f.txt", "/copy/b/f.txt" }), foundPaths);
+	EXPECT_TRUE(copiedB->isLoaded);
+	EXPECT_FALSE(copiedC->isLoaded);
+	std::vector<std::byte> copied(16);
+	copied.resize(filesystem.read("copy/b/f.txt", 0, copied));
+	std::vector<std::byte> original(16);
+	original.resize(filesystem.read("a/b/f.txt", 0, original));
+	EXPECT_EQ("copied", textOf(copied));
+	EXPECT_EQ("shared!", textOf(original));
+	EXPECT_EQ(6, copy.size);
+	EXPECT_EQ(2, copy.numFiles);
+	EXPECT_EQ(2, copy.numDirs);
+	filesystem.removeFile("/copy");
+	EXPECT_EQ(std::vector<std::string>({ "/a/c/g.txt" }), filesystem.findFile("g.txt"));
+}
+
+TEST(FileSystemTest, SnapshotsShareTheFilesOfUnchangedDirectories) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("a/f.txt", false, true);
+	filesystem.makeFile("a/b/g.txt", false, true);
+	const FileSystem::Snapshot first = filesystem.snapshot();
+
+	// WHEN
+	filesystem.makeFile("a/b/h.txt", false);
+	const FileSystem::Snapshot changed = filesystem.snapshot();
+
+	// THEN
+	EXPECT_NE(first.getDirectory("a"), changed.getDirectory("a"));
+	ASSERT_EQ(1, changed.getDirectory("a")->files.size());
+	EXPECT_EQ(&first.getDirectory("a")->files[0], &changed.getDirectory("a")->files[0]);
+	EXPECT_EQ(2, changed.getDirectory("a/b")->files.size());
+}
+
+TEST(FileSystemTest, TruncateZeroesTheCutOffTail) {
+	// GIVEN
+	FileSystem filesystem;
+	auto session = filesystem.openSession();
+	session.makeFile("f", false);
+	session.write("f", 0, bytesOf(std::string(5000, 'x')));
+
+	// WHEN
+	session.truncate("f", 4097);
+	session.truncate("f", 4100);
+	std::vector<std::byte> buffer(4);
+	session.read("f", 4096, buffer);
+
+	// THEN
+	EXPECT_EQ(4100, session.fileSize("f"));
+	EXPECT_EQ(std::string("x\0\0\0", 4), textOf(buffer));
+	EXPECT_THROW(session.write("missing", 0, bytesOf("x")), std::invalid_argument);
+	session.makeFile("dir", true);
+	EXPECT_THROW(session.fileSize("dir"), std::invalid_argument);
+}
+
+TEST(FileSystemTest, SnapshotKeepsTheDataOfItsFiles) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("a/f.txt", false, true);
+	filesystem.makeFile("a/g.txt", false);
+	filesystem.write("a/f.txt", 0, bytesOf("before"));
+	const FileSystem::Snapshot before = filesystem.snapshot();
+
+	// WHEN
+	filesystem.write("a/f.txt", 0, bytesOf("after!!!"));
+	filesystem.copyFile("a/f.txt", "a/copy.txt");
+	filesystem.truncate("a/copy.txt", 5);
+	const FileSystem::Snapshot after = filesystem.snapshot();
+	std::vector<std::byte> beforeBuffer(16);
+	std::vector<std::byte> afterBuffer(16);
+	std::vector<std::byte> copyBuffer(16);
+	beforeBuffer.resize(before.read("/a/f.txt", 0, beforeBuffer));
+	afterBuffer.resize(after.read("/a/f.txt", 0, afterBuffer));
+	copyBuffer.resize(after.read("/a/copy.txt", 0, copyBuffer));
+
+	// THEN
+	EXPECT_EQ("before", textOf(beforeBuffer));
+	EXPECT_EQ("after!!!", textOf(afterBuffer));
+	EXPECT_EQ("after", textOf(copyBuffer));
+	EXPECT_EQ(6, before.getFile("a/f.txt").size);
+	EXPECT_EQ(0, before.getFile("a/g.txt").size);
+	EXPECT_EQ(after.getFile("a/g.txt").blocks, nullptr);
+	EXPECT_NE(before.getRoot(), after.getRoot());
+	EXPECT_THROW(before.getFile("a/copy.txt"), std::invalid_argument);
+	EXPECT_EQ(8, filesystem.fileSize("a/f.txt"));
+}
+
+TEST(FileSystemTest, SnapshotWhileWritingData) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("a/f.txt", false, true);
+	filesystem.write("a/f.txt", 0, bytesOf("0000"));
+	std::atomic<bool> isWriting = true;
+
+	// WHEN
+	std::thread writer([&filesystem, &isWriting]() {
+		for (int i = 1; i <= 2000; i++) {
+			const std::string digit(4, static_cast<char>('0' + i % 10));
+			filesystem.write("a/f.txt", 0, bytesOf(digit));
+		}
+		isWriting = false;
+	});
+	size_t numTorn = 0;
+	while (isWriting) {
+		std::vector<std::byte> buffer(4);
+		filesystem.snapshot().read("/a/f.txt", 0, buffer);
+		const std::string text = textOf(buffer);
+		if (text != std::string(4, text[0])) {
+			numTorn++;
+		}
+	}
+	writer.join();
+	std::vector<std::byte> buffer(4);
+	filesystem.snapshot().read("/a/f.txt", 0, buffer);
+
+	// THEN
+	EXPECT_EQ(0, numTorn);
+	EXPECT_EQ("0000", textOf(buffer));
+}
+
+TEST(FileSystemTest, SaveAndLoadImage) {
+	// GIVEN
+	const std::string imagePath = (std::filesystem::temp_directory_path() / "filesystem_test.img").string();
+	{
+		FileSystem filesystem;
+		filesystem.makeFile("a/b/f.txt", false, true);
+		filesystem.makeFile("a/c/f.txt", false, true);
+		filesystem.makeFile("d/g.txt", false, true);
+		filesystem.write("a/b/f.txt", 5000, bytesOf("data"));
+		filesystem.copyFile("a/b/f.txt", "/d/h.txt");
+		filesystem.save(imagePath);
+	}
+
+	// WHEN
+	FileSystem loaded(imagePath);
+	auto foundPaths = loaded.findFile("f.txt");
+	std::vector<std::byte> buffer(6);
+	loaded.read("/d/h.txt", 4998, buffer);
+
+	// THEN
+	std::sort(foundPaths.begin(), foundPaths.end());
+	EXPECT_EQ(std::vector<std::string>({ "/a/b/f.txt", "/a/c/f.txt" }), foundPaths);
+	EXPECT_EQ("root\n\ta\n\t\tb\n\t\t\tf.txt\n\t\tc\n\t\t\tf.txt\n\td\n\t\tg.txt\n\t\th.txt", loaded.snapshot().printTree("/"));
+	EXPECT_EQ(5004, loaded.fileSize("/a/b/f.txt"));
+	EXPECT_EQ(std::string("\0\0data", 6), textOf(buffer));
+	std::filesystem::remove(imagePath);
+}
+
+TEST(FileSystemTest, LoadedDirectoriesAreBuiltOnFirstAccess) {
+	// GIVEN
+	const std::string imagePath = (std::filesystem::temp_directory_path() / "filesystem_lazy_test.img").string();
+	{
+		FileSystem filesystem;
+		filesystem.makeFile("a/b/c/f.txt", false, true);
+		filesystem.save(imagePath);
+	}
+	FileSystem loaded(imagePath);
+	const auto a = loaded.getRoot()->childDirs["a"];
+
+	// WHEN
+	const bool wasLoaded = a->isLoaded;
+	loaded.changeDirectory("/a/b");
+	loaded.write("c/f.txt", 0, bytesOf("written"));
+	loaded.makeFile("c/g.txt", false);
+	loaded.removeFile("/a/b/c/f.txt");
+
+	// THEN
+	EXPECT_FALSE(wasLoaded);
+	EXPECT_TRUE(a->isLoaded);
+	EXPECT_EQ("b\n\tc\n\t\tg.txt", loaded.printTree("."));
+	EXPECT_TRUE(loaded.findFile("f.txt").empty());
+	std::filesystem::remove(imagePath);
+}
+
+TEST(FileSystemTest, FindFileInImageBuildsOnlyTheDirectoriesOfItsHits) {
+	// GIVEN
+	const std::string imagePath = (std::filesystem::temp_directory_path() / "filesystem_find_image_test.img").string();
+	{
+		FileSystem filesystem;
+		filesystem.makeFile("a/b/f.txt", false, true);
+		filesystem.makeFile("c/d/g.txt", false, true);
+		filesystem.makeFile("e/f.txt", false, true);
+		filesystem.makeFile("h/i/f.txt", false, true);
+		filesystem.save(imagePath);
+	}
+	FileSystem loaded(imagePath);
+	const auto c = loaded.getRoot()->childDirs["c"];
+
+	// WHEN
+	loaded.moveFile("/a", "/moved");
+	loaded.removeFile("/h");
+	auto foundPaths = loaded.findFile("f.txt");
+	const bool wasLoaded = c->isLoaded;
+	const auto matchingPaths = loaded.findFileMatching("g*");
+	loaded.removeFile("/e");
+	const auto foundAfterRemove = loaded.findFile("f.txt");
+
+	// THEN
+	std::sort(foundPaths.begin(), foundPaths.end());
+	EXPECT_EQ(std::vector<std::string>({ "/e/f.txt", "/moved/b/f.txt" }), foundPaths);
+	EXPECT_FALSE(wasLoaded);
+	EXPECT_EQ(std::vector<std::string>({ "/c/d/g.txt" }), matchingPaths);
+	EXPECT_TRUE(c->isLoaded);
+	EXPECT_EQ(std::vector<std::string>({ "/moved/b/f.txt" }), foundAfterRemove);
+	std::filesystem::remove(imagePath);
+}
+
+TEST(FileSystemTest, CorruptImageIsRejected) {
+	// GIVEN
+	const std::string imagePath = (std::filesystem::temp_directory_path() / "filesystem_corrupt_test.img").string();
+	{
+		std::ofstream out(imagePath, std::ios::binary);
+		out << "not a file system image, just some text that is long enough to hold a header";
+	}
+
+	// WHEN
+
+	// THEN
+	EXPECT_THROW(FileSystem{ imagePath }, std::runtime_error);
+	std::filesystem::remove(imagePath);
+	EXPECT_THROW(FileSystem{ imagePath }, std::runtime_error);
+}
+
+TEST(FileSystemTest, BulkLoadSortedPaths) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("/a/old.txt", false, true);
+	std::istringstream manifest("/a/b/f.txt\n/a/b/g.txt\n/a/c/\n/a/old.txt\n/d/e/f.txt\n\ntop.txt\n");
+
+	// WHEN
+	const size_t numCreated = filesystem.bulkLoad(manifest);
+	auto foundPaths = filesystem.findFile("f.txt");
+
+	// THEN
+	std::sort(foundPaths.begin(), foundPaths.end());
+	EXPECT_EQ(8, numCreated);
+	EXPECT_EQ(std::vector<std::string>({ "/a/b/f.txt", "/d/e/f.txt" }), foundPaths);
+	EXPECT_EQ("root\n\ttop.txt\n\ta\n\t\told.txt\n\t\tb\n\t\t\tf.txt\n\t\t\tg.txt\n\t\tc\n\td\n\t\te\n\t\t\tf.txt", filesystem.snapshot().printTree("/"));
+}
+
+TEST(FileSystemTest, BulkLoadUnsortedPaths) {
+	// GIVEN
+	FileSystem filesystem;
+	std::istringstream manifest("/a/b/f.txt\n/c/g.txt\n/a/b/h.txt\n/a/b/f.txt\n");
+
+	// WHEN
+	const size_t numCreated = filesystem.bulkLoad(manifest);
+
+	// THEN
+	EXPECT_EQ(6, numCreated);
+	EXPECT_EQ("root\n\ta\n\t\tb\n\t\t\tf.txt\n\t\t\th.txt\n\tc\n\t\tg.txt", filesystem.snapshot().printTree("/"));
+}
+
+TEST(FileSystemTest, BulkLoadKeepsEntriesBeforeABadPath) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("/e.txt", false, false);
+	std::istringstream manifest("/a/f.txt\n/e.txt/g.txt\n/b/g.txt\n");
+
+	// WHEN
+
+	// THEN
+	EXPECT_THROW(filesystem.bulkLoad(manifest), std::invalid_argument);
+	EXPECT_EQ("root\n\te.txt\n\ta\n\t\tf.txt", filesystem.snapshot().printTree("/"));
+}
+
+TEST(FileSystemTest, StatFollowsEveryChange) {
+	// GIVEN
+	FileSystem filesystem;
+	filesystem.makeFile("/a/b/f.txt", false, true);
+	filesystem.makeFile("/a/c", true);
+	filesystem.write("/a/b/f.txt", 0, bytesOf("0123456789"));
+
+	// WHEN
+	filesystem.copyFile("/a/b", "/a/c/b");
+	filesystem.moveFile("/a/c", "/d");
+	filesystem.write("/d/b/f.txt", 95, bytesOf("tail"));
+	filesystem.truncate("/a/b/f.txt", 4);
+	filesystem.makeFile("/d/g.txt", false);
+	filesystem.removeFile("/a/b/f.txt");
+	const FileSystem::Stat root = filesystem.stat("/");
+	const FileSystem::Stat a = filesystem.stat("/a");
+	const FileSystem::Stat d = filesystem.stat("/d");
+	const FileSystem::Stat f = filesystem.stat("/d/b/f.txt");
+
+	// THEN
+	EXPECT_TRUE(root.isDirectory);
+	EXPECT_EQ(99, root.size);
+	EXPECT_EQ(2, root.numFiles);
+	EXPECT_EQ(4, root.numDirs);
+	EXPECT_EQ(0, a.size);
+	EXPECT_EQ(0, a.numFiles);
+	EXPECT_EQ(1, a.numDirs);
+	EXPECT_EQ(99, d.size);
+	EXPECT_EQ(2, d.numFiles);
+	EXPECT_EQ(1, d.numDirs);
+	EXPECT_FALSE(f.isDirectory);
+	EXPECT_EQ(99, f.size);
+	EXPECT_THROW(filesystem.stat("/a/b/f.txt"), std::invalid_argument);
+}
+
+TEST(FileSystemTest, StatAfterBulkLoadAndImage) {
+	// GIVEN
+	const std::string imagePath = (std::filesystem::temp_directory_path() / "filesystem_stat_test.img").string();
+	{
+		FileSystem filesystem;
+		std::istringstream manifest("/a/b/f.txt\n/a/b/g.txt\n/a/c/\n/d/h.txt\n");
+		filesystem.bulkLoad(manifest);
+		filesystem.write("/a/b/g.txt", 10, bytesOf("data"));
+		filesystem.save(imagePath);
+	}
+
+	// WHEN
+	FileSystem loaded(imagePath);
+	const FileSystem::Stat root = loaded.stat("/");
+	const FileSystem::Stat a = loaded.stat("/a");
+	loaded.removeFile("/a/b");
+	const FileSystem::Stat rootAfterRemove = loaded.stat("/");
+
+	// THEN
+	EXPECT_EQ(14, root.size);
+	EXPECT_EQ(3, root.numFiles);
+	EXPECT_EQ(4, root.numDirs);
+	EXPECT_EQ(14, a.size);
+	EXPECT_EQ(2, a.numFiles);
+	EXPECT_EQ(2, a.numDirs);
+	EXPECT_EQ(0, rootAfterRemove.size);
+	EXPECT_EQ(1, rootAfterRemove.numFiles);
+	EXPECT_EQ(3, rootAfterRemove.numDirs);
+	std::filesystem::remove(imagePath);
+}
+
+TEST(FileSystemTest, StatTotalsHoldUnderConcurrentChanges) {
+	// GIVEN
+	FileSystem filesystem;
+	std::vector<std::thread> writers;
+
+	// WHEN
+	for (size_t i = 0; i < 4; i++) {
+		writers.emplace_back([&filesystem, i]() {
+			const std::string dir = "/w" + std::to_string(i);
+			for (size_t j = 0; j < 100; j++) {
+				const std::string path = dir + "/d" + std::to_string(j % 5) + "/f" + std::to_string(j);
+				filesystem.makeFile(std::string(path), false, true);
+				filesystem.write(std::string(path), 0, bytesOf("12345"));
+				if (j % 4 == 0) {
+					filesystem.removeFile(std::string(path));
+				}
+			}
+			filesystem.moveFile(std::string(dir), "/moved" + std::to_string(i));
+		});
+	}
+	for (std::thread& writer : writers) {
+		writer.join();
+	}
+	const FileSystem::Stat root = filesystem.stat("/");
+	const FileSystem::Stat moved = filesystem.stat("/moved0");
+
+	// THEN
+	EXPECT_EQ(4 * 75 * 5, root.size);
+	EXPECT_EQ(4 * 75, root.numFiles);
+	EXPECT_EQ(4 + 4 * 5, root.numDirs);
+	EXPECT_EQ(75 * 5, moved.size);
+	EXPECT_EQ(75, moved.numFiles);
+	EXPECT_EQ(5, moved.numDirs);
+}
+
+namespace {
+	std::string describe(const FileSystem::WatchEvent& event) {
+		const char* kinds[] = { "created ", "removed ", "moved " };
+		std::string description = kinds[static_cast<int>(event.kind)] + event.path;
+		if (!event.destPath.empty()) {
+			description += " to " + event.destPath;
+		}
+		return description;
+	}
+}
+
+TEST(FileSystemTest, WatchReportsChangesBelowThePath) {
+	// GIVEN
+	std::vector<std::string> recursiveEvents;
+	std::vector<std::string> directEvents;
+	{
+		FileSystem filesystem;
+		filesystem.makeFile("/a", true);
+		filesystem.makeFile("/c", true);
+		filesystem.watch("/a", true, [&recursiveEvents](const std::vector<FileSystem::WatchEvent>& events) {
+			for (const FileSystem::WatchEvent& event : events) {
+				recursiveEvents.push_back(describe(event));
+			}
+		});
+		filesystem.watch("/a", false, [&directEvents](const std::vector<FileSystem::WatchEvent>& events) {
+			for (const FileSystem::WatchEvent& event : events) {
+				directEvents.push_back(describe(event));
+			}
+		});
+
+		// WHEN
+		filesystem.makeFile("/a/b/f.txt", false, true);
+		filesystem.makeFile("/c/outside.txt", false);
+		filesystem.moveFile("/a/b/f.txt", "/c/f.txt");
+		filesystem.copyFile("/c/outside.txt", "/a/copy.txt");
+		filesystem.removeFile("/a/b");
+	}
+
+	// THEN
+	EXPECT_EQ(std::vector<std::string>({ "created /a/b", "created /a/b/f.txt", "moved /a/b/f.txt to /c/f.txt", "created /a/copy.txt", "removed /a/b" }), recursiveEvents);
+	EXPECT_EQ(std::vector<std::string>({ "created /a/b", "created /a/copy.txt", "removed /a/b" }), directEvents);
+}
+
+TEST(FileSystemTest, WatchCoalescesABurstIntoOneBatch) {
+	// GIVEN
+	std::vector<std::vector<std::string>> batches;
+	std::promise<void> isDelivering;
+	std::promise<void> canFinish;
+	{
+		FileSystem filesystem;
+		filesystem.watch("/", true, [&](const std::vector<FileSystem::WatchEvent>& events) {
+			std::vector<std::string>& batch = batches.emplace_back();
+			for (const FileSystem::WatchEvent& event : events) {
+				batch.push_back(describe(event));
+			}
+			// holds up delivery after the first batch, so the burst queues up behind it
+			if (batches.size() == 1) {
+				isDelivering.set_value();
+				canFinish.get_future().wait();
+			}
+		});
+		filesystem.makeFile("/first.txt", false);
+		isDelivering.get_future().wait();
+
+		// WHEN
+		filesystem.makeFile("/tmp.txt", false);
+		filesystem.makeFile("/kept.txt", false);
+		filesystem.removeFile("/tmp.txt");
+		filesystem.moveFile("/kept.txt", "/renamed.txt");
+		canFinish.set_value();
+	}
+
+	// THEN
+	EXPECT_EQ(std::vector<std::vector<std::string>>({ { "created /first.txt" }, { "created /kept.txt", "moved /kept.txt to /renamed.txt" } }), batches);
+}
+
+TEST(FileSystemTest, WatchKeepsTheOrderOfRacingChanges) {
+	// GIVEN
+	std::vector<std::string> reported;
+	bool isThereAtEnd = false;
+	{
+		FileSystem filesystem;
+		filesystem.watch("/", true, [&reported](const std::vector<FileSystem::WatchEvent>& events) {
+			for (const FileSystem::WatchEvent& event : events) {
+				reported.push_back(describe(event));
+			}
+		});
+
+		// WHEN
+		std::thread creator([&filesystem]() {
+			for (size_t i = 0; i < 2000; i++) {
+				try {
+					filesystem.makeFile("/x", false);
+				}
+				catch (const std::invalid_argument&) {}
+			}
+		});
+		std::thread remover([&filesystem]() {
+			for (size_t i = 0; i < 2000; i++) {
+				try {
+					filesystem.removeFile("/x");
+				}
+				catch (const std::invalid_argument&) {}
+			}
+		});
+		creator.join();
+		remover.join();
+		isThereAtEnd = !filesystem.findFile("x").empty();
+	}
+
+	// THEN
+	for (size_t i = 0; i < reported.size(); i++) {
+		EXPECT_EQ(i % 2 == 0 ? "created /x" : "removed /x", reported[i]) << "at " << i;
+	}
+	EXPECT_EQ(isThereAtEnd, reported.size() % 2 == 1);
+}
+
+TEST(FileSystemTest, WatchReportsChangesAfterAFailedCreate) {
+	// GIVEN
+	std::vector<std::string> reported;
+	{
+		FileSystem filesystem;
+		filesystem.watch("/", true, [&reported](const std::vector<FileSystem::WatchEvent>& events) {
+			for (const FileSystem::WatchEvent& event : events) {
+				reported.push_back(describe(event));
+			}
+		});
+
+		// WHEN
+		EXPECT_THROW(filesystem.makeFile("new/../../x", false, true), std::invalid_argument);
+		filesystem.makeFile("a", false);
+		filesystem.makeFile("b", true);
+	}
+
+	// THEN
+	EXPECT_EQ(std::vector<std::string>({ "created /new", "created /a", "created /b" }), reported);
+}
+
+TEST(FileSystemTest, UnwatchedPathsAreNotReported) {
+	// GIVEN
+	size_t numEvents = 0;
+	{
+		FileSystem filesystem;
+		const size_t watchId = filesystem.watch("/", true, [&numEvents](const std::vector<FileSystem::WatchEvent>& events) {
+			numEvents += events.size();
+		});
+
+		// WHEN
+		filesystem.unwatch(watchId);
+		filesystem.makeFile("/a/b", true, true);
+	}
+
+	// THEN
+	EXPECT_EQ(0, numEvents);
+	FileSystem filesystem;
+	EXPECT_THROW(filesystem.watch("/missing", true, [](const std::vector<FileSystem::WatchEvent>&) {}), std::invalid_argument);
+}
@@ -1,10 +1,35 @@
 #include "pch.h"
 
+#include "../implementations/concurrency_policy.cpp"
 #include "../implementations/linked_unordered_map.cpp"
+#include <atomic>
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
 using namespace implementations;
 
+namespace {
+	struct CopyCounter {
+		static size_t numCopies;
+		static size_t numConstructions;
+		int value;
+
+		CopyCounter(int value = 0) : value(value) {
+			numConstructions++;
+		}
+		CopyCounter(const CopyCounter& other) : value(other.value) {
+			numCopies++;
+		}
+		CopyCounter(CopyCounter&& other) noexcept = default;
+		CopyCounter& operator=(const CopyCounter& other) = default;
+		CopyCounter& operator=(CopyCounter&& other) noexcept = default;
+	};
+	size_t CopyCounter::numCopies = 0;
+	size_t CopyCounter::numConstructions = 0;
+}
+
 TEST(LinkedUnorderedMapTest, InsertAtHead) {
 	// GIVEN
 	LinkedUnorderedMap<int, std::string> map;
@@ -122,4 +147,294 @@ TEST(LinkedUnorderedMapTest, RemoveThrowsForEmptyMap) {
 
 	// THEN
 	EXPECT_THROW(map.remove(true), std::runtime_error);
-}
\ No newline at end of file
+}
+
+TEST(LinkedUnorderedMapTest, HeterogeneousLookup) {
+	// GIVEN
+	LinkedUnorderedMap<std::string, int, TransparentStringHash, std::equal_to<>> map;
+	const std::string_view key = "b";
+
+	// WHEN
+	EXPECT_TRUE(map.insertAtTail("a", 1));
+	EXPECT_TRUE(map.insertAtTail("b", 2));
+	EXPECT_TRUE(map.insertAtTail("c", 3));
+	map.moveToEnd(key);
+
+	// THEN
+	EXPECT_TRUE(map.hasKey(key));
+	EXPECT_EQ(2, map[key]);
+	ASSERT_NE(nullptr, map.find(key));
+	EXPECT_EQ(nullptr, map.find(std::string_view("d")));
+	EXPECT_EQ(2, map.remove(false).second);
+	EXPECT_EQ(1, map.remove(std::string_view("a")));
+	EXPECT_THROW(map[std::string_view("a")], std::invalid_argument);
+}
+
+TEST(LinkedUnorderedMapTest, MoveOnlyValues) {
+	// GIVEN
+	LinkedUnorderedMap<int, std::unique_ptr<int>> map;
+
+	// WHEN
+	EXPECT_TRUE(map.insertAtTail(1, std::make_unique<int>(10)));
+	EXPECT_TRUE(map.insertAtHead(2, std::make_unique<int>(20)));
+	const std::unique_ptr<int> removed = map.remove(1);
+
+	// THEN
+	EXPECT_EQ(10, *removed);
+	EXPECT_EQ(20, *map.remove(true).second);
+	EXPECT_TRUE(map.empty());
+}
+
+TEST(LinkedUnorderedMapTest, TryEmplaceConstructsInPlace) {
+	// GIVEN
+	LinkedUnorderedMap<int, CopyCounter> map;
+	CopyCounter::numCopies = 0;
+	CopyCounter::numConstructions = 0;
+
+	// WHEN
+	EXPECT_TRUE(map.tryEmplaceAtTail(1, 5));
+	EXPECT_FALSE(map.tryEmplaceAtTail(1, 6));
+	EXPECT_TRUE(map.tryEmplaceAtHead(2, 7));
+	map.moveToEnd(2);
+	const CopyCounter removed = map.remove(1);
+
+	// THEN
+	EXPECT_EQ(2, CopyCounter::numConstructions);
+	EXPECT_EQ(0, CopyCounter::numCopies);
+	EXPECT_EQ(5, removed.value);
+	EXPECT_EQ(7, map[2].value);
+}
+
+TEST(LinkedUnorderedMapTest, EraseReturnsWhetherKeyExisted) {
+	// GIVEN
+	LinkedUnorderedMap<int, std::string> map;
+
+	// WHEN
+	EXPECT_TRUE(map.insertAtTail(1, "a"));
+	EXPECT_TRUE(map.insertAtTail(2, "b"));
+
+	// THEN
+	EXPECT_TRUE(map.erase(2));
+	EXPECT_FALSE(map.erase(2));
+	EXPECT_TRUE(map.insertAtTail(3, "c"));
+	EXPECT_EQ(3, map.remove(false).first);
+	EXPECT_EQ(1, map.size());
+}
+
+TEST(LinkedUnorderedMapTest, DestroyingLargeMap) {
+	// GIVEN
+	auto map = std::make_unique<LinkedUnorderedMap<int, int>>();
+
+	// WHEN
+	for (int i = 0; i < 500000; i++) {
+		map->insertAtTail(i, i);
+	}
+
+	// THEN
+	EXPECT_NO_FATAL_FAILURE(map.reset());
+}
+
+
+TEST(LinkedUnorderedMapTest, IteratesInLinkedOrder) {
+	// GIVEN
+	LinkedUnorderedMap<int, std::string> map;
+	std::vector<int> forwardKeys;
+	std::vector<std::string> reverseValues;
+
+	// WHEN
+	EXPECT_TRUE(map.insertAtTail(1, "a"));
+	EXPECT_TRUE(map.insertAtTail(2, "b"));
+	EXPECT_TRUE(map.insertAtHead(3, "c"));
+	map.moveToEnd(1);
+	for (auto [key, value] : map) {
+		forwardKeys.push_back(key);
+		value += "!";
+	}
+	for (auto it = map.rbegin(); it != map.rend(); ++it) {
+		reverseValues.push_back(it.value());
+	}
+	const LinkedUnorderedMap<int, std::string>::const_iterator first = map.begin();
+
+	// THEN
+	EXPECT_EQ(std::vector<int>({ 3, 2, 1 }), forwardKeys);
+	EXPECT_EQ(std::vector<std::string>({ "a!", "b!", "c!" }), reverseValues);
+	EXPECT_EQ(3, first.key());
+}
+
+TEST(LinkedUnorderedMapTest, IteratingEmptyMap) {
+	// GIVEN
+	const LinkedUnorderedMap<int, std::string> map;
+
+	// WHEN
+
+	// THEN
+	EXPECT_EQ(map.end(), map.begin());
+	EXPECT_EQ(map.rend(), map.rbegin());
+}
+
+TEST(LinkedUnorderedMapTest, GetMany) {
+	// GIVEN
+	LinkedUnorderedMap<int, std::string> map;
+	std::vector<int> keys;
+	for (int i = 0; i < 40; i++) {
+		map.insertAtTail(i, std::to_string(i));
+		keys.push_back(i * 2);
+	}
+
+	// WHEN
+	const std::vector<std::string*> values = map.getMany(keys);
+
+	// THEN
+	ASSERT_EQ(keys.size(), values.size());
+	for (size_t i = 0; i < keys.size(); i++) {
+		if (keys[i] < 40) {
+			ASSERT_NE(nullptr, values[i]);
+			EXPECT_EQ(std::to_string(keys[i]), *values[i]);
+		}
+		else {
+			EXPECT_EQ(nullptr, values[i]);
+		}
+	}
+}
+
+TEST(LinkedUnorderedMapTest, InsertManySkipsExistingKeys) {
+	// GIVEN
+	LinkedUnorderedMap<int, std::unique_ptr<int>> map;
+	std::vector<std::pair<int, std::unique_ptr<int>>> entries;
+	entries.emplace_back(1, std::make_unique<int>(1));
+	entries.emplace_back(2, std::make_unique<int>(2));
+	entries.emplace_back(1, std::make_unique<int>(3));
+
+	// WHEN
+	const size_t numInserted = map.insertMany(std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()));
+
+	// THEN
+	EXPECT_EQ(2, numInserted);
+	EXPECT_EQ(1, *map[1]);
+	EXPECT_EQ(2, *map[2]);
+}
+
+TEST(LinkedUnorderedMapTest, DrainFront) {
+	// GIVEN
+	LinkedUnorderedMap<int, std::string> map;
+	const std::vector<std::pair<int, std::string>> entries = { { 1, "a" }, { 2, "b" }, { 3, "c" } };
+
+	// WHEN
+	EXPECT_EQ(3, map.insertMany(entries));
+	const auto drained = map.drainFront(2);
+	const auto rest = map.drainFront(5);
+
+	// THEN
+	const std::vector<std::pair<int, std::string>> expectedDrained = { { 1, "a" }, { 2, "b" } };
+	const std::vector<std::pair<int, std::string>> expectedRest = { { 3, "c" } };
+	EXPECT_EQ(expectedDrained, drained);
+	EXPECT_EQ(expectedRest, rest);
+	EXPECT_TRUE(map.empty());
+}
+
+TEST(LinkedUnorderedMapTest, SingleThreadedPolicy) {
+	// GIVEN
+	LinkedUnorderedMap<int, std::unique_ptr<int>, std::hash<int>, std::equal_to<int>, SingleThreaded> map;
+
+	// WHEN
+	map.insertAtTail(1, std::make_unique<int>(1));
+	map.insertAtTail(2, std::make_unique<int>(2));
+	map.insertAtHead(3, std::make_unique<int>(3));
+	const std::unique_ptr<int> removed = map.remove(1);
+	const auto first = map.remove(true);
+
+	// THEN
+	EXPECT_EQ(1, *removed);
+	EXPECT_EQ(3, first.first);
+	EXPECT_EQ(1, map.size());
+	EXPECT_EQ(2, *map[2]);
+}
+
+TEST(LinkedUnorderedMapTest, EpochReclamationPolicy) {
+	// GIVEN
+	LinkedUnorderedMap<std::string, int, TransparentStringHash, std::equal_to<>, EpochReclamation> map;
+
+	// WHEN
+	map.insertAtTail("a", 1);
+	map.insertAtTail("b", 2);
+	map.insertAtHead("c", 3);
+	map.moveToEnd("c");
+	const int removed = map.remove(std::string_view("a"));
+	const std::vector<std::pair<std::string, int>> drained = map.drainFront(1);
+
+	// THEN
+	EXPECT_EQ(1, removed);
+	const std::vector<std::pair<std::string, int>> expectedDrained = { { "b", 2 } };
+	EXPECT_EQ(expectedDrained, drained);
+	EXPECT_FALSE(map.hasKey("a"));
+	EXPECT_EQ(3, map["c"]);
+	EXPECT_EQ(1, map.size());
+}
+
+TEST(LinkedUnorderedMapTest, ConcurrentReadersWithSharedMutexLocking) {
+	// GIVEN
+	LinkedUnorderedMap<int, int> map;
+	for (int key = 0; key < 100; key++) {
+		map.insertAtTail(key, key);
+	}
+	std::atomic<size_t> numFound = 0;
+
+	// WHEN
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 4; r++) {
+		readers.emplace_back([&]() {
+			for (int key = 0; key < 100; key++) {
+				numFound += map.hasKey(key);
+			}
+		});
+	}
+	for (int key = 100; key < 200; key++) {
+		map.insertAtTail(key, key);
+	}
+	for (std::thread& reader : readers) {
+		reader.join();
+	}
+
+	// THEN
+	EXPECT_EQ(400, numFound);
+	EXPECT_EQ(200, map.size());
+}
+
+TEST(LinkedUnorderedMapTest, LockFreeReadersWithEpochReclamation) {
+	// GIVEN
+	LinkedUnorderedMap<int, std::string, std::hash<int>, std::equal_to<int>, EpochReclamation> map;
+	std::atomic<bool> isWriting = true;
+	std::atomic<size_t> numMismatches = 0;
+
+	// WHEN
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 4; r++) {
+		readers.emplace_back([&]() {
+			while (isWriting) {
+				for (int key = 0; key < 64; key++) {
+					map.visit(key, [&](const std::string& value) {
+						if (value != std::to_string(key)) {
+							numMismatches++;
+						}
+					});
+				}
+			}
+		});
+	}
+	for (int round = 0; round < 50; round++) {
+		for (int key = 0; key < 64; key++) {
+			map.insertAtTail(key, std::to_string(key));
+		}
+		for (int key = 0; key < 64; key++) {
+			map.erase(key);
+		}
+	}
+	isWriting = false;
+	for (std::thread& reader : readers) {
+		reader.join();
+	}
+
+	// THEN
+	EXPECT_EQ(0, numMismatches);
+	EXPECT_TRUE(map.empty());
+}
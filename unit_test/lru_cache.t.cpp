@@ -2,9 +2,38 @@
 
 #include "../implementations/lru_cache.cpp"
 #include "../implementations/linked_unordered_map.cpp"
+#include "../implementations/concurrency_policy.cpp"
+#include "../implementations/thread_pool.cpp"
+#include "../implementations/timer_wheel.cpp"
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
 
 using namespace implementations;
 
+namespace {
+	struct FakeClock {
+		using duration = std::chrono::milliseconds;
+		using rep = duration::rep;
+		using period = duration::period;
+		using time_point = std::chrono::time_point<FakeClock>;
+		static constexpr bool is_steady = true;
+
+		static duration elapsed;
+
+		static time_point now() {
+			return time_point(elapsed);
+		}
+	};
+	FakeClock::duration FakeClock::elapsed{ 0 };
+
+	using TtlCache = LruCache<int, int, std::hash<int>, std::equal_to<int>, FakeClock>;
+}
+
 TEST(LruCacheTest, GetMovesItemToEnd) {
 	// GIVEN
 	LruCache<int, int> cache(2);
@@ -39,4 +68,467 @@ TEST(LruCacheTest, PushUpdateMovesItemToEnd) {
 	EXPECT_EQ(5, cache[1]);
 	EXPECT_TRUE(cache.hasKey(3));
 	EXPECT_FALSE(cache.hasKey(2));
-}
\ No newline at end of file
+}
+
+TEST(LruCacheTest, WeigherEvictsUntilWithinBudget) {
+	// GIVEN
+	LruCache<int, std::string> cache(10, [](const int&, const std::string& value) { return value.size(); });
+
+	// WHEN
+	cache.push(1, "aaaa");
+	cache.push(2, "bbbb");
+	cache.push(3, "cccccc");
+
+	// THEN
+	EXPECT_EQ(2, cache.size());
+	EXPECT_EQ(10, cache.weight());
+	EXPECT_FALSE(cache.hasKey(1));
+	EXPECT_TRUE(cache.hasKey(2));
+	EXPECT_TRUE(cache.hasKey(3));
+}
+
+TEST(LruCacheTest, WeigherUpdateReplacesWeight) {
+	// GIVEN
+	LruCache<int, std::string> cache(10, [](const int&, const std::string& value) { return value.size(); });
+
+	// WHEN
+	cache.push(1, "aaaa");
+	cache.push(2, "bb");
+	cache.push(1, "a");
+
+	// THEN
+	EXPECT_EQ(2, cache.size());
+	EXPECT_EQ(3, cache.weight());
+	EXPECT_EQ("a", cache[1]);
+}
+
+TEST(LruCacheTest, WeigherRejectsEntryHeavierThanCapacity) {
+	// GIVEN
+	LruCache<int, std::string> cache(4, [](const int&, const std::string& value) { return value.size(); });
+
+	// WHEN
+	cache.push(1, "aa");
+	cache.push(2, "bbbbbbbb");
+
+	// THEN
+	EXPECT_EQ(1, cache.size());
+	EXPECT_EQ(2, cache.weight());
+	EXPECT_TRUE(cache.hasKey(1));
+	EXPECT_FALSE(cache.hasKey(2));
+}
+
+
+TEST(LruCacheTest, DefaultTtlExpiresEntries) {
+	// GIVEN
+	FakeClock::elapsed = std::chrono::milliseconds(0);
+	TtlCache cache(10, std::chrono::seconds(5));
+
+	// WHEN
+	cache.push(1, 2);
+	FakeClock::elapsed = std::chrono::seconds(3);
+	cache.push(2, 3);
+	FakeClock::elapsed = std::chrono::seconds(5);
+
+	// THEN
+	EXPECT_FALSE(cache.hasKey(1));
+	EXPECT_THROW(cache.get(1), std::invalid_argument);
+	ASSERT_TRUE(cache.hasKey(2));
+	EXPECT_EQ(3, cache.get(2));
+	EXPECT_EQ(1, cache.size());
+}
+
+TEST(LruCacheTest, PerEntryTtlOverridesDefault) {
+	// GIVEN
+	FakeClock::elapsed = std::chrono::milliseconds(0);
+	TtlCache cache(10);
+
+	// WHEN
+	cache.push(1, 2);
+	cache.push(2, 3, std::chrono::milliseconds(1500));
+	FakeClock::elapsed = std::chrono::hours(1);
+
+	// THEN
+	EXPECT_TRUE(cache.hasKey(1));
+	EXPECT_FALSE(cache.hasKey(2));
+	EXPECT_EQ(2, cache.get(1));
+}
+
+TEST(LruCacheTest, RemoveExpiredReclaimsWithoutLookup) {
+	// GIVEN
+	FakeClock::elapsed = std::chrono::milliseconds(0);
+	TtlCache cache(10, [](const int&, const int& value) -> size_t { return value; }, std::chrono::seconds(1));
+
+	// WHEN
+	cache.push(1, 4);
+	cache.push(2, 5, std::chrono::minutes(10));
+	FakeClock::elapsed = std::chrono::seconds(2);
+	const size_t numRemoved = cache.removeExpired();
+
+	// THEN
+	EXPECT_EQ(1, numRemoved);
+	EXPECT_EQ(1, cache.size());
+	EXPECT_EQ(5, cache.weight());
+}
+
+TEST(LruCacheTest, PushResetsTtl) {
+	// GIVEN
+	FakeClock::elapsed = std::chrono::milliseconds(0);
+	TtlCache cache(10, std::chrono::seconds(5));
+
+	// WHEN
+	cache.push(1, 2);
+	FakeClock::elapsed = std::chrono::seconds(4);
+	cache.push(1, 3);
+	FakeClock::elapsed = std::chrono::seconds(8);
+
+	// THEN
+	ASSERT_TRUE(cache.hasKey(1));
+	EXPECT_EQ(3, cache.get(1));
+	EXPECT_EQ(0, cache.removeExpired());
+}
+
+
+TEST(LruCacheTest, GetIfPresentReturnsEmptyOnMiss) {
+	// GIVEN
+	LruCache<int, int> cache(2);
+
+	// WHEN
+	cache.push(1, 2);
+
+	// THEN
+	EXPECT_EQ(2, cache.getIfPresent(1));
+	EXPECT_FALSE(cache.getIfPresent(2).has_value());
+}
+
+TEST(LruCacheTest, GetOrLoadCachesLoadedValue) {
+	// GIVEN
+	LruCache<int, int> cache(2);
+	size_t numLoads = 0;
+	const auto loader = [&numLoads](const int& key) {
+		numLoads++;
+		return key * 10;
+	};
+
+	// WHEN
+	const int loaded = cache.getOrLoad(4, loader);
+	const int cached = cache.getOrLoad(4, loader);
+
+	// THEN
+	EXPECT_EQ(40, loaded);
+	EXPECT_EQ(40, cached);
+	EXPECT_EQ(1, numLoads);
+	EXPECT_TRUE(cache.hasKey(4));
+}
+
+TEST(LruCacheTest, GetOrLoadCoalescesConcurrentMisses) {
+	// GIVEN
+	LruCache<int, int> cache(2);
+	std::atomic<size_t> numLoads = 0;
+	std::vector<int> results(16);
+	std::vector<std::thread> threads;
+
+	// WHEN
+	for (size_t i = 0; i < results.size(); i++) {
+		threads.emplace_back([&cache, &numLoads, &results, i]() {
+			results[i] = cache.getOrLoad(7, [&numLoads](const int& key) {
+				numLoads++;
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				return key + 1;
+			});
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	// THEN
+	EXPECT_EQ(1, numLoads);
+	EXPECT_EQ(std::vector<int>(results.size(), 8), results);
+}
+
+TEST(LruCacheTest, GetOrLoadPropagatesLoaderFailureWithoutCaching) {
+	// GIVEN
+	LruCache<int, int> cache(2);
+
+	// WHEN
+	EXPECT_THROW(cache.getOrLoad(1, [](const int&) -> int { throw std::runtime_error("backend unavailable"); }), std::runtime_error);
+
+	// THEN
+	EXPECT_FALSE(cache.hasKey(1));
+	EXPECT_EQ(5, cache.getOrLoad(1, [](const int&) { return 5; }));
+}
+
+
+TEST(LruCacheTest, PushMovesValueIntoCache) {
+	// GIVEN
+	LruCache<int, std::unique_ptr<int>> cache(2);
+
+	// WHEN
+	cache.push(1, std::make_unique<int>(2));
+	cache.push(2, std::make_unique<int>(3));
+	cache.push(3, std::make_unique<int>(4));
+
+	// THEN
+	EXPECT_EQ(2, cache.size());
+	EXPECT_FALSE(cache.hasKey(1));
+	EXPECT_EQ(4, *cache.get(3));
+}
+
+TEST(LruCacheTest, HeterogeneousLookup) {
+	// GIVEN
+	LruCache<std::string, int, TransparentStringHash, std::equal_to<>> cache(2);
+	const std::string_view key = "key";
+
+	// WHEN
+	cache.push("key", 1);
+
+	// THEN
+	EXPECT_TRUE(cache.hasKey(key));
+	EXPECT_EQ(1, cache.get(key));
+	EXPECT_EQ(1, cache.getIfPresent(key));
+	EXPECT_FALSE(cache.getIfPresent(std::string_view("missing")).has_value());
+}
+
+
+TEST(LruCacheTest, StatsAreNotRecordedByDefault) {
+	// GIVEN
+	LruCache<int, int> cache(2);
+
+	// WHEN
+	cache.push(1, 2);
+	cache.get(1);
+	cache.getIfPresent(2);
+
+	// THEN
+	const CacheStats stats = cache.stats();
+	EXPECT_EQ(0, stats.hits);
+	EXPECT_EQ(0, stats.misses);
+	EXPECT_EQ(0, stats.inserts);
+	EXPECT_EQ(1, stats.size);
+}
+
+TEST(LruCacheTest, StatsCountHitsMissesAndEvictions) {
+	// GIVEN
+	LruCache<int, int> cache(2, [](const int&, const int& value) -> size_t { return value; });
+	cache.recordStats();
+
+	// WHEN
+	cache.push(1, 1);
+	cache.push(2, 1);
+	cache.get(1);
+	cache.getIfPresent(3);
+	EXPECT_THROW(cache.get(4), std::invalid_argument);
+	cache.push(3, 2);
+	cache.getOrLoad(5, [](const int&) { return 1; });
+
+	// THEN
+	const CacheStats stats = cache.stats();
+	EXPECT_EQ(1, stats.hits);
+	EXPECT_EQ(3, stats.misses);
+	EXPECT_EQ(4, stats.inserts);
+	EXPECT_EQ(3, stats.evictions);
+	EXPECT_EQ(4, stats.evictedWeight);
+	EXPECT_EQ(1, stats.loadSuccesses);
+	EXPECT_EQ(0, stats.loadFailures);
+	EXPECT_DOUBLE_EQ(0.25, stats.hitRatio());
+	EXPECT_EQ(1, stats.size);
+	EXPECT_EQ(1, stats.weight);
+}
+
+TEST(LruCacheTest, EvictionListenerReceivesEvictedValues) {
+	// GIVEN
+	FakeClock::elapsed = std::chrono::milliseconds(0);
+	TtlCache cache(3);
+	std::vector<std::tuple<int, int, EvictionCause>> evicted;
+	cache.setEvictionListener([&evicted](const int& key, int&& value, const EvictionCause cause) {
+		evicted.emplace_back(key, value, cause);
+	});
+	cache.recordStats();
+
+	// WHEN
+	cache.push(1, 10, std::chrono::seconds(1));
+	cache.push(2, 20);
+	cache.push(3, 30);
+	FakeClock::elapsed = std::chrono::seconds(2);
+	cache.push(4, 40);
+	cache.push(2, 21);
+	cache.push(5, 50);
+
+	// THEN
+	const std::vector<std::tuple<int, int, EvictionCause>> expected = {
+		{ 1, 10, EvictionCause::Expired },
+		{ 3, 30, EvictionCause::Capacity }
+	};
+	EXPECT_EQ(expected, evicted);
+	EXPECT_EQ(1, cache.stats().evictions);
+	EXPECT_EQ(1, cache.stats().expirations);
+}
+
+TEST(LruCacheTest, EvictionListenerReceivesExpiredValues) {
+	// GIVEN
+	FakeClock::elapsed = std::chrono::milliseconds(0);
+	TtlCache cache(5);
+	std::vector<std::pair<int, EvictionCause>> evicted;
+	cache.setEvictionListener([&evicted](const int& key, int&&, const EvictionCause cause) {
+		evicted.emplace_back(key, cause);
+	});
+	cache.recordStats();
+
+	// WHEN
+	cache.push(1, 10, std::chrono::seconds(1));
+	cache.push(2, 20, std::chrono::seconds(3));
+	FakeClock::elapsed = std::chrono::seconds(2);
+	cache.removeExpired();
+
+	// THEN
+	ASSERT_EQ(1, evicted.size());
+	EXPECT_EQ(std::make_pair(1, EvictionCause::Expired), evicted[0]);
+	EXPECT_EQ(1, cache.stats().expirations);
+	EXPECT_EQ(0, cache.stats().evictions);
+}
+
+TEST(LruCacheTest, RemoveSkipsEvictionListener) {
+	// GIVEN
+	LruCache<int, std::string> cache(2);
+	size_t numEvicted = 0;
+	cache.setEvictionListener([&numEvicted](const int&, std::string&&, const EvictionCause) { numEvicted++; });
+	cache.push(1, "a");
+
+	// WHEN
+	const std::optional<std::string> removed = cache.remove(1);
+	const std::optional<std::string> missing = cache.remove(1);
+
+	// THEN
+	EXPECT_EQ("a", removed);
+	EXPECT_FALSE(missing.has_value());
+	EXPECT_EQ(0, numEvicted);
+	EXPECT_TRUE(cache.empty());
+	EXPECT_EQ(0, cache.weight());
+}
+
+namespace {
+	// returns once every task submitted to the single threaded pool before the call has run
+	void drain(ThreadPool& pool) {
+		std::promise<void> done;
+		while (!pool.trySubmit([&done]() { done.set_value(); })) {
+			std::this_thread::yield();
+		}
+		done.get_future().wait();
+	}
+}
+
+TEST(LruCacheTest, RefreshAheadReloadsHotEntryInBackground) {
+	// GIVEN
+	FakeClock::elapsed = std::chrono::milliseconds(0);
+	const auto pool = std::make_shared<ThreadPool>(1, 4);
+	TtlCache cache(10, std::chrono::seconds(10));
+	cache.recordStats();
+	std::atomic<int> numLoads = 0;
+	cache.setRefreshAhead([&numLoads](const int& key) { return key * 10 + ++numLoads; }, 0.5, pool);
+	cache.push(1, 10);
+
+	// WHEN
+	FakeClock::elapsed = std::chrono::seconds(4);
+	const std::optional<int> beforeDue = cache.getIfPresent(1);
+	drain(*pool);
+	FakeClock::elapsed = std::chrono::seconds(6);
+	const std::optional<int> whileRefreshing = cache.getIfPresent(1);
+	drain(*pool);
+	const std::optional<int> afterRefresh = cache.getIfPresent(1);
+	FakeClock::elapsed = std::chrono::seconds(12);
+
+	// THEN
+	EXPECT_EQ(10, beforeDue);
+	EXPECT_EQ(10, whileRefreshing);
+	EXPECT_EQ(11, afterRefresh);
+	EXPECT_EQ(1, numLoads);
+	EXPECT_EQ(1, cache.stats().refreshes);
+	// the reloaded entry got a fresh time to live
+	EXPECT_TRUE(cache.hasKey(1));
+}
+
+TEST(LruCacheTest, PushDuringRefreshWins) {
+	// GIVEN
+	FakeClock::elapsed = std::chrono::milliseconds(0);
+	const auto pool = std::make_shared<ThreadPool>(1, 4);
+	TtlCache cache(10, std::chrono::seconds(10));
+	std::promise<void> release;
+	std::shared_future<void> released = release.get_future().share();
+	cache.setRefreshAhead([released](const int&) { released.wait(); return -1; }, 0.5, pool);
+	cache.push(1, 10);
+	FakeClock::elapsed = std::chrono::seconds(8);
+
+	// WHEN
+	cache.getIfPresent(1);
+	cache.push(1, 20);
+	release.set_value();
+	drain(*pool);
+
+	// THEN
+	EXPECT_EQ(20, cache.getIfPresent(1));
+}
+
+TEST(LruCacheTest, EvictionDuringRefreshDropsTheReload) {
+	// GIVEN
+	FakeClock::elapsed = std::chrono::milliseconds(0);
+	const auto pool = std::make_shared<ThreadPool>(1, 4);
+	TtlCache cache(1, std::chrono::seconds(10));
+	std::vector<int> evictedKeys;
+	cache.setEvictionListener([&evictedKeys](const int& key, int&&, const EvictionCause) { evictedKeys.push_back(key); });
+	std::promise<void> release;
+	std::shared_future<void> released = release.get_future().share();
+	cache.setRefreshAhead([released](const int&) { released.wait(); return -1; }, 0.5, pool);
+	cache.push(1, 10);
+	FakeClock::elapsed = std::chrono::seconds(8);
+
+	// WHEN
+	cache.getIfPresent(1);
+	cache.push(2, 20);
+	release.set_value();
+	drain(*pool);
+
+	// THEN
+	EXPECT_FALSE(cache.hasKey(1));
+	EXPECT_EQ(20, cache.getIfPresent(2));
+	EXPECT_EQ(std::vector<int>({ 1 }), evictedKeys);
+}
+
+TEST(LruCacheTest, RefreshThatCannotBeStoredKeepsTheValue) {
+	// GIVEN
+	FakeClock::elapsed = std::chrono::milliseconds(0);
+	const auto pool = std::make_shared<ThreadPool>(1, 4);
+	{
+		TtlCache cache(10, [](const int&, const int& value) -> size_t {
+			if (value < 0) {
+				throw std::runtime_error("Cannot weigh a reloaded value");
+			}
+			return 1;
+		}, std::chrono::seconds(10));
+		cache.recordStats();
+		cache.setRefreshAhead([](const int&) { return -1; }, 0.5, pool);
+		cache.push(1, 10);
+		FakeClock::elapsed = std::chrono::seconds(8);
+
+		// WHEN
+		cache.getIfPresent(1);
+		drain(*pool);
+
+		// THEN
+		EXPECT_EQ(10, cache.getIfPresent(1));
+		EXPECT_EQ(1, cache.stats().loadFailures);
+	}
+}
+
+TEST(LruCacheTest, RefreshAheadRejectsBadFraction) {
+	// GIVEN
+	LruCache<int, int> cache(10);
+	const auto pool = std::make_shared<ThreadPool>(1, 1);
+	const auto loader = [](const int& key) { return key; };
+
+	// WHEN
+
+	// THEN
+	EXPECT_THROW(cache.setRefreshAhead(loader, 0, pool), std::invalid_argument);
+	EXPECT_THROW(cache.setRefreshAhead(loader, 1, pool), std::invalid_argument);
+	EXPECT_THROW(cache.setRefreshAhead(loader, 0.5, nullptr), std::invalid_argument);
+}
@@ -0,0 +1,57 @@
+#include "pch.h"
+
+#include "../implementations/lz_codec.cpp"
+#include <stdexcept>
+#include <string>
+
+using namespace implementations;
+
+TEST(LzCodecTest, RoundTripsRepetitiveText) {
+	// GIVEN
+	std::string text;
+	for (int i = 0; i < 200; i++) {
+		text += "the quick brown fox jumps over the lazy dog " + std::to_string(i % 7) + "\n";
+	}
+
+	// WHEN
+	const std::string compressed = LzCodec::compress(text);
+
+	// THEN
+	EXPECT_LT(compressed.size(), text.size() / 4);
+	EXPECT_EQ(text, LzCodec::decompress(compressed));
+}
+
+TEST(LzCodecTest, RoundTripsEdgeCases) {
+	// GIVEN
+	std::string incompressible;
+	uint32_t state = 12345;
+	for (int i = 0; i < 5000; i++) {
+		state = state * 1103515245 + 12345;
+		incompressible.push_back(static_cast<char>(state >> 24));
+	}
+	const std::string inputs[] = { "", "a", "abc", "abcd", std::string(100000, 'x'), "abcabcabcabcabcabcabc", incompressible };
+
+	// WHEN
+	for (const std::string& input : inputs) {
+		const std::string roundTripped = LzCodec::decompress(LzCodec::compress(input));
+
+		// THEN
+		EXPECT_EQ(input, roundTripped);
+	}
+}
+
+TEST(LzCodecTest, RejectsCorruptInput) {
+	// GIVEN
+	const std::string compressed = LzCodec::compress(std::string(1000, 'y') + "tail");
+
+	// WHEN
+	const std::string truncated = compressed.substr(0, compressed.size() - 3);
+	std::string badOffset = compressed;
+	badOffset[4] = static_cast<char>(0xff);
+	badOffset[5] = static_cast<char>(0xff);
+
+	// THEN
+	EXPECT_THROW(LzCodec::decompress(truncated), std::runtime_error);
+	EXPECT_THROW(LzCodec::decompress(badOffset), std::runtime_error);
+	EXPECT_THROW(LzCodec::decompress(""), std::runtime_error);
+}
@@ -0,0 +1,59 @@
+#include "pch.h"
+
+#include "../implementations/mpsc_queue.cpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace implementations;
+
+TEST(MpscQueueTest, PopsInPushOrder) {
+	// GIVEN
+	MpscQueue<std::string> queue;
+	const bool wasEmpty = queue.push("a");
+	const bool wasEmptyAgain = queue.push("b");
+	queue.push("c");
+
+	// WHEN
+	const std::vector<std::string> values = queue.popAll();
+
+	// THEN
+	EXPECT_TRUE(wasEmpty);
+	EXPECT_FALSE(wasEmptyAgain);
+	EXPECT_EQ(std::vector<std::string>({ "a", "b", "c" }), values);
+	EXPECT_TRUE(queue.isEmpty());
+	EXPECT_TRUE(queue.popAll().empty());
+}
+
+TEST(MpscQueueTest, ConcurrentProducersLoseNothing) {
+	// GIVEN
+	MpscQueue<size_t> queue;
+	std::vector<std::thread> producers;
+	std::vector<size_t> values;
+
+	// WHEN
+	for (size_t i = 0; i < 4; i++) {
+		producers.emplace_back([&queue, i]() {
+			for (size_t j = 0; j < 10000; j++) {
+				queue.push(i * 10000 + j);
+			}
+		});
+	}
+	while (values.size() < 40000) {
+		for (const size_t value : queue.popAll()) {
+			values.push_back(value);
+		}
+	}
+	for (std::thread& producer : producers) {
+		producer.join();
+	}
+
+	// THEN
+	// each producer's values come out in the order it pushed them
+	std::vector<size_t> nextOf(4, 0);
+	for (const size_t value : values) {
+		EXPECT_EQ(nextOf[value / 10000]++, value % 10000);
+	}
+	EXPECT_EQ(std::vector<size_t>(4, 10000), nextOf);
+}
@@ -0,0 +1,134 @@
+#include "pch.h"
+
+#include "../implementations/name_index.cpp"
+#include "../implementations/linked_unordered_map.cpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace implementations;
+
+namespace {
+	using Index = NameIndex<int, std::string>;
+
+	std::vector<int> collect(const Index& index, const char* query, const bool isPattern) {
+		std::vector<int> keys;
+		const auto visitor = [&keys](const std::string&, const int key, const std::string&) { keys.push_back(key); };
+		if (isPattern) {
+			index.forEachMatching(query, visitor);
+		}
+		else {
+			index.forEachContaining(query, visitor);
+		}
+		std::sort(keys.begin(), keys.end());
+		return keys;
+	}
+}
+
+TEST(NameIndexTest, InsertAndErase) {
+	// GIVEN
+	Index index;
+
+	// WHEN
+	const bool isFirstInserted = index.insert("f.txt", 1, "/a");
+	const bool isSecondInserted = index.insert("f.txt", 2, "/b");
+	const bool isDuplicateInserted = index.insert("f.txt", 1, "/c");
+	const bool isMissingErased = index.erase("g.txt", 1);
+	const bool isErased = index.erase("f.txt", 1);
+
+	// THEN
+	EXPECT_TRUE(isFirstInserted);
+	EXPECT_TRUE(isSecondInserted);
+	EXPECT_FALSE(isDuplicateInserted);
+	EXPECT_FALSE(isMissingErased);
+	EXPECT_TRUE(isErased);
+	EXPECT_EQ(1, index.size());
+	EXPECT_EQ(1, index.numNames());
+	std::vector<std::string> values;
+	index.forEachNamed("f.txt", [&values](const std::string&, int, const std::string& value) { values.push_back(value); });
+	EXPECT_EQ(std::vector<std::string>({ "/b" }), values);
+}
+
+TEST(NameIndexTest, InsertReplacesTheValueOfAKnownKey) {
+	// GIVEN
+	Index index;
+	index.insert("f.txt", 1, "/a");
+
+	// WHEN
+	const bool isInserted = index.insert("f.txt", 1, "/b");
+
+	// THEN
+	EXPECT_FALSE(isInserted);
+	EXPECT_EQ(1, index.size());
+	std::vector<std::string> values;
+	index.forEachNamed("f.txt", [&values](const std::string&, int, const std::string& value) { values.push_back(value); });
+	EXPECT_EQ(std::vector<std::string>({ "/b" }), values);
+}
+
+TEST(NameIndexTest, FindsNamesContainingFragment) {
+	// GIVEN
+	Index index;
+	index.insert("main.cpp", 1, "");
+	index.insert("domain.h", 2, "");
+	index.insert("readme.md", 3, "");
+	index.insert("ma", 4, "");
+
+	// WHEN
+	const auto longFragment = collect(index, "main", false);
+	const auto shortFragment = collect(index, "ma", false);
+	const auto missingFragment = collect(index, "xyz", false);
+
+	// THEN
+	EXPECT_EQ(std::vector<int>({ 1, 2 }), longFragment);
+	EXPECT_EQ(std::vector<int>({ 1, 2, 4 }), shortFragment);
+	EXPECT_TRUE(missingFragment.empty());
+}
+
+TEST(NameIndexTest, FindsNamesMatchingPattern) {
+	// GIVEN
+	Index index;
+	index.insert("main.cpp", 1, "");
+	index.insert("main.h", 2, "");
+	index.insert("test_main.cpp", 3, "");
+	index.insert("a.c", 4, "");
+
+	// WHEN
+	const auto sources = collect(index, "*.cpp", true);
+	const auto mains = collect(index, "main.*", true);
+	const auto singleCharacter = collect(index, "?.c", true);
+	const auto everything = collect(index, "*", true);
+
+	// THEN
+	EXPECT_EQ(std::vector<int>({ 1, 3 }), sources);
+	EXPECT_EQ(std::vector<int>({ 1, 2 }), mains);
+	EXPECT_EQ(std::vector<int>({ 4 }), singleCharacter);
+	EXPECT_EQ(std::vector<int>({ 1, 2, 3, 4 }), everything);
+}
+
+TEST(NameIndexTest, ErasedNamesLeaveTheTrigrams) {
+	// GIVEN
+	Index index;
+	index.insert("abcdef", 1, "");
+	index.insert("abcxyz", 2, "");
+
+	// WHEN
+	index.erase("abcdef", 1);
+
+	// THEN
+	EXPECT_TRUE(collect(index, "def", false).empty());
+	EXPECT_EQ(std::vector<int>({ 2 }), collect(index, "abc", false));
+	EXPECT_EQ(1, index.numNames());
+}
+
+TEST(NameIndexTest, GlobMatches) {
+	// GIVEN
+
+	// WHEN
+
+	// THEN
+	EXPECT_TRUE(Index::globMatches("a*b?d", "axxbcd"));
+	EXPECT_TRUE(Index::globMatches("**", ""));
+	EXPECT_FALSE(Index::globMatches("a*b", "axxbc"));
+	EXPECT_FALSE(Index::globMatches("?", ""));
+}
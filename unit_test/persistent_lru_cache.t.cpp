@@ -0,0 +1,172 @@
+#include "pch.h"
+
+#include "../implementations/persistent_lru_cache.cpp"
+#include "../implementations/mapped_file.cpp"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+using namespace implementations;
+
+namespace {
+	struct TempFile {
+		std::string path;
+
+		TempFile(const std::string& name)
+			: path((std::filesystem::temp_directory_path() / name).string()) {
+			std::filesystem::remove(path);
+		}
+		~TempFile() {
+			std::filesystem::remove(path);
+		}
+	};
+
+	struct Point {
+		int x;
+		int y;
+	};
+}
+
+TEST(PersistentLruCacheTest, GetMovesItemToEnd) {
+	// GIVEN
+	TempFile file("persistent_lru_cache_get.bin");
+	PersistentLruCache<int, int> cache(file.path, 2);
+
+	// WHEN
+	cache.push(1, 2);
+	cache.push(2, 3);
+	cache.get(1);
+	cache.push(3, 4);
+
+	// THEN
+	EXPECT_FALSE(cache.wasRecovered());
+	EXPECT_EQ(2, cache.size());
+	EXPECT_EQ(2, cache.get(1));
+	EXPECT_EQ(4, cache.get(3));
+	EXPECT_FALSE(cache.get(2).has_value());
+}
+
+TEST(PersistentLruCacheTest, ReopensWarm) {
+	// GIVEN
+	TempFile file("persistent_lru_cache_reopen.bin");
+	{
+		PersistentLruCache<int, Point> cache(file.path, 3);
+		cache.push(1, Point{ 1, 1 });
+		cache.push(2, Point{ 2, 2 });
+		cache.push(3, Point{ 3, 3 });
+		cache.remove(2);
+		cache.get(1);
+	}
+
+	// WHEN
+	PersistentLruCache<int, Point> cache(file.path, 3);
+	cache.push(4, Point{ 4, 4 });
+	cache.push(5, Point{ 5, 5 });
+
+	// THEN
+	EXPECT_TRUE(cache.wasRecovered());
+	EXPECT_EQ(3, cache.size());
+	EXPECT_FALSE(cache.hasKey(3));
+	ASSERT_TRUE(cache.hasKey(1));
+	EXPECT_EQ(1, cache.get(1)->y);
+	EXPECT_EQ(5, cache.get(5)->x);
+}
+
+TEST(PersistentLruCacheTest, CorruptHeaderFallsBackToEmpty) {
+	// GIVEN
+	TempFile file("persistent_lru_cache_corrupt.bin");
+	{
+		PersistentLruCache<int, int> cache(file.path, 4);
+		cache.push(1, 2);
+	}
+	{
+		std::fstream stream(file.path, std::ios::in | std::ios::out | std::ios::binary);
+		stream.seekp(sizeof(uint64_t) + sizeof(uint32_t));
+		stream.put('x');
+	}
+
+	// WHEN
+	PersistentLruCache<int, int> cache(file.path, 4);
+
+	// THEN
+	EXPECT_FALSE(cache.wasRecovered());
+	EXPECT_TRUE(cache.empty());
+	cache.push(1, 3);
+	EXPECT_EQ(3, cache.get(1));
+}
+
+TEST(PersistentLruCacheTest, CorruptEntryIsDropped) {
+	// GIVEN
+	TempFile file("persistent_lru_cache_corrupt_entry.bin");
+	const int torn = 0x5a5a5a5a;
+	{
+		PersistentLruCache<int, int> cache(file.path, 4);
+		cache.push(1, 2);
+		cache.push(2, torn);
+		cache.push(3, 4);
+	}
+	{
+		std::fstream stream(file.path, std::ios::in | std::ios::out | std::ios::binary);
+		const std::string bytes((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+		const size_t offset = bytes.find(std::string(reinterpret_cast<const char*>(&torn), sizeof(int)));
+		ASSERT_NE(std::string::npos, offset);
+		stream.seekp(offset);
+		stream.put('x');
+	}
+
+	// WHEN
+	PersistentLruCache<int, int> cache(file.path, 4);
+
+	// THEN
+	EXPECT_TRUE(cache.wasRecovered());
+	EXPECT_EQ(2, cache.size());
+	EXPECT_FALSE(cache.hasKey(2));
+	EXPECT_EQ(2, cache.get(1));
+	EXPECT_EQ(4, cache.get(3));
+	cache.push(5, 6);
+	cache.push(7, 8);
+	EXPECT_EQ(4, cache.size());
+}
+
+TEST(PersistentLruCacheTest, UncleanFileIsRecovered) {
+	// GIVEN
+	TempFile file("persistent_lru_cache_unclean.bin");
+	TempFile copy("persistent_lru_cache_unclean_copy.bin");
+	{
+		PersistentLruCache<int, int> cache(file.path, 4);
+		cache.push(1, 2);
+		cache.flush();
+		cache.push(2, 3);
+		cache.get(1);
+		std::filesystem::copy_file(file.path, copy.path);
+	}
+
+	// WHEN
+	PersistentLruCache<int, int> crashed(copy.path, 4);
+	crashed.push(3, 4);
+	crashed.push(4, 5);
+	crashed.push(5, 6);
+
+	// THEN
+	EXPECT_TRUE(crashed.wasRecovered());
+	EXPECT_EQ(4, crashed.size());
+	EXPECT_FALSE(crashed.hasKey(2));
+	EXPECT_EQ(2, crashed.get(1));
+}
+
+TEST(PersistentLruCacheTest, DifferentCapacityFallsBackToEmpty) {
+	// GIVEN
+	TempFile file("persistent_lru_cache_capacity.bin");
+	{
+		PersistentLruCache<int, int> cache(file.path, 4);
+		cache.push(1, 2);
+	}
+
+	// WHEN
+	PersistentLruCache<int, int> cache(file.path, 8);
+
+	// THEN
+	EXPECT_FALSE(cache.wasRecovered());
+	EXPECT_TRUE(cache.empty());
+	EXPECT_EQ(8, cache.capacity());
+}
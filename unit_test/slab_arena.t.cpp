@@ -0,0 +1,119 @@
+#include "pch.h"
+
+#include "../implementations/slab_arena.cpp"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace implementations;
+
+TEST(SlabArenaTest, ReusesFreedSlots) {
+	// GIVEN
+	SlabArena arena(4);
+	void* first = arena.allocate(24);
+	arena.allocate(24);
+
+	// WHEN
+	arena.deallocate(first, 24);
+	void* reused = arena.allocate(20);
+
+	// THEN
+	EXPECT_EQ(first, reused);
+	EXPECT_EQ(1, arena.numChunks());
+	EXPECT_EQ(2, arena.numSlotsInUse());
+}
+
+TEST(SlabArenaTest, SizesHaveTheirOwnChunks) {
+	// GIVEN
+	SlabArena arena(2);
+
+	// WHEN
+	for (size_t i = 0; i < 3; i++) {
+		arena.allocate(8);
+	}
+	void* large = arena.allocate(100);
+
+	// THEN
+	EXPECT_EQ(3, arena.numChunks());
+	EXPECT_EQ(4, arena.numSlotsInUse());
+	EXPECT_EQ(0, reinterpret_cast<uintptr_t>(large) % alignof(std::max_align_t));
+	EXPECT_EQ(SlabArena::slotSizeOf(100), SlabArena::slotSizeOf(SlabArena::slotSizeOf(100)));
+}
+
+TEST(SlabArenaTest, SharedObjectsKeepTheArenaAlive) {
+	// GIVEN
+	auto arena = std::make_shared<SlabArena>();
+	std::vector<std::shared_ptr<std::string>> strings;
+	for (int i = 0; i < 10; i++) {
+		strings.push_back(std::allocate_shared<std::string>(SlabAllocator<std::string>(arena), std::to_string(i)));
+	}
+	std::weak_ptr<SlabArena> weakArena = arena;
+
+	// WHEN
+	arena.reset();
+
+	// THEN
+	EXPECT_FALSE(weakArena.expired());
+	EXPECT_EQ(10, weakArena.lock()->numSlotsInUse());
+	EXPECT_EQ("7", *strings[7]);
+	strings.clear();
+	EXPECT_TRUE(weakArena.expired());
+}
+
+TEST(SlabArenaTest, ArraysBypassTheArena) {
+	// GIVEN
+	auto arena = std::make_shared<SlabArena>();
+	SlabAllocator<int> allocator(arena);
+
+	// WHEN
+	int* array = allocator.allocate(16);
+
+	// THEN
+	EXPECT_EQ(0, arena->numSlotsInUse());
+	allocator.deallocate(array, 16);
+}
+
+TEST(SlabArenaTest, ConcurrentAllocationsOfSeveralSizes) {
+	// GIVEN
+	SlabArena arena(16);
+	std::vector<std::vector<void*>> slots(4);
+
+	// WHEN
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < slots.size(); i++) {
+		threads.emplace_back([&arena, &slots, i]() {
+			// two threads per size, each freeing half of what it took
+			const size_t size = 16 * (1 + i % 2);
+			for (size_t j = 0; j < 1000; j++) {
+				slots[i].push_back(arena.allocate(size));
+				if (j % 2 == 1) {
+					arena.deallocate(slots[i].back(), size);
+					slots[i].pop_back();
+				}
+			}
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	// THEN
+	std::set<void*> distinctSlots;
+	for (const std::vector<void*>& threadSlots : slots) {
+		distinctSlots.insert(threadSlots.cbegin(), threadSlots.cend());
+	}
+	EXPECT_EQ(2000, distinctSlots.size());
+	EXPECT_EQ(2000, arena.numSlotsInUse());
+}
+
+TEST(SlabArenaTest, EmptyChunksAreRejected) {
+	// GIVEN
+
+	// WHEN
+
+	// THEN
+	EXPECT_THROW(SlabArena(0), std::invalid_argument);
+}
@@ -0,0 +1,83 @@
+#include "pch.h"
+
+#include "../implementations/string_pool.cpp"
+
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace implementations;
+
+TEST(StringPoolTest, EqualStringsShareOneCopy) {
+	// GIVEN
+	StringPool pool;
+
+	// WHEN
+	const InternedString first = pool.intern("name.txt");
+	const InternedString second = pool.intern(std::string("name") + ".txt");
+	const InternedString other = pool.intern("other.txt");
+
+	// THEN
+	EXPECT_EQ(&first.str(), &second.str());
+	EXPECT_NE(&first.str(), &other.str());
+	EXPECT_EQ("name.txt", first);
+	EXPECT_EQ(8, first.size());
+	EXPECT_EQ(2, pool.size());
+}
+
+TEST(StringPoolTest, StringIsFreedWithItsLastHandle) {
+	// GIVEN
+	StringPool pool;
+	std::optional<InternedString> first = pool.intern("a");
+	InternedString copy = *first;
+
+	// WHEN
+	first.reset();
+	const size_t sizeWhileCopied = pool.size();
+	copy = pool.intern("b");
+
+	// THEN
+	EXPECT_EQ(1, sizeWhileCopied);
+	EXPECT_EQ(1, pool.size());
+	EXPECT_EQ("b", copy);
+	EXPECT_TRUE(InternedString().empty());
+}
+
+TEST(StringPoolTest, HandlesOutliveThePool) {
+	// GIVEN
+	std::optional<StringPool> pool(std::in_place);
+	const InternedString name = pool->intern("kept");
+
+	// WHEN
+	pool.reset();
+
+	// THEN
+	EXPECT_EQ("kept", name);
+}
+
+TEST(StringPoolTest, ConcurrentInternAndRelease) {
+	// GIVEN
+	StringPool pool;
+	const InternedString held = pool.intern("0");
+
+	// WHEN
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < 4; i++) {
+		threads.emplace_back([&pool, &held]() {
+			for (size_t j = 0; j < 10000; j++) {
+				const InternedString name = pool.intern(std::to_string(j % 4));
+				const InternedString copy = held;
+				if (name.size() != 1 || copy != "0") {
+					FAIL();
+				}
+			}
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	// THEN
+	EXPECT_EQ(1, pool.size());
+}
@@ -0,0 +1,136 @@
+#include "pch.h"
+
+#include "../implementations/swiss_table.cpp"
+#include "../implementations/concurrency_policy.cpp"
+#include "../implementations/linked_unordered_map.cpp"
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace implementations;
+
+TEST(SeededHashTest, SeedChangesHashButNotEquality) {
+	// GIVEN
+	const SeededHash first(1, 2);
+	const SeededHash second(3, 4);
+	const std::string key = "a fairly long key that spans several words";
+
+	// WHEN
+	const size_t hash = first(key);
+
+	// THEN
+	EXPECT_EQ(hash, first(std::string_view(key)));
+	EXPECT_EQ(hash, first(key.c_str()));
+	EXPECT_NE(hash, second(key));
+	EXPECT_NE(first(std::string("")), first(std::string(1, '\0')));
+	EXPECT_NE(first(1), second(1));
+	EXPECT_NE(first(1), first(2));
+}
+
+TEST(SwissTableTest, EmplaceFindErase) {
+	// GIVEN
+	SwissTable<std::string, int, SeededHash, std::equal_to<>> table;
+
+	// WHEN
+	for (int i = 0; i < 1000; i++) {
+		EXPECT_TRUE(table.emplace(std::to_string(i), i).second);
+	}
+	const auto duplicate = table.emplace(std::string("7"), -1);
+	const size_t numErased = table.erase(std::string_view("7"));
+	const size_t numErasedAgain = table.erase(std::string_view("7"));
+
+	// THEN
+	EXPECT_FALSE(duplicate.second);
+	EXPECT_EQ(7, duplicate.first->second);
+	EXPECT_EQ(1, numErased);
+	EXPECT_EQ(0, numErasedAgain);
+	EXPECT_EQ(999, table.size());
+	EXPECT_EQ(table.end(), table.find("7"));
+	EXPECT_EQ(999, table.find("999")->second);
+	EXPECT_TRUE(table.contains(std::string_view("0")));
+	size_t numIterated = 0;
+	for (const auto& entry : table) {
+		EXPECT_EQ(std::to_string(entry.second), entry.first);
+		numIterated++;
+	}
+	EXPECT_EQ(999, numIterated);
+}
+
+TEST(SwissTableTest, MatchesUnorderedMapUnderRandomChurn) {
+	// GIVEN
+	SwissTable<int, std::unique_ptr<int>> table;
+	std::unordered_map<int, int> model;
+	std::mt19937 rng(7);
+
+	// WHEN
+	for (int i = 0; i < 200000; i++) {
+		const int key = static_cast<int>(rng() % 3000);
+		if (rng() % 2) {
+			table.emplace(key, std::make_unique<int>(key));
+			model.emplace(key, key);
+		}
+		else {
+			const auto it = table.find(key);
+			if (it != table.end()) {
+				table.erase(it);
+			}
+			model.erase(key);
+		}
+	}
+
+	// THEN
+	EXPECT_EQ(model.size(), table.size());
+	for (int key = 0; key < 3000; key++) {
+		const auto it = table.find(key);
+		ASSERT_EQ(model.count(key) == 1, it != table.end());
+		if (it != table.end()) {
+			EXPECT_EQ(key, *it->second);
+		}
+	}
+}
+
+TEST(SwissTableTest, ReserveAndClear) {
+	// GIVEN
+	SwissTable<int, int> table;
+	table.reserve(100);
+
+	// WHEN
+	table.emplace(0, 0);
+	const int* firstValue = &table.find(0)->second;
+	for (int i = 1; i < 100; i++) {
+		table.emplace(i, i);
+	}
+	const bool wasRehashed = firstValue != &table.find(0)->second;
+	table.clear();
+
+	// THEN
+	EXPECT_FALSE(wasRehashed);
+	EXPECT_TRUE(table.empty());
+	EXPECT_EQ(table.begin(), table.end());
+	EXPECT_TRUE(table.emplace(5, 5).second);
+	EXPECT_EQ(5, table.find(5)->second);
+}
+
+TEST(SwissTableTest, BacksLinkedUnorderedMap) {
+	// GIVEN
+	LinkedUnorderedMap<std::string, int, SeededHash, std::equal_to<>, SharedMutexLocking, SwissTable> map;
+	const std::vector<std::pair<std::string, int>> entries = { { "a", 1 }, { "b", 2 }, { "c", 3 } };
+
+	// WHEN
+	map.insertMany(entries);
+	map.moveToEnd(std::string_view("a"));
+	const int removed = map.remove(std::string_view("b"));
+	const std::vector<std::string> keys = { "a", "b", "c" };
+	const std::vector<int*> values = map.getMany(keys);
+
+	// THEN
+	EXPECT_EQ(2, removed);
+	EXPECT_EQ(2, map.size());
+	EXPECT_EQ("c", map.begin().key());
+	EXPECT_EQ(1, *values[0]);
+	EXPECT_EQ(nullptr, values[1]);
+	EXPECT_EQ(3, *values[2]);
+}
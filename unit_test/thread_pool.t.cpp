@@ -0,0 +1,54 @@
+#include "pch.h"
+
+#include "../implementations/thread_pool.cpp"
+#include <atomic>
+#include <future>
+#include <memory>
+
+using namespace implementations;
+
+TEST(ThreadPoolTest, RunsSubmittedTasks) {
+	// GIVEN
+	std::atomic<int> numRun = 0;
+	auto pool = std::make_unique<ThreadPool>(4, 100);
+
+	// WHEN
+	for (int i = 0; i < 100; i++) {
+		EXPECT_TRUE(pool->trySubmit([&numRun]() { numRun++; }));
+	}
+	pool.reset();
+
+	// THEN
+	EXPECT_EQ(100, numRun);
+}
+
+TEST(ThreadPoolTest, RefusesWorkWhenQueueIsFull) {
+	// GIVEN
+	ThreadPool pool(1, 1);
+	std::promise<void> started;
+	std::promise<void> release;
+	std::shared_future<void> released = release.get_future().share();
+
+	// WHEN
+	pool.trySubmit([&started, released]() { started.set_value(); released.wait(); });
+	started.get_future().wait();
+	const bool queued = pool.trySubmit([]() {});
+	const bool refused = !pool.trySubmit([]() {});
+	const size_t numQueued = pool.numQueued();
+	release.set_value();
+
+	// THEN
+	EXPECT_TRUE(queued);
+	EXPECT_TRUE(refused);
+	EXPECT_EQ(1, numQueued);
+	EXPECT_EQ(1, pool.numThreads());
+}
+
+TEST(ThreadPoolTest, NeedsAThread) {
+	// GIVEN
+
+	// WHEN
+
+	// THEN
+	EXPECT_THROW(ThreadPool(0, 1), std::invalid_argument);
+}
@@ -0,0 +1,94 @@
+#include "pch.h"
+
+#include "../implementations/timer_wheel.cpp"
+#include <vector>
+
+using namespace implementations;
+
+TEST(TimerWheelTest, FiresOnlyExpiredTimers) {
+	// GIVEN
+	TimerWheel<int> wheel;
+	std::vector<int> fired;
+
+	// WHEN
+	wheel.schedule(1, 10);
+	wheel.schedule(2, 20);
+	wheel.schedule(3, 30);
+	const size_t numFired = wheel.advance(20, [&fired](const int& payload) { fired.push_back(payload); });
+
+	// THEN
+	EXPECT_EQ(2, numFired);
+	EXPECT_EQ(std::vector<int>({ 1, 2 }), fired);
+	EXPECT_EQ(1, wheel.size());
+	EXPECT_EQ(20, wheel.now());
+}
+
+TEST(TimerWheelTest, CascadesTimersFromHigherLevels) {
+	// GIVEN
+	TimerWheel<int> wheel(5);
+	std::vector<int> fired;
+	const auto onExpired = [&fired](const int& payload) { fired.push_back(payload); };
+
+	// WHEN
+	wheel.schedule(1, 100);
+	wheel.schedule(2, 5000);
+	wheel.schedule(3, 300000);
+	wheel.advance(99, onExpired);
+	const bool noneFiredEarly = fired.empty();
+	wheel.advance(100, onExpired);
+	wheel.advance(4999, onExpired);
+	const size_t firedBeforeSecond = fired.size();
+	wheel.advance(300000, onExpired);
+
+	// THEN
+	EXPECT_TRUE(noneFiredEarly);
+	EXPECT_EQ(1, firedBeforeSecond);
+	EXPECT_EQ(std::vector<int>({ 1, 2, 3 }), fired);
+	EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, TimersBeyondRangeFireOnTime) {
+	// GIVEN
+	TimerWheel<int> wheel;
+	std::vector<int> fired;
+	const uint64_t farExpiry = (uint64_t(1) << 31) + 7;
+
+	// WHEN
+	wheel.schedule(1, farExpiry);
+	wheel.advance(farExpiry - 1, [&fired](const int& payload) { fired.push_back(payload); });
+	const bool firedEarly = !fired.empty();
+	wheel.advance(farExpiry, [&fired](const int& payload) { fired.push_back(payload); });
+
+	// THEN
+	EXPECT_FALSE(firedEarly);
+	EXPECT_EQ(std::vector<int>({ 1 }), fired);
+}
+
+TEST(TimerWheelTest, CancelledTimerDoesNotFire) {
+	// GIVEN
+	TimerWheel<int> wheel;
+	std::vector<int> fired;
+
+	// WHEN
+	const auto handle = wheel.schedule(1, 10);
+	wheel.schedule(2, 10);
+	wheel.cancel(handle);
+	wheel.advance(10, [&fired](const int& payload) { fired.push_back(payload); });
+
+	// THEN
+	EXPECT_EQ(std::vector<int>({ 2 }), fired);
+	EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, PastExpiryFiresOnNextTick) {
+	// GIVEN
+	TimerWheel<int> wheel(50);
+	std::vector<int> fired;
+
+	// WHEN
+	wheel.schedule(1, 10);
+	wheel.advance(51, [&fired](const int& payload) { fired.push_back(payload); });
+
+	// THEN
+	EXPECT_EQ(std::vector<int>({ 1 }), fired);
+}
@@ -0,0 +1,85 @@
+#include "pch.h"
+
+#include "../implementations/two_tier_lru_cache.cpp"
+#include "../implementations/lru_cache.cpp"
+#include "../implementations/linked_unordered_map.cpp"
+#include "../implementations/concurrency_policy.cpp"
+#include "../implementations/lz_codec.cpp"
+#include "../implementations/thread_pool.cpp"
+#include "../implementations/timer_wheel.cpp"
+#include <string>
+
+using namespace implementations;
+
+namespace {
+	std::string payload(const int i) {
+		std::string text;
+		for (int line = 0; line < 20; line++) {
+			text += "record " + std::to_string(i) + " field value repeated text\n";
+		}
+		return text;
+	}
+}
+
+TEST(TwoTierLruCacheTest, EvictedEntriesAreDemotedAndPromotedBack) {
+	// GIVEN
+	TwoTierLruCache<int, std::string> cache(2, 100000);
+
+	// WHEN
+	cache.push(1, payload(1));
+	cache.push(2, payload(2));
+	cache.push(3, payload(3));
+	const TwoTierStats afterDemotion = cache.stats();
+	const std::optional<std::string> promoted = cache.get(1);
+	const TwoTierStats afterPromotion = cache.stats();
+
+	// THEN
+	EXPECT_EQ(1, afterDemotion.demotions);
+	EXPECT_EQ(2, afterDemotion.hotSize);
+	EXPECT_EQ(1, afterDemotion.coldSize);
+	EXPECT_LT(afterDemotion.compressedBytes, payload(1).size() / 3);
+	ASSERT_TRUE(promoted.has_value());
+	EXPECT_EQ(payload(1), *promoted);
+	EXPECT_EQ(1, afterPromotion.coldHits);
+	// promoting 1 demoted 2, the least recently used hot entry
+	EXPECT_EQ(2, afterPromotion.demotions);
+	EXPECT_TRUE(cache.hasKey(2));
+	EXPECT_EQ(3, cache.size());
+}
+
+TEST(TwoTierLruCacheTest, ColdTierIsBoundedByCompressedBytes) {
+	// GIVEN
+	TwoTierLruCache<int, std::string> cache(1, 200);
+
+	// WHEN
+	for (int i = 0; i < 50; i++) {
+		cache.push(i, payload(i));
+	}
+	const TwoTierStats stats = cache.stats();
+
+	// THEN
+	EXPECT_LE(stats.compressedBytes, 200);
+	EXPECT_GT(stats.coldSize, 1);
+	EXPECT_LT(stats.coldSize, 49);
+	EXPECT_FALSE(cache.get(0).has_value());
+	EXPECT_EQ(payload(48), cache.get(48));
+}
+
+TEST(TwoTierLruCacheTest, PushAndRemoveKeepAKeyInOneTier) {
+	// GIVEN
+	TwoTierLruCache<int, double> cache(1, 1000);
+	cache.push(1, 1.5);
+	cache.push(2, 2.5);
+
+	// WHEN
+	cache.push(1, 3.5);
+	const bool removed = cache.remove(2);
+	const bool removedAgain = cache.remove(2);
+
+	// THEN
+	EXPECT_TRUE(removed);
+	EXPECT_FALSE(removedAgain);
+	EXPECT_EQ(1, cache.size());
+	EXPECT_EQ(3.5, cache.get(1));
+	EXPECT_EQ(1, cache.stats().hotHits);
+}
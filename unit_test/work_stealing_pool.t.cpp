@@ -0,0 +1,71 @@
+#include "pch.h"
+
+#include "../implementations/work_stealing_pool.cpp"
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+
+using namespace implementations;
+
+namespace {
+	// sums [begin, end) by splitting in half until the ranges are small, every level waits on the level below
+	uint64_t parallelSum(WorkStealingPool& pool, const uint64_t begin, const uint64_t end) {
+		if (end - begin <= 64) {
+			uint64_t sum = 0;
+			for (uint64_t i = begin; i < end; i++) {
+				sum += i;
+			}
+			return sum;
+		}
+		const uint64_t middle = begin + (end - begin) / 2;
+		uint64_t left = 0;
+		WorkStealingPool::TaskGroup group(pool);
+		group.spawn([&pool, &left, begin, middle]() { left = parallelSum(pool, begin, middle); });
+		const uint64_t right = parallelSum(pool, middle, end);
+		group.wait();
+		return left + right;
+	}
+}
+
+TEST(WorkStealingPoolTest, RunsNestedForkJoin) {
+	// GIVEN
+	WorkStealingPool pool(4);
+
+	// WHEN
+	const uint64_t sum = parallelSum(pool, 0, 100000);
+
+	// THEN
+	EXPECT_EQ(uint64_t(100000) * 99999 / 2, sum);
+	EXPECT_EQ(4, pool.numThreads());
+}
+
+TEST(WorkStealingPoolTest, WaitRethrowsTaskException) {
+	// GIVEN
+	WorkStealingPool pool(2);
+	std::atomic<int> numRun = 0;
+	WorkStealingPool::TaskGroup group(pool);
+
+	// WHEN
+	for (int i = 0; i < 10; i++) {
+		group.spawn([&numRun, i]() {
+			numRun++;
+			if (i == 5) {
+				throw std::runtime_error("task failed");
+			}
+		});
+	}
+
+	// THEN
+	EXPECT_THROW(group.wait(), std::runtime_error);
+	EXPECT_EQ(10, numRun);
+	EXPECT_NO_THROW(group.wait());
+}
+
+TEST(WorkStealingPoolTest, NeedsAThread) {
+	// GIVEN
+
+	// WHEN
+
+	// THEN
+	EXPECT_THROW(WorkStealingPool(0), std::invalid_argument);
+}